@@ -0,0 +1,201 @@
+#pragma once
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include "GLExtensions.h"
+#include "GLState.h"
+#include "GpuTimer.h"
+#include "ComputeShader.h"
+
+#include <cmath>
+#include <algorithm>
+
+struct BloomStats
+{
+	static const unsigned int max_levels = 6;
+
+	unsigned int levels = 0;
+	unsigned int width = 0;				// of the first level
+	unsigned int height = 0;
+	float down_ms[max_levels] = {};		// the pass that writes each level
+	float up_ms[max_levels] = {};		// the pass that adds the level below to each one, none for the last
+	float ms = 0.0f;
+	unsigned int bytes = 0;
+};
+
+/**
+bloom from a chain of mips of a half resolution R11F_G11F_B10F texture. the frame is filtered down
+the chain with 13 taps and back up with a 3x3 tent, each level adding the blurred one below it, so
+the blur reaches the whole chain for the cost of a couple of full resolution passes whatever its
+radius. there's no threshold by default, everything blooms a little and the brightest the most.
+needs gl_caps.compute
+*/
+class Bloom
+{
+public:
+	static const unsigned int texture_unit = 18;	// the chain, and the input at the one after it
+	static const unsigned int max_levels = BloomStats::max_levels;
+
+	Bloom(unsigned int width, unsigned int height)
+	{
+		// the chain is read one level at a time with textureLod, the input has no mips
+		glGenSamplers(1, &m_chain_sampler);
+		glSamplerParameteri(m_chain_sampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST);
+		glSamplerParameteri(m_chain_sampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glSamplerParameteri(m_chain_sampler, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glSamplerParameteri(m_chain_sampler, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glBindSampler(texture_unit, m_chain_sampler);
+
+		glGenSamplers(1, &m_input_sampler);
+		glSamplerParameteri(m_input_sampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glSamplerParameteri(m_input_sampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glSamplerParameteri(m_input_sampler, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glSamplerParameteri(m_input_sampler, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glBindSampler(texture_unit + 1, m_input_sampler);
+
+		m_prefilter = new ComputeShader("shaders/BloomCompute.shader", "#define BLOOM_DOWN\n#define BLOOM_PREFILTER\n");
+		m_down = new ComputeShader("shaders/BloomCompute.shader", "#define BLOOM_DOWN\n");
+		m_up = new ComputeShader("shaders/BloomCompute.shader", "#define BLOOM_UP\n");
+		for (ComputeShader* shader : { m_prefilter, m_down, m_up })
+		{
+			shader->use();
+			shader->setFloat("scale", 1.0f);
+		}
+
+		for (unsigned int i = 0; i < max_levels; ++i)
+		{
+			m_down_timers[i] = new GpuTimer();
+			m_up_timers[i] = new GpuTimer();
+		}
+		m_timer = new GpuTimer();
+
+		resize(width, height);
+	}
+	~Bloom()
+	{
+		glDeleteTextures(1, &m_texture);
+		gl_state.forgetTexture(m_texture);
+		glDeleteSamplers(1, &m_chain_sampler);
+		glDeleteSamplers(1, &m_input_sampler);
+		delete(m_prefilter);
+		delete(m_down);
+		delete(m_up);
+		for (unsigned int i = 0; i < max_levels; ++i)
+		{
+			delete(m_down_timers[i]);
+			delete(m_up_timers[i]);
+		}
+		delete(m_timer);
+	}
+
+	// of the frame it's applied to
+	void resize(unsigned int width, unsigned int height)
+	{
+		if (m_texture)
+		{
+			glDeleteTextures(1, &m_texture);
+			gl_state.forgetTexture(m_texture);
+		}
+
+		stats.width = std::max(width / 2, 1u);
+		stats.height = std::max(height / 2, 1u);
+		// down to about 8 texels, past that the levels only add passes
+		stats.levels = 1;
+		while (stats.levels < max_levels && std::min(stats.width, stats.height) >> stats.levels >= 8)
+			++stats.levels;
+
+		glGenTextures(1, &m_texture);
+		gl_state.bindTexture(texture_unit, GL_TEXTURE_2D, m_texture);
+		stats.bytes = 0;
+		for (unsigned int i = 0; i < stats.levels; ++i)
+		{
+			unsigned int level_width = std::max(stats.width >> i, 1u);
+			unsigned int level_height = std::max(stats.height >> i, 1u);
+			glTexImage2D(GL_TEXTURE_2D, i, GL_R11F_G11F_B10F, level_width, level_height, 0, GL_RGB, GL_FLOAT, NULL);
+			stats.bytes += level_width * level_height * 4;
+		}
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, stats.levels - 1);
+	}
+
+	/**
+	fills the chain from input_texture, radius spreads the upsampling taps, in texels of each level.
+	the result is the first level, bound at texture_unit. when the frame was drawn at a lower resolution
+	it's frame_scale of the input from its origin, and only that part of each level is filled
+	*/
+	void apply(unsigned int input_texture, float radius = 1.0f, float threshold = 0.0f, const glm::vec2& frame_scale = glm::vec2(1.0f))
+	{
+		m_frame_scale = frame_scale;
+		m_timer->begin();
+		gl_state.bindTexture(texture_unit + 1, GL_TEXTURE_2D, input_texture);
+		gl_state.bindTexture(texture_unit, GL_TEXTURE_2D, m_texture);
+
+		for (unsigned int i = 0; i < stats.levels; ++i)
+		{
+			ComputeShader* shader = i == 0 ? m_prefilter : m_down;
+			shader->use();
+			shader->setInt("src", i == 0 ? texture_unit + 1 : texture_unit);
+			shader->setFloat("src_lod", i == 0 ? 0.0f : (float)(i - 1));
+			if (i == 0)
+				shader->setFloat("threshold", threshold);
+			pass(m_down_timers[i], shader, i);
+		}
+
+		m_up->use();
+		m_up->setInt("src", texture_unit);
+		m_up->setFloat("radius", radius);
+		for (int i = stats.levels - 2; i >= 0; --i)
+		{
+			// the levels were added up, averaging them keeps the energy of the frame
+			m_up->setFloat("src_lod", (float)(i + 1));
+			m_up->setFloat("scale", i == 0 ? 1.0f / stats.levels : 1.0f);
+			pass(m_up_timers[i], m_up, i);
+		}
+		m_timer->end();
+
+		for (unsigned int i = 0; i < stats.levels; ++i)
+		{
+			stats.down_ms[i] = m_down_timers[i]->ms();
+			stats.up_ms[i] = i + 1 < stats.levels ? m_up_timers[i]->ms() : 0.0f;
+		}
+		stats.ms = m_timer->ms();
+	}
+
+	unsigned int texture()
+	{
+		return m_texture;
+	}
+
+	BloomStats stats;
+
+private:
+	unsigned int m_texture = 0;
+	unsigned int m_chain_sampler;
+	unsigned int m_input_sampler;
+
+	ComputeShader* m_prefilter;
+	ComputeShader* m_down;
+	ComputeShader* m_up;
+
+	glm::vec2 m_frame_scale = glm::vec2(1.0f);
+
+	GpuTimer* m_down_timers[max_levels];
+	GpuTimer* m_up_timers[max_levels];
+	GpuTimer* m_timer;
+
+	void pass(GpuTimer* timer, ComputeShader* shader, unsigned int level)
+	{
+		unsigned int width = std::max(stats.width >> level, 1u);
+		unsigned int height = std::max(stats.height >> level, 1u);
+
+		timer->begin();
+		glUniform2i(shader->uniformLoc("dst_size"), width, height);
+		glUniform2f(shader->uniformLoc("frame_scale"), m_frame_scale.x, m_frame_scale.y);
+		glBindImageTexture(0, m_texture, level, GL_FALSE, 0, shader == m_up ? GL_READ_WRITE : GL_WRITE_ONLY, GL_R11F_G11F_B10F);
+		// a texel more than the frame covers, the level below samples past its edge
+		shader->dispatch(std::min((unsigned int)std::ceil(width * m_frame_scale.x) + 1, width), std::min((unsigned int)std::ceil(height * m_frame_scale.y) + 1, height), 1, 8, 8);
+		// the next pass samples this level
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+		timer->end();
+	}
+};
\ No newline at end of file
@@ -0,0 +1,81 @@
+#pragma once
+#include <glm/glm.hpp>
+
+struct AABB {
+	glm::vec3 min;
+	glm::vec3 max;
+
+	glm::vec3 center() const
+	{
+		return (min + max) * 0.5f;
+	}
+	glm::vec3 extents() const
+	{
+		return (max - min) * 0.5f;
+	}
+	void expand(const AABB& other)
+	{
+		min = glm::min(min, other.min);
+		max = glm::max(max, other.max);
+	}
+	// world space bounds of this box after being transformed by model
+	AABB transform(const glm::mat4& model) const
+	{
+		glm::vec3 c = glm::vec3(model * glm::vec4(center(), 1.0f));
+		glm::vec3 e = extents();
+		glm::vec3 world_extents = glm::abs(glm::vec3(model[0])) * e.x
+								+ glm::abs(glm::vec3(model[1])) * e.y
+								+ glm::abs(glm::vec3(model[2])) * e.z;
+		return { c - world_extents, c + world_extents };
+	}
+};
+
+/**
+view frustum planes extracted from a view projection matrix (Gribb/Hartmann),
+normalized so that dot(plane.xyz, p) + plane.w is the signed distance to the plane
+*/
+struct Frustum {
+	glm::vec4 planes[6];
+
+	Frustum() {}
+	Frustum(const glm::mat4& view_proj)
+	{
+		glm::vec4 row0 = glm::vec4(view_proj[0][0], view_proj[1][0], view_proj[2][0], view_proj[3][0]);
+		glm::vec4 row1 = glm::vec4(view_proj[0][1], view_proj[1][1], view_proj[2][1], view_proj[3][1]);
+		glm::vec4 row2 = glm::vec4(view_proj[0][2], view_proj[1][2], view_proj[2][2], view_proj[3][2]);
+		glm::vec4 row3 = glm::vec4(view_proj[0][3], view_proj[1][3], view_proj[2][3], view_proj[3][3]);
+
+		planes[0] = row3 + row0; // left
+		planes[1] = row3 - row0; // right
+		planes[2] = row3 + row1; // bottom
+		planes[3] = row3 - row1; // top
+		planes[4] = row3 + row2; // near
+		planes[5] = row3 - row2; // far
+
+		for (unsigned int i = 0; i < 6; ++i)
+			planes[i] /= glm::length(glm::vec3(planes[i]));
+	}
+
+	bool intersectsSphere(const glm::vec3& center, float radius) const
+	{
+		for (unsigned int i = 0; i < 6; ++i)
+		{
+			if (glm::dot(glm::vec3(planes[i]), center) + planes[i].w < -radius)
+				return false;
+		}
+		return true;
+	}
+	bool intersectsAABB(const AABB& box) const
+	{
+		glm::vec3 c = box.center();
+		glm::vec3 e = box.extents();
+		for (unsigned int i = 0; i < 6; ++i)
+		{
+			glm::vec3 n = glm::vec3(planes[i]);
+			float r = glm::dot(e, glm::abs(n));
+			if (glm::dot(n, c) + planes[i].w < -r)
+				return false;
+		}
+		return true;
+	}
+};
\ No newline at end of file
@@ -0,0 +1,328 @@
+#pragma once
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Light.h"
+#include "Bounds.h"
+#include "GLState.h"
+#include "GpuTimer.h"
+#include "ShadowFilter.h"
+
+#include <iostream>
+
+// the Cascades uniform block of Fragment.shader (std140)
+struct CascadeData
+{
+	glm::mat4 view_projection[4];
+	glm::vec4 splits;		// view space depth where each cascade ends
+	glm::ivec4 params;		// number of cascades
+};
+
+struct CascadeStats
+{
+	unsigned int cascades = 0;
+	bool drawn = false;					// whether the cascades were drawn this frame
+	unsigned int casters_submitted = 0;	// draw calls, once per caster in layered mode
+	float moments_ms = 0.0f;			// blurring the moments for VSM and ESM
+	float splits[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	float gpu_ms = 0.0f;
+};
+
+enum CascadeRenderMode
+{
+	CASCADE_RENDER_PER_CASCADE,	// every cascade is its own pass with the casters in it
+	CASCADE_RENDER_LAYERED		// one pass, a geometry shader sends each triangle to every cascade
+};
+
+/**
+cascaded shadow maps of the directional light, one layer of a depth texture array each.
+the camera's view range, up to shadow_distance, is split between the practical scheme's
+logarithmic and uniform splits. each cascade is fit around the bounding sphere of its slice
+and moved in whole texels, so the shadow edges don't crawl while the camera moves
+*/
+class CascadedShadows
+{
+public:
+	static const unsigned int max_cascades = 4;
+	static const unsigned int binding = 4;
+	static const unsigned int texture_unit = 5;
+	static const unsigned int compare_unit = 14;
+
+	// blend of the logarithmic (1) and uniform (0) splits
+	float split_lambda = 0.75f;
+	float shadow_distance = 150.0f;
+	// how far behind a cascade casters are still drawn into it
+	float caster_depth = 50.0f;
+
+	CascadeRenderMode mode = CASCADE_RENDER_LAYERED;
+
+	CascadeStats stats;
+
+	CascadedShadows(unsigned int size, unsigned int num_cascades) : m_size(size)
+	{
+		setCascadeCount(num_cascades);
+
+		glGenTextures(1, &m_texture);
+		gl_state.bindTexture(texture_unit, GL_TEXTURE_2D_ARRAY, m_texture);
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, size, size, max_cascades, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+		// every layer at once for layered rendering, and one framebuffer per layer
+		glGenFramebuffers(1, &m_layered_fbo);
+		gl_state.bindFramebuffer(GL_FRAMEBUFFER, m_layered_fbo);
+		glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_texture, 0);
+		checkFramebuffer();
+
+		glGenFramebuffers(max_cascades, m_fbos);
+		for (unsigned int i = 0; i < max_cascades; ++i)
+		{
+			gl_state.bindFramebuffer(GL_FRAMEBUFFER, m_fbos[i]);
+			glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_texture, 0, i);
+			checkFramebuffer();
+		}
+		gl_state.bindFramebuffer(GL_FRAMEBUFFER, 0);
+
+		glGenBuffers(1, &m_ubo);
+		glBindBuffer(GL_UNIFORM_BUFFER, m_ubo);
+		glBufferData(GL_UNIFORM_BUFFER, sizeof(CascadeData), NULL, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+		glBindBufferBase(GL_UNIFORM_BUFFER, binding, m_ubo);
+
+		m_compare_sampler = createCompareSampler();
+		m_timer = new GpuTimer();
+	}
+	~CascadedShadows()
+	{
+		glDeleteFramebuffers(1, &m_layered_fbo);
+		glDeleteFramebuffers(max_cascades, m_fbos);
+		glDeleteTextures(1, &m_texture);
+		gl_state.forgetTexture(m_texture);
+		glDeleteBuffers(1, &m_ubo);
+		glDeleteSamplers(1, &m_compare_sampler);
+
+		delete(m_timer);
+		delete(m_moments);
+	}
+
+	/**
+	points the program's Cascades block and cascade samplers at the cascades
+	*/
+	void bindToProgram(unsigned int program)
+	{
+		unsigned int index = glGetUniformBlockIndex(program, "Cascades");
+		if (index != GL_INVALID_INDEX)
+			glUniformBlockBinding(program, index, binding);
+
+		gl_state.useProgram(program);
+		glUniform1i(glGetUniformLocation(program, "cascade_shadow_map"), texture_unit);
+		glUniform1i(glGetUniformLocation(program, "cascade_shadow_compare"), compare_unit);
+		glUniform1i(glGetUniformLocation(program, "cascade_moments"), ShadowMoments::texture_unit);
+	}
+
+	/**
+	VSM and ESM keep blurred moments of the cascades next to the depth, which needs compute shaders
+	*/
+	void setFilter(ShadowFilterMode filter)
+	{
+		m_filter = filter;
+		if ((filter == SHADOW_FILTER_VSM || filter == SHADOW_FILTER_ESM) && !m_moments)
+			m_moments = new ShadowMoments(m_size, max_cascades);
+		m_moments_valid = false;
+	}
+
+	/**
+	blurs the moments again if the cascades were drawn since, for VSM and ESM
+	*/
+	void updateMoments()
+	{
+		stats.moments_ms = m_moments ? m_moments->ms() : 0.0f;
+		if (m_moments_valid || (m_filter != SHADOW_FILTER_VSM && m_filter != SHADOW_FILTER_ESM))
+			return;
+
+		bind();
+		m_moments->update(texture_unit, m_num_cascades, m_filter);
+		m_moments_valid = true;
+	}
+
+	// 2 to 4
+	void setCascadeCount(unsigned int count)
+	{
+		m_num_cascades = count < 2 ? 2 : (count > max_cascades ? max_cascades : count);
+		m_changed = true;
+	}
+
+	unsigned int cascadeCount()
+	{
+		return m_num_cascades;
+	}
+
+	/**
+	fits the cascades to the camera and returns true if they have to be drawn again,
+	which is when they moved or casters_changed is set
+	*/
+	bool update(const glm::mat4& view, const glm::mat4& projection, const DirLight* light, bool casters_changed)
+	{
+		stats.cascades = m_num_cascades;
+		stats.drawn = false;
+		stats.casters_submitted = 0;
+		stats.gpu_ms = m_timer->ms();
+
+		// near and far plane from the perspective projection
+		float near = projection[3][2] / (projection[2][2] - 1.0f);
+		float far = glm::min(projection[3][2] / (projection[2][2] + 1.0f), shadow_distance);
+
+		// extent of the view frustum at a depth of 1
+		float tan_y = 1.0f / projection[1][1];
+		float tan_x = 1.0f / projection[0][0];
+		glm::mat4 inv_view = glm::inverse(view);
+
+		glm::vec3 dir = glm::normalize(light->direction);
+		glm::vec3 up = glm::abs(dir.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+		glm::mat4 light_rotation = glm::lookAt(glm::vec3(0.0f), dir, up);
+		glm::mat4 inv_light_rotation = glm::inverse(light_rotation);
+
+		CascadeData data = {};
+		data.params = glm::ivec4(m_num_cascades, 0, 0, 0);
+
+		float slice_near = near;
+		for (unsigned int i = 0; i < m_num_cascades; ++i)
+		{
+			// practical split scheme
+			float t = (float)(i + 1) / m_num_cascades;
+			float log_split = near * glm::pow(far / near, t);
+			float uniform_split = near + (far - near) * t;
+			float slice_far = split_lambda * log_split + (1.0f - split_lambda) * uniform_split;
+
+			// bounding sphere of the slice, its radius only changes with the projection so the cascade's size is stable
+			glm::vec3 corners[8];
+			glm::vec3 center = glm::vec3(0.0f);
+			for (unsigned int j = 0; j < 8; ++j)
+			{
+				float depth = j < 4 ? slice_near : slice_far;
+				float x = (j & 1) ? 1.0f : -1.0f;
+				float y = (j & 2) ? 1.0f : -1.0f;
+				corners[j] = glm::vec3(inv_view * glm::vec4(x * tan_x * depth, y * tan_y * depth, -depth, 1.0f));
+				center += corners[j] / 8.0f;
+			}
+			float radius = 0.0f;
+			for (unsigned int j = 0; j < 8; ++j)
+				radius = glm::max(radius, glm::length(corners[j] - center));
+			radius = glm::ceil(radius * 16.0f) / 16.0f;
+
+			// move the center in whole texels of the light's view
+			float texel = 2.0f * radius / m_size;
+			glm::vec3 light_center = glm::vec3(light_rotation * glm::vec4(center, 1.0f));
+			light_center.x = glm::floor(light_center.x / texel) * texel;
+			light_center.y = glm::floor(light_center.y / texel) * texel;
+			center = glm::vec3(inv_light_rotation * glm::vec4(light_center, 1.0f));
+
+			glm::vec3 eye = center - dir * (radius + caster_depth);
+			glm::mat4 cascade_view = glm::lookAt(eye, center, up);
+			glm::mat4 cascade_proj = glm::ortho(-radius, radius, -radius, radius, 0.0f, 2.0f * radius + caster_depth);
+
+			data.view_projection[i] = cascade_proj * cascade_view;
+			data.splits[i] = slice_far;
+			stats.splits[i] = slice_far;
+
+			slice_near = slice_far;
+		}
+
+		bool moved = m_changed;
+		for (unsigned int i = 0; i < m_num_cascades && !moved; ++i)
+			moved = data.view_projection[i] != m_data.view_projection[i] || data.splits[i] != m_data.splits[i];
+
+		if (moved)
+		{
+			m_data = data;
+			for (unsigned int i = 0; i < m_num_cascades; ++i)
+				m_frustums[i] = Frustum(m_data.view_projection[i]);
+
+			glBindBuffer(GL_UNIFORM_BUFFER, m_ubo);
+			glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(CascadeData), &m_data);
+			glBindBuffer(GL_UNIFORM_BUFFER, 0);
+			m_changed = false;
+		}
+
+		return moved || casters_changed;
+	}
+
+	const glm::mat4& viewProjection(unsigned int cascade)
+	{
+		return m_data.view_projection[cascade];
+	}
+	const Frustum& frustum(unsigned int cascade)
+	{
+		return m_frustums[cascade];
+	}
+
+	void beginFrame()
+	{
+		m_timer->begin();
+		stats.drawn = true;
+		m_moments_valid = false;
+		gl_state.viewport(0, 0, m_size, m_size);
+	}
+	void endFrame()
+	{
+		m_timer->end();
+	}
+
+	/**
+	binds and clears one cascade, or every cascade for layered rendering
+	*/
+	void beginCascade(unsigned int cascade)
+	{
+		gl_state.bindFramebuffer(GL_FRAMEBUFFER, m_fbos[cascade]);
+		glClear(GL_DEPTH_BUFFER_BIT);
+	}
+	void beginLayered()
+	{
+		gl_state.bindFramebuffer(GL_FRAMEBUFFER, m_layered_fbo);
+		glClear(GL_DEPTH_BUFFER_BIT);
+	}
+
+	void bind()
+	{
+		gl_state.bindTexture(texture_unit, GL_TEXTURE_2D_ARRAY, m_texture);
+		gl_state.bindTexture(compare_unit, GL_TEXTURE_2D_ARRAY, m_texture);
+		glBindSampler(compare_unit, m_compare_sampler);
+		if (m_moments)
+			m_moments->bind();
+	}
+
+private:
+	unsigned int m_size;
+	unsigned int m_num_cascades;
+	bool m_changed = true;
+
+	unsigned int m_texture;
+	unsigned int m_layered_fbo;
+	unsigned int m_fbos[max_cascades];
+	unsigned int m_ubo;
+	unsigned int m_compare_sampler;
+
+	ShadowFilterMode m_filter = SHADOW_FILTER_PCF;
+	ShadowMoments* m_moments = nullptr;
+	bool m_moments_valid = false;
+
+	CascadeData m_data = {};
+	Frustum m_frustums[max_cascades];
+
+	GpuTimer* m_timer;
+
+	void checkFramebuffer()
+	{
+		glDrawBuffer(GL_NONE);
+		glReadBuffer(GL_NONE);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		{
+			std::cout << "ERROR::FRAMEBUFFER:: Cascade framebuffer is not complete!" << std::endl;
+		}
+	}
+};
\ No newline at end of file
@@ -0,0 +1,463 @@
+#pragma once
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include "Light.h"
+#include "GLState.h"
+
+#include <vector>
+#include <chrono>
+#include <algorithm>
+
+struct ClusterStats
+{
+	unsigned int num_lights = 0;
+	unsigned int max_lights = 0;		// most lights in a single cluster
+	float average_lights = 0.0f;		// over the clusters with at least one light
+	float assign_ms = 0.0f;
+	bool reassigned = false;			// false if nothing moved since the last frame
+};
+
+// the Clusters uniform block
+struct ClusterParams
+{
+	unsigned int dims[4];		// clusters in x, y and z, number of lights
+	float params[4];			// tiles per pixel in x and y, depth slice scale and bias
+	int flags[4];				// 1 to loop over the cluster's lights, 0 to loop over every light
+};
+
+/**
+clustered forward shading. the view frustum is split into grid_x * grid_y screen tiles and
+grid_z depth slices, spaced exponentially between the near and far plane, and every frame
+each point and spot light is assigned to the clusters its sphere of influence touches. the
+fragment shader finds its cluster from gl_FragCoord and its view depth and only loops over
+the lights listed there, so its cost follows the lights that reach it rather than all of them.
+the light list, the per cluster (offset, count) grid and the light indices are texture
+buffers so a 4.2 context without SSBOs can still read them.
+*/
+class ClusteredLights
+{
+public:
+	static const unsigned int grid_x = 16;
+	static const unsigned int grid_y = 9;
+	static const unsigned int grid_z = 24;
+	static const unsigned int num_clusters = grid_x * grid_y * grid_z;
+
+	static const unsigned int binding = 2;
+	static const unsigned int lights_unit = 8;
+	static const unsigned int grid_unit = 9;
+	static const unsigned int indices_unit = 10;
+
+	// texels per light in the light buffer
+	static const unsigned int light_texels = sizeof(ClusterLightData) / sizeof(glm::vec4);
+
+	ClusterStats stats;
+
+	ClusteredLights()
+	{
+		glGenBuffers(1, &m_ubo);
+		glBindBuffer(GL_UNIFORM_BUFFER, m_ubo);
+		glBufferData(GL_UNIFORM_BUFFER, sizeof(ClusterParams), NULL, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		glBindBufferBase(GL_UNIFORM_BUFFER, binding, m_ubo);
+
+		m_light_texture = createTextureBuffer(m_light_buffer, GL_RGBA32F, sizeof(ClusterLightData));
+		m_grid_texture = createTextureBuffer(m_grid_buffer, GL_RG32UI, num_clusters * 2 * sizeof(unsigned int));
+		m_indices_texture = createTextureBuffer(m_indices_buffer, GL_R32UI, sizeof(unsigned int));
+
+		m_light_capacity = 1;
+		m_indices_capacity = 1;
+		m_grid.resize(num_clusters * 2, 0);
+	}
+	~ClusteredLights()
+	{
+		glDeleteBuffers(1, &m_ubo);
+		glDeleteBuffers(1, &m_light_buffer);
+		glDeleteBuffers(1, &m_grid_buffer);
+		glDeleteBuffers(1, &m_indices_buffer);
+
+		glDeleteTextures(1, &m_light_texture);
+		glDeleteTextures(1, &m_grid_texture);
+		glDeleteTextures(1, &m_indices_texture);
+		gl_state.forgetTexture(m_light_texture);
+		gl_state.forgetTexture(m_grid_texture);
+		gl_state.forgetTexture(m_indices_texture);
+	}
+
+	/**
+	points the program's Clusters block and light samplers at the buffers
+	*/
+	void bindToProgram(unsigned int program)
+	{
+		unsigned int index = glGetUniformBlockIndex(program, "Clusters");
+		if (index != GL_INVALID_INDEX)
+			glUniformBlockBinding(program, index, binding);
+
+		gl_state.useProgram(program);
+		glUniform1i(glGetUniformLocation(program, "cluster_lights"), lights_unit);
+		glUniform1i(glGetUniformLocation(program, "cluster_grid"), grid_unit);
+		glUniform1i(glGetUniformLocation(program, "cluster_indices"), indices_unit);
+	}
+
+	void addPointLight(PointLight* light)
+	{
+		m_point_lights.push_back(light);
+		light->dirty = true;
+		m_light_data.emplace_back();
+	}
+
+	void addSpotLight(SpotLight* light)
+	{
+		m_spot_lights.push_back(light);
+		light->dirty = true;
+		m_light_data.emplace_back();
+	}
+
+	const std::vector<PointLight*>& pointLights()
+	{
+		return m_point_lights;
+	}
+	const std::vector<SpotLight*>& spotLights()
+	{
+		return m_spot_lights;
+	}
+
+	/**
+	with clustering off the shader loops over every light, which is what it's compared against
+	*/
+	void setEnabled(bool enabled)
+	{
+		if (enabled != m_enabled)
+			m_params_dirty = true;
+		m_enabled = enabled;
+	}
+
+	bool enabled()
+	{
+		return m_enabled;
+	}
+
+	/**
+	uploads the lights that changed and assigns them to clusters again if they or the camera moved
+	*/
+	void update(const glm::mat4& view, const glm::mat4& projection, int width, int height)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+
+		bool lights_changed = uploadLights();
+
+		stats.num_lights = m_light_data.size();
+		stats.reassigned = false;
+
+		bool camera_changed = view != m_view || projection != m_projection || width != m_width || height != m_height;
+		if (camera_changed)
+		{
+			m_view = view;
+			m_projection = projection;
+			m_width = width;
+			m_height = height;
+			m_params_dirty = true;
+		}
+
+		if (m_params_dirty || m_uploaded_lights != m_light_data.size())
+			uploadParams();
+
+		if (m_enabled && (lights_changed || camera_changed || m_needs_assign))
+		{
+			assign();
+			stats.reassigned = true;
+			m_needs_assign = false;
+		}
+		else if (!m_enabled)
+		{
+			// the grid is stale once clustering is back on
+			m_needs_assign = true;
+		}
+
+		std::chrono::duration<float, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+		stats.assign_ms = elapsed.count();
+	}
+
+	void bind()
+	{
+		gl_state.bindTexture(lights_unit, GL_TEXTURE_BUFFER, m_light_texture);
+		gl_state.bindTexture(grid_unit, GL_TEXTURE_BUFFER, m_grid_texture);
+		gl_state.bindTexture(indices_unit, GL_TEXTURE_BUFFER, m_indices_texture);
+	}
+
+private:
+	unsigned int m_ubo;
+	unsigned int m_light_buffer, m_grid_buffer, m_indices_buffer;
+	unsigned int m_light_texture, m_grid_texture, m_indices_texture;
+	unsigned int m_light_capacity;
+	unsigned int m_indices_capacity;
+
+	std::vector<PointLight*> m_point_lights;
+	std::vector<SpotLight*> m_spot_lights;
+
+	// point lights first, then spot lights
+	std::vector<ClusterLightData> m_light_data;
+
+	bool m_enabled = true;
+	bool m_params_dirty = true;
+	bool m_needs_assign = true;
+	unsigned int m_uploaded_lights = 0;
+
+	glm::mat4 m_view = glm::mat4(0.0f);
+	glm::mat4 m_projection = glm::mat4(0.0f);
+	int m_width = 0;
+	int m_height = 0;
+
+	float m_near = 0.1f;
+	float m_far = 100.0f;
+	float m_slice_scale = 1.0f;
+	float m_slice_bias = 0.0f;
+
+	// (offset, count) per cluster, and the light indices they point into
+	std::vector<unsigned int> m_grid;
+	std::vector<unsigned int> m_indices;
+	// (cluster, light) pairs found by the assignment, sorted into m_indices by cluster
+	std::vector<glm::uvec2> m_pairs;
+
+	struct SliceBounds
+	{
+		float near, far;
+	};
+	SliceBounds m_slices[grid_z];
+
+	unsigned int createTextureBuffer(unsigned int& buffer, unsigned int format, unsigned int size)
+	{
+		glGenBuffers(1, &buffer);
+		glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+		glBufferData(GL_TEXTURE_BUFFER, size, NULL, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+		unsigned int texture;
+		glGenTextures(1, &texture);
+		gl_state.bindTexture(lights_unit, GL_TEXTURE_BUFFER, texture);
+		glTexBuffer(GL_TEXTURE_BUFFER, format, buffer);
+
+		return texture;
+	}
+
+	/**
+	writes the dirty lights and uploads the range of the buffer they span,
+	returns true if any light changed
+	*/
+	bool uploadLights()
+	{
+		unsigned int first = m_light_data.size();
+		unsigned int last = 0;
+
+		for (unsigned int i = 0; i < m_point_lights.size(); ++i)
+		{
+			if (!m_point_lights[i]->dirty)
+				continue;
+			m_point_lights[i]->writeData(m_light_data[i]);
+			m_point_lights[i]->dirty = false;
+			first = std::min(first, i);
+			last = std::max(last, i);
+		}
+		for (unsigned int i = 0; i < m_spot_lights.size(); ++i)
+		{
+			if (!m_spot_lights[i]->dirty)
+				continue;
+			unsigned int index = m_point_lights.size() + i;
+			m_spot_lights[i]->writeData(m_light_data[index]);
+			m_spot_lights[i]->dirty = false;
+			first = std::min(first, index);
+			last = std::max(last, index);
+		}
+
+		if (first > last)
+			return false;
+
+		glBindBuffer(GL_TEXTURE_BUFFER, m_light_buffer);
+		if (m_light_data.size() > m_light_capacity)
+		{
+			// grown, everything is uploaded again
+			m_light_capacity = std::max((unsigned int)m_light_data.size(), m_light_capacity * 2);
+			glBufferData(GL_TEXTURE_BUFFER, m_light_capacity * sizeof(ClusterLightData), NULL, GL_DYNAMIC_DRAW);
+			first = 0;
+			last = m_light_data.size() - 1;
+		}
+		glBufferSubData(GL_TEXTURE_BUFFER, first * sizeof(ClusterLightData), (last - first + 1) * sizeof(ClusterLightData), &m_light_data[first]);
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+		return true;
+	}
+
+	void uploadParams()
+	{
+		// near and far plane from the perspective projection
+		m_near = m_projection[3][2] / (m_projection[2][2] - 1.0f);
+		m_far = m_projection[3][2] / (m_projection[2][2] + 1.0f);
+
+		// slice = log(depth) * scale + bias, so slice 0 starts at near and grid_z ends at far
+		float log_ratio = glm::log(m_far / m_near);
+		m_slice_scale = grid_z / log_ratio;
+		m_slice_bias = -(float)grid_z * glm::log(m_near) / log_ratio;
+
+		for (unsigned int z = 0; z < grid_z; ++z)
+		{
+			m_slices[z].near = m_near * glm::pow(m_far / m_near, (float)z / grid_z);
+			m_slices[z].far = m_near * glm::pow(m_far / m_near, (float)(z + 1) / grid_z);
+		}
+
+		ClusterParams params;
+		params.dims[0] = grid_x;
+		params.dims[1] = grid_y;
+		params.dims[2] = grid_z;
+		params.dims[3] = m_light_data.size();
+		params.params[0] = (float)grid_x / m_width;
+		params.params[1] = (float)grid_y / m_height;
+		params.params[2] = m_slice_scale;
+		params.params[3] = m_slice_bias;
+		params.flags[0] = m_enabled ? 1 : 0;
+		params.flags[1] = params.flags[2] = params.flags[3] = 0;
+
+		glBindBuffer(GL_UNIFORM_BUFFER, m_ubo);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(ClusterParams), &params);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+		m_params_dirty = false;
+		m_uploaded_lights = m_light_data.size();
+	}
+
+	// view space x or y at the given depth for an ndc coordinate, off is the projection's skew term
+	float viewCoord(float ndc, float depth, float scale, float off)
+	{
+		return (ndc + off) * depth / scale;
+	}
+
+	void assign()
+	{
+		m_pairs.clear();
+
+		const glm::mat4& P = m_projection;
+		float tile_ndc_x = 2.0f / grid_x;
+		float tile_ndc_y = 2.0f / grid_y;
+
+		for (unsigned int i = 0; i < m_light_data.size(); ++i)
+		{
+			glm::vec4 light = m_light_data[i].position_radius;
+			float radius = light.w;
+			if (radius <= 0.0f)
+				continue;
+
+			glm::vec3 center = glm::vec3(m_view * glm::vec4(glm::vec3(light), 1.0f));
+			float depth = -center.z;
+			if (depth + radius < m_near || depth - radius > m_far)
+				continue;
+
+			// depth slices the sphere spans
+			int z0 = sliceOf(glm::max(depth - radius, m_near));
+			int z1 = sliceOf(glm::min(depth + radius, m_far));
+
+			// screen tiles its view space box covers, all of them if part of it is behind the near plane
+			int x0 = 0, x1 = grid_x - 1, y0 = 0, y1 = grid_y - 1;
+			if (depth - radius > m_near)
+			{
+				glm::vec2 ndc_min = glm::vec2(1e30f);
+				glm::vec2 ndc_max = glm::vec2(-1e30f);
+				for (unsigned int c = 0; c < 8; ++c)
+				{
+					glm::vec3 corner = center + glm::vec3(c & 1 ? radius : -radius, c & 2 ? radius : -radius, c & 4 ? radius : -radius);
+					glm::vec4 clip = P * glm::vec4(corner, 1.0f);
+					glm::vec2 ndc = glm::vec2(clip.x, clip.y) / clip.w;
+					ndc_min = glm::min(ndc_min, ndc);
+					ndc_max = glm::max(ndc_max, ndc);
+				}
+				if (ndc_max.x < -1.0f || ndc_min.x > 1.0f || ndc_max.y < -1.0f || ndc_min.y > 1.0f)
+					continue;
+
+				x0 = glm::clamp((int)((ndc_min.x + 1.0f) / tile_ndc_x), 0, (int)grid_x - 1);
+				x1 = glm::clamp((int)((ndc_max.x + 1.0f) / tile_ndc_x), 0, (int)grid_x - 1);
+				y0 = glm::clamp((int)((ndc_min.y + 1.0f) / tile_ndc_y), 0, (int)grid_y - 1);
+				y1 = glm::clamp((int)((ndc_max.y + 1.0f) / tile_ndc_y), 0, (int)grid_y - 1);
+			}
+
+			// each cluster's view space box is tested against the sphere
+			float radius2 = radius * radius;
+			for (int z = z0; z <= z1; ++z)
+			{
+				float near = m_slices[z].near;
+				float far = m_slices[z].far;
+				float dz = depth < near ? near - depth : (depth > far ? depth - far : 0.0f);
+
+				for (int y = y0; y <= y1; ++y)
+				{
+					float ndc_y0 = y * tile_ndc_y - 1.0f;
+					float ndc_y1 = ndc_y0 + tile_ndc_y;
+					float min_y = glm::min(viewCoord(ndc_y0, near, P[1][1], P[2][1]), viewCoord(ndc_y0, far, P[1][1], P[2][1]));
+					float max_y = glm::max(viewCoord(ndc_y1, near, P[1][1], P[2][1]), viewCoord(ndc_y1, far, P[1][1], P[2][1]));
+					float dy = center.y < min_y ? min_y - center.y : (center.y > max_y ? center.y - max_y : 0.0f);
+					if (dz * dz + dy * dy > radius2)
+						continue;
+
+					for (int x = x0; x <= x1; ++x)
+					{
+						float ndc_x0 = x * tile_ndc_x - 1.0f;
+						float ndc_x1 = ndc_x0 + tile_ndc_x;
+						float min_x = glm::min(viewCoord(ndc_x0, near, P[0][0], P[2][0]), viewCoord(ndc_x0, far, P[0][0], P[2][0]));
+						float max_x = glm::max(viewCoord(ndc_x1, near, P[0][0], P[2][0]), viewCoord(ndc_x1, far, P[0][0], P[2][0]));
+						float dx = center.x < min_x ? min_x - center.x : (center.x > max_x ? center.x - max_x : 0.0f);
+						if (dz * dz + dy * dy + dx * dx > radius2)
+							continue;
+
+						m_pairs.push_back(glm::uvec2((z * grid_y + y) * grid_x + x, i));
+					}
+				}
+			}
+		}
+
+		// count, prefix sum, then fill each cluster's range of the index list
+		std::fill(m_grid.begin(), m_grid.end(), 0);
+		for (unsigned int i = 0; i < m_pairs.size(); ++i)
+			++m_grid[m_pairs[i].x * 2 + 1];
+
+		unsigned int offset = 0;
+		unsigned int used_clusters = 0;
+		stats.max_lights = 0;
+		for (unsigned int i = 0; i < num_clusters; ++i)
+		{
+			unsigned int count = m_grid[i * 2 + 1];
+			m_grid[i * 2] = offset;
+			m_grid[i * 2 + 1] = 0;
+			offset += count;
+
+			stats.max_lights = std::max(stats.max_lights, count);
+			if (count > 0)
+				++used_clusters;
+		}
+		stats.average_lights = used_clusters > 0 ? (float)m_pairs.size() / used_clusters : 0.0f;
+
+		m_indices.resize(m_pairs.size());
+		for (unsigned int i = 0; i < m_pairs.size(); ++i)
+		{
+			unsigned int cluster = m_pairs[i].x;
+			m_indices[m_grid[cluster * 2] + m_grid[cluster * 2 + 1]++] = m_pairs[i].y;
+		}
+
+		glBindBuffer(GL_TEXTURE_BUFFER, m_grid_buffer);
+		glBufferSubData(GL_TEXTURE_BUFFER, 0, m_grid.size() * sizeof(unsigned int), m_grid.data());
+
+		if (!m_indices.empty())
+		{
+			glBindBuffer(GL_TEXTURE_BUFFER, m_indices_buffer);
+			if (m_indices.size() > m_indices_capacity)
+			{
+				m_indices_capacity = std::max((unsigned int)m_indices.size(), m_indices_capacity * 2);
+				glBufferData(GL_TEXTURE_BUFFER, m_indices_capacity * sizeof(unsigned int), NULL, GL_DYNAMIC_DRAW);
+			}
+			glBufferSubData(GL_TEXTURE_BUFFER, 0, m_indices.size() * sizeof(unsigned int), m_indices.data());
+		}
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
+	}
+
+	int sliceOf(float depth)
+	{
+		return glm::clamp((int)(glm::log(depth) * m_slice_scale + m_slice_bias), 0, (int)grid_z - 1);
+	}
+};
\ No newline at end of file
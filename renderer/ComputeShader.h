@@ -0,0 +1,136 @@
+#pragma once
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "GLExtensions.h"
+#include "GLState.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+class ComputeShader
+{
+public:
+	unsigned int m_ID;
+
+	/**
+	defines are inserted after the #version line, with the line numbers of errors kept the same as the file's
+	*/
+	ComputeShader(const char* compute_path, const std::string& defines = "")
+	{
+		std::string code;
+		std::ifstream file;
+		file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+		try
+		{
+			file.open(compute_path);
+			std::stringstream stream;
+			stream << file.rdbuf();
+			file.close();
+			code = stream.str();
+		}
+		catch (std::ifstream::failure& e)
+		{
+			std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ: " << compute_path << std::endl;
+		}
+		size_t line_end = code.find('\n');
+		if (!defines.empty() && line_end != std::string::npos)
+			code = code.substr(0, line_end + 1) + defines + "#line 2\n" + code.substr(line_end + 1);
+		const char* source = code.c_str();
+
+		unsigned int compute = glCreateShader(GL_COMPUTE_SHADER);
+		glShaderSource(compute, 1, &source, NULL);
+		glCompileShader(compute);
+		checkErrors(compute, "COMPUTE");
+
+		m_ID = glCreateProgram();
+		glAttachShader(m_ID, compute);
+		glLinkProgram(m_ID);
+		checkErrors(m_ID, "PROGRAM");
+
+		glDeleteShader(compute);
+	}
+	~ComputeShader()
+	{
+		glDeleteProgram(m_ID);
+	}
+
+	void use()
+	{
+		gl_state.useProgram(m_ID);
+	}
+
+	/**
+	dispatches enough work groups to cover the given number of invocations
+	*/
+	void dispatch(unsigned int invocations_x, unsigned int invocations_y, unsigned int invocations_z, unsigned int group_x, unsigned int group_y = 1, unsigned int group_z = 1)
+	{
+		glDispatchCompute((invocations_x + group_x - 1) / group_x, (invocations_y + group_y - 1) / group_y, (invocations_z + group_z - 1) / group_z);
+	}
+
+	unsigned int uniformLoc(const std::string& name)
+	{
+		return glGetUniformLocation(m_ID, name.c_str());
+	}
+	void setBool(const std::string& name, bool value)
+	{
+		glUniform1i(uniformLoc(name), (int)value);
+	}
+	void setInt(const std::string& name, int value)
+	{
+		glUniform1i(uniformLoc(name), value);
+	}
+	void setUInt(const std::string& name, unsigned int value)
+	{
+		glUniform1ui(uniformLoc(name), value);
+	}
+	void setFloat(const std::string& name, float value)
+	{
+		glUniform1f(uniformLoc(name), value);
+	}
+	void setVec2(const std::string& name, const glm::vec2& value)
+	{
+		glUniform2f(uniformLoc(name), value.x, value.y);
+	}
+	void setVec3(const std::string& name, const glm::vec3& value)
+	{
+		glUniform3f(uniformLoc(name), value.x, value.y, value.z);
+	}
+	void setVec4(const std::string& name, const glm::vec4& value)
+	{
+		glUniform4f(uniformLoc(name), value.x, value.y, value.z, value.w);
+	}
+	void setMat4(const std::string& name, const glm::mat4& value)
+	{
+		glUniformMatrix4fv(uniformLoc(name), 1, GL_FALSE, glm::value_ptr(value));
+	}
+
+private:
+	void checkErrors(unsigned int object, const std::string& type)
+	{
+		int success;
+		char info_log[1024];
+		if (type != "PROGRAM")
+		{
+			glGetShaderiv(object, GL_COMPILE_STATUS, &success);
+			if (!success)
+			{
+				glGetShaderInfoLog(object, 1024, NULL, info_log);
+				std::cout << "ERROR::SHADER::" << type << "::COMPILATION_FAILED\n" << info_log << std::endl;
+			}
+		}
+		else
+		{
+			glGetProgramiv(object, GL_LINK_STATUS, &success);
+			if (!success)
+			{
+				glGetProgramInfoLog(object, 1024, NULL, info_log);
+				std::cout << "ERROR::PROGRAM::LINKING_FAILED\n" << info_log << std::endl;
+			}
+		}
+	}
+};
\ No newline at end of file
@@ -0,0 +1,249 @@
+#pragma once
+
+/**
+scoped zones of CPU time, written as a Chrome trace that chrome://tracing and Perfetto open. CPU_ZONE
+times the rest of the block it's in, CPU_THREAD names the calling thread in the trace and CPU_FRAME
+marks where a frame starts. CPU_ZONE_BEGIN and CPU_ZONE_END time what's between them in the same block,
+for code that can't be put in a block of its own. each thread records into a ring of its own that only it writes, so a zone
+costs two clock reads and a few atomic flags, no locks; a thread takes the lock once, the first time it records.
+while a capture is copied out of the rings, threads wait to record rather than write under the copy. the
+rings keep the last buffer_events zones of each thread, a capture of more frames than that loses the oldest.
+building with CPU_PROFILER defined to 0 compiles all of it out, the macros then expand to nothing
+*/
+#ifndef CPU_PROFILER
+#define CPU_PROFILER 1
+#endif
+
+#if CPU_PROFILER
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <cstdint>
+#include <algorithm>
+
+struct CpuProfilerStats
+{
+	unsigned int frame = 0;		// of the last CPU_FRAME
+	unsigned int threads = 0;	// that have recorded a zone
+	bool capturing = false;		// frames for a trace, it's written once the last of them ends
+};
+
+class CpuProfiler
+{
+public:
+	static const unsigned int buffer_events = 1 << 16;	// of each thread
+
+	// nanoseconds of a steady clock
+	static uint64_t now()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	// name has to outlive the profiler, like the string literals the macros pass
+	void record(const char* name, uint64_t begin, uint64_t end)
+	{
+		Buffer& buffer = threadBuffer();
+		// the copy sets m_copying and then waits for writing to clear, the order of the flags means it
+		// either sees this zone being written or this sees the copy and waits for it to finish
+		buffer.writing.store(true);
+		while (m_copying.load())
+		{
+			buffer.writing.store(false);
+			while (m_copying.load())
+				std::this_thread::yield();
+			buffer.writing.store(true);
+		}
+		buffer.events[buffer.head % buffer_events] = { name, begin, end };
+		++buffer.head;
+		buffer.writing.store(false);
+	}
+
+	void setThreadName(const char* name)
+	{
+		threadBuffer().name.store(name);
+	}
+
+	// from the thread that runs the frames, the last frame is recorded as a zone of its own
+	void beginFrame()
+	{
+		uint64_t time = now();
+		if (m_frame_start)
+			record("frame", m_frame_start, time);
+		m_frame_start = time;
+		++stats.frame;
+
+		if (!stats.capturing || stats.frame < m_capture_first)
+			return;
+		if (stats.frame == m_capture_first)
+			m_capture_begin = time;
+		if (stats.frame == m_capture_first + m_capture_count)
+		{
+			stats.capturing = false;
+			if (writeTrace(m_capture_path, m_capture_begin, time))
+				std::cout << "cpu trace of frames " << m_capture_first << " to " << m_capture_first + m_capture_count - 1 << " written to " << m_capture_path << std::endl;
+		}
+	}
+
+	/**
+	writes a trace of count frames from frame first to path once they're done, the frame CPU_FRAME starts
+	next is stats.frame + 1. frames that have already started are captured from the next one
+	*/
+	void capture(unsigned int first, unsigned int count, const std::string& path)
+	{
+		m_capture_first = std::max(first, stats.frame + 1);
+		m_capture_count = std::max(count, 1u);
+		m_capture_path = path;
+		stats.capturing = true;
+	}
+
+	// the zones that ended after begin and by end, as Chrome's trace event json
+	std::string trace(uint64_t begin, uint64_t end)
+	{
+		std::ostringstream out;
+		out << std::fixed << std::setprecision(3);
+		out << "{\n\"displayTimeUnit\": \"ns\",\n\"traceEvents\": [\n";
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		std::vector<std::vector<Event>> events(m_buffers.size());
+		copyEvents(begin, end, events);
+
+		bool first = true;
+		for (unsigned int i = 0; i < m_buffers.size(); ++i)
+		{
+			const char* name = m_buffers[i]->name.load();
+			out << (first ? "" : ",\n") << "{ \"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << i << ", \"args\": { \"name\": \""
+				<< (name ? name : "thread " + std::to_string(i)) << "\" } }";
+			first = false;
+
+			for (const Event& event : events[i])
+			{
+				uint64_t event_begin = std::max(event.begin, begin);
+				out << ",\n{ \"name\": \"" << event.name << "\", \"cat\": \"cpu\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << i
+					<< ", \"ts\": " << (event_begin - begin) / 1000.0 << ", \"dur\": " << (event.end - event_begin) / 1000.0 << " }";
+			}
+		}
+		out << "\n]\n}\n";
+		return out.str();
+	}
+
+	bool writeTrace(const std::string& path, uint64_t begin, uint64_t end)
+	{
+		std::ofstream file(path);
+		if (file << trace(begin, end))
+			return true;
+		std::cout << "ERROR::CPU_PROFILER::COULD_NOT_WRITE " << path << std::endl;
+		return false;
+	}
+
+	CpuProfilerStats stats;
+
+private:
+	struct Event
+	{
+		const char* name;
+		uint64_t begin;
+		uint64_t end;
+	};
+
+	struct Buffer
+	{
+		Event events[buffer_events];
+		uint32_t head = 0;	// zones recorded so far, the ring has the last buffer_events of them
+		std::atomic<bool> writing{ false };	// while its thread writes a zone
+		std::atomic<const char*> name{ nullptr };
+	};
+
+	// every thread's, they live as long as the profiler so a thread that has ended still shows up
+	std::vector<std::unique_ptr<Buffer>> m_buffers;
+	std::mutex m_mutex;
+	std::atomic<bool> m_copying{ false };	// while the rings are copied for a trace
+
+	uint64_t m_frame_start = 0;
+	uint64_t m_capture_begin = 0;
+	unsigned int m_capture_first = 0;
+	unsigned int m_capture_count = 0;
+	std::string m_capture_path;
+
+	Buffer& threadBuffer()
+	{
+		thread_local Buffer* buffer = nullptr;
+		if (!buffer)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_buffers.push_back(std::make_unique<Buffer>());
+			buffer = m_buffers.back().get();
+			stats.threads = m_buffers.size();
+		}
+		return *buffer;
+	}
+
+	// the zones of each ring that ended after begin and by end, with m_mutex held
+	void copyEvents(uint64_t begin, uint64_t end, std::vector<std::vector<Event>>& events)
+	{
+		m_copying.store(true);
+		for (const std::unique_ptr<Buffer>& buffer : m_buffers)
+		{
+			while (buffer->writing.load())
+				std::this_thread::yield();
+		}
+
+		for (unsigned int i = 0; i < m_buffers.size(); ++i)
+		{
+			const Buffer& buffer = *m_buffers[i];
+			uint32_t oldest = buffer.head > buffer_events ? buffer.head - buffer_events : 0;
+			for (uint32_t j = oldest; j != buffer.head; ++j)
+			{
+				const Event& event = buffer.events[j % buffer_events];
+				if (event.end > begin && event.end <= end)
+					events[i].push_back(event);
+			}
+		}
+		m_copying.store(false);
+	}
+};
+
+CpuProfiler cpu_profiler;
+
+class CpuZone
+{
+public:
+	CpuZone(const char* name) : m_name(name), m_begin(CpuProfiler::now())
+	{
+	}
+	~CpuZone()
+	{
+		cpu_profiler.record(m_name, m_begin, CpuProfiler::now());
+	}
+
+private:
+	const char* m_name;
+	uint64_t m_begin;
+};
+
+#define CPU_ZONE_CONCAT_INNER(a, b) a##b
+#define CPU_ZONE_CONCAT(a, b) CPU_ZONE_CONCAT_INNER(a, b)
+#define CPU_ZONE(name) CpuZone CPU_ZONE_CONCAT(cpu_zone_, __LINE__)(name)
+// name is an identifier, not a string
+#define CPU_ZONE_BEGIN(name) uint64_t cpu_zone_begin_##name = CpuProfiler::now()
+#define CPU_ZONE_END(name) cpu_profiler.record(#name, cpu_zone_begin_##name, CpuProfiler::now())
+#define CPU_THREAD(name) cpu_profiler.setThreadName(name)
+#define CPU_FRAME() cpu_profiler.beginFrame()
+
+#else
+
+#define CPU_ZONE(name)
+#define CPU_ZONE_BEGIN(name)
+#define CPU_ZONE_END(name)
+#define CPU_THREAD(name)
+#define CPU_FRAME()
+
+#endif
\ No newline at end of file
@@ -0,0 +1,126 @@
+#pragma once
+#include <glad/glad.h>
+
+#include "QueryRing.h"
+
+#include <iostream>
+
+enum DepthPrepassMode
+{
+	DEPTH_PREPASS_OFF,
+	DEPTH_PREPASS_ON,
+	DEPTH_PREPASS_AUTO
+};
+
+/**
+decides whether the opaque geometry gets a depth only pass before it is shaded.
+with the pre-pass on, the samples passing the depth pass are what the shading pass would
+run without it and the samples passing the GL_EQUAL shading pass are the visible ones, so
+their ratio is the overdraw the pre-pass saves. in auto mode the pre-pass stays on while
+that ratio is above the threshold, and while it's off a single pre-pass frame is run every
+probe_interval frames to measure the scene again. query results are read a few frames
+late so the CPU never waits on the GPU.
+*/
+class DepthPrepass
+{
+public:
+	DepthPrepassMode mode = DEPTH_PREPASS_AUTO;
+
+	// shaded samples per visible sample needed for the pre-pass to pay off
+	float threshold = 1.5f;
+	unsigned int probe_interval = 120;
+
+	/**
+	returns if this frame should draw the pre-pass
+	*/
+	bool beginFrame()
+	{
+		readResults();
+
+		if (mode == DEPTH_PREPASS_OFF)
+			m_current = false;
+		else if (mode == DEPTH_PREPASS_ON)
+			m_current = true;
+		else
+			m_current = m_enabled || m_frames_since_probe >= probe_interval;
+
+		if (m_current)
+			m_frames_since_probe = 0;
+		else
+			++m_frames_since_probe;
+
+		return m_current;
+	}
+
+	void beginDepthQuery()
+	{
+		glBeginQuery(GL_SAMPLES_PASSED, m_queries.query(0));
+	}
+	void endDepthQuery()
+	{
+		glEndQuery(GL_SAMPLES_PASSED);
+	}
+	void beginShadeQuery()
+	{
+		if (m_current)
+			glBeginQuery(GL_SAMPLES_PASSED, m_queries.query(1));
+	}
+	void endShadeQuery()
+	{
+		if (m_current)
+			glEndQuery(GL_SAMPLES_PASSED);
+	}
+
+	void endFrame()
+	{
+		m_queries.endFrame(m_current);
+	}
+
+	bool enabled()
+	{
+		return m_current;
+	}
+
+	// shaded samples per visible sample from the last measured frame
+	float overdraw()
+	{
+		return m_overdraw;
+	}
+
+	// samples that passed the shading pass in the last measured frame, the visible ones
+	unsigned int shadedSamples()
+	{
+		return m_shaded_samples;
+	}
+	// samples the pre-pass wrote in the last measured frame
+	unsigned int depthSamples()
+	{
+		return m_depth_samples;
+	}
+
+private:
+	// the samples of the depth pass and of the shading pass
+	QueryRing m_queries{ 2 };
+
+	bool m_current = false;
+	bool m_enabled = false;
+	unsigned int m_frames_since_probe = 0;
+	float m_overdraw = 1.0f;
+	unsigned int m_shaded_samples = 0;
+	unsigned int m_depth_samples = 0;
+
+	void readResults()
+	{
+		if (!m_queries.readResults())
+			return;
+
+		m_depth_samples = (unsigned int)m_queries.result(0);
+		m_shaded_samples = (unsigned int)m_queries.result(1);
+		m_overdraw = m_shaded_samples > 0 ? (float)m_depth_samples / (float)m_shaded_samples : 1.0f;
+
+		bool enabled = m_overdraw > threshold;
+		if (enabled != m_enabled && mode == DEPTH_PREPASS_AUTO)
+			std::cout << "depth pre-pass " << (enabled ? "on" : "off") << ", overdraw " << m_overdraw << std::endl;
+		m_enabled = enabled;
+	}
+};
\ No newline at end of file
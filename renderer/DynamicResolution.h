@@ -0,0 +1,122 @@
+#pragma once
+#include <glad/glad.h>
+
+#include "GpuTimer.h"
+
+#include <cmath>
+#include <algorithm>
+
+struct DynamicResolutionStats
+{
+	float scale = 1.0f;			// of the width and height of the render targets the frame uses
+	float gpu_ms = 0.0f;		// of the last measured frame
+	float budget_ms = 0.0f;
+	unsigned int width = 0;		// of the last size asked for
+	unsigned int height = 0;
+	unsigned int changes = 0;	// of the scale so far
+};
+
+/**
+picks the resolution to render each frame at from how long the GPU took for the last ones. the frame is
+drawn into the corner of render targets of the full size and stretched to the window afterwards, so
+changing the scale never reallocates anything. the time is measured from begin() to end() with a
+GpuTimer, the scale follows it to stay a little under the budget: down quickly when a frame is over,
+back up slowly, and not again until the frames drawn at the new scale have been measured
+*/
+class DynamicResolution
+{
+public:
+	DynamicResolution(float budget_ms, float min_scale = 0.5f, float max_scale = 1.0f) : m_min_scale(min_scale), m_max_scale(max_scale)
+	{
+		stats.budget_ms = budget_ms;
+		stats.scale = max_scale;
+	}
+
+	void setBudget(float budget_ms)
+	{
+		stats.budget_ms = budget_ms;
+	}
+
+	// back to the full size when disabled, the timer still runs
+	void setEnabled(bool enabled)
+	{
+		m_enabled = enabled;
+		if (!enabled)
+			stats.scale = m_max_scale;
+	}
+	bool enabled()
+	{
+		return m_enabled;
+	}
+
+	// before the GL commands of the frame
+	void begin()
+	{
+		m_timer.begin();
+		if (m_timer.samples() == m_samples)
+			return;
+		m_samples = m_timer.samples();
+		stats.gpu_ms = m_timer.ms();
+
+		// the timer is a few frames behind, wait until it measures frames drawn at the new scale
+		if (m_settle > 0)
+		{
+			--m_settle;
+			return;
+		}
+		if (!m_enabled || stats.gpu_ms <= 0.0f)
+			return;
+
+		// the time goes with the number of pixels, so with the square of the scale
+		float target_ms = stats.budget_ms * target_fraction;
+		float ratio = target_ms / stats.gpu_ms;
+		if (std::abs(ratio - 1.0f) < deadband)
+			return;
+		float step = std::sqrt(ratio);
+		if (step > 1.0f)
+			step = 1.0f + (step - 1.0f) * raise_damping;
+
+		float scale = std::clamp(stats.scale * step, m_min_scale, m_max_scale);
+		if (std::abs(scale - stats.scale) < min_change)
+			return;
+		stats.scale = scale;
+		++stats.changes;
+		m_settle = settle_samples;
+	}
+	void end()
+	{
+		m_timer.end();
+	}
+
+	// of the frame in render targets of width by height, in multiples of 8 so the scale changes in steps
+	// a tile of the compute passes never straddles
+	void size(unsigned int width, unsigned int height, unsigned int& scaled_width, unsigned int& scaled_height)
+	{
+		scaled_width = roundSize(width * stats.scale, width);
+		scaled_height = roundSize(height * stats.scale, height);
+		stats.width = scaled_width;
+		stats.height = scaled_height;
+	}
+
+	DynamicResolutionStats stats;
+
+private:
+	static constexpr float target_fraction = 0.9f;	// of the budget, to leave room for frames that take a bit longer
+	static constexpr float deadband = 0.05f;			// around the target, where the scale is left alone
+	static constexpr float raise_damping = 0.5f;		// of the steps up, the ones down are taken whole
+	static constexpr float min_change = 0.01f;
+	static const unsigned int settle_samples = 4;
+
+	GpuTimer m_timer;
+	float m_min_scale;
+	float m_max_scale;
+	bool m_enabled = true;
+	unsigned int m_samples = 0;
+	unsigned int m_settle = 0;
+
+	static unsigned int roundSize(float size, unsigned int full)
+	{
+		unsigned int rounded = (unsigned int)std::round(size / 8.0f) * 8;
+		return std::clamp(rounded, std::min(8u, full), full);
+	}
+};
\ No newline at end of file
@@ -0,0 +1,160 @@
+#pragma once
+#include <glad/glad.h>
+
+#include "GLState.h"
+#include "QueryRing.h"
+
+#include <iostream>
+
+/**
+the geometry buffer of the deferred path, 12 bytes a pixel:
+albedo and specular intensity in RGBA8, an octahedral normal and shininess in RGB10_A2,
+and depth, from which the lighting pass reconstructs the position.
+it also counts the samples the geometry pass writes so its bandwidth can be estimated
+*/
+class GBuffer
+{
+public:
+	static const unsigned int albedo_unit = 11;
+	static const unsigned int normal_unit = 12;
+	static const unsigned int depth_unit = 13;
+
+	static const unsigned int bytes_per_pixel = 12;
+
+	static const unsigned int albedo_format = GL_RGBA8;
+	static const unsigned int normal_format = GL_RGB10_A2;
+	static const unsigned int depth_format = GL_DEPTH24_STENCIL8;
+
+	unsigned int fbo;
+
+	GBuffer(int width, int height)
+	{
+		glGenFramebuffers(1, &fbo);
+		glGenTextures(1, &m_albedo);
+		glGenTextures(1, &m_normal);
+		glGenTextures(1, &m_depth);
+
+		resize(width, height);
+	}
+	~GBuffer()
+	{
+		glDeleteFramebuffers(1, &fbo);
+		deleteTextures();
+	}
+
+	void resize(int width, int height)
+	{
+		m_width = width;
+		m_height = height;
+		if (!m_owns_textures)
+			return;
+
+		allocate(m_albedo, albedo_format, GL_RGBA, GL_UNSIGNED_BYTE);
+		allocate(m_normal, normal_format, GL_RGBA, GL_UNSIGNED_INT_2_10_10_10_REV);
+		allocate(m_depth, depth_format, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8);
+		attach();
+	}
+
+	/**
+	textures of the formats above at the G-buffer's size, allocated by the caller, which keeps them.
+	its own are freed, and from then on it's up to the caller to set new ones when it's resized.
+	they should be nearest filtered, the lighting pass reads them a texel at a time
+	*/
+	void setTextures(unsigned int albedo, unsigned int normal, unsigned int depth)
+	{
+		if (!m_owns_textures && albedo == m_albedo && normal == m_normal && depth == m_depth)
+			return;
+
+		deleteTextures();
+		m_owns_textures = false;
+		m_albedo = albedo;
+		m_normal = normal;
+		m_depth = depth;
+		attach();
+	}
+
+	int width()
+	{
+		return m_width;
+	}
+	int height()
+	{
+		return m_height;
+	}
+
+	void bindTextures()
+	{
+		gl_state.bindTexture(albedo_unit, GL_TEXTURE_2D, m_albedo);
+		gl_state.bindTexture(normal_unit, GL_TEXTURE_2D, m_normal);
+		gl_state.bindTexture(depth_unit, GL_TEXTURE_2D, m_depth);
+	}
+
+	void beginQuery()
+	{
+		if (m_queries.readResults())
+			m_written_samples = (unsigned int)m_queries.result();
+		glBeginQuery(GL_SAMPLES_PASSED, m_queries.query());
+	}
+	void endQuery()
+	{
+		glEndQuery(GL_SAMPLES_PASSED);
+		m_queries.endFrame();
+	}
+
+	// samples the geometry pass wrote in the last measured frame
+	unsigned int writtenSamples()
+	{
+		return m_written_samples;
+	}
+
+private:
+	unsigned int m_albedo;
+	unsigned int m_normal;
+	unsigned int m_depth;
+	bool m_owns_textures = true;
+
+	int m_width;
+	int m_height;
+
+	QueryRing m_queries;
+	unsigned int m_written_samples = 0;
+
+	void attach()
+	{
+		gl_state.bindFramebuffer(GL_FRAMEBUFFER, fbo);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_albedo, 0);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, m_normal, 0);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, m_depth, 0);
+
+		unsigned int attachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+		glDrawBuffers(2, attachments);
+
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		{
+			std::cout << "ERROR::FRAMEBUFFER:: G-buffer is not complete!" << std::endl;
+		}
+		gl_state.bindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+
+	void deleteTextures()
+	{
+		if (!m_owns_textures)
+			return;
+		glDeleteTextures(1, &m_albedo);
+		glDeleteTextures(1, &m_normal);
+		glDeleteTextures(1, &m_depth);
+		gl_state.forgetTexture(m_albedo);
+		gl_state.forgetTexture(m_normal);
+		gl_state.forgetTexture(m_depth);
+	}
+
+	void allocate(unsigned int texture, int internal_format, unsigned int format, unsigned int type)
+	{
+		gl_state.bindTexture(albedo_unit, GL_TEXTURE_2D, texture);
+		glTexImage2D(GL_TEXTURE_2D, 0, internal_format, m_width, m_height, 0, format, type, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	}
+};
\ No newline at end of file
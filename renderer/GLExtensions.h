@@ -0,0 +1,169 @@
+#pragma once
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <iostream>
+#include <cstring>
+
+/**
+the bundled glad loader only covers GL 3.3, so the 4.x entry points the renderer
+needs are declared and loaded here. if glad is regenerated with a newer version
+these sections are skipped and glad's own declarations are used instead.
+*/
+
+#ifndef GL_VERSION_4_0
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+
+typedef void (APIENTRYP PFNGLDRAWELEMENTSINDIRECTPROC)(GLenum mode, GLenum type, const void* indirect);
+
+PFNGLDRAWELEMENTSINDIRECTPROC glad_glDrawElementsIndirect = NULL;
+#define glDrawElementsIndirect glad_glDrawElementsIndirect
+#endif
+
+#ifndef GL_VERSION_4_1
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+
+typedef void (APIENTRYP PFNGLVIEWPORTINDEXEDFPROC)(GLuint index, GLfloat x, GLfloat y, GLfloat w, GLfloat h);
+typedef void (APIENTRYP PFNGLGETPROGRAMBINARYPROC)(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary);
+typedef void (APIENTRYP PFNGLPROGRAMBINARYPROC)(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length);
+typedef void (APIENTRYP PFNGLPROGRAMPARAMETERIPROC)(GLuint program, GLenum pname, GLint value);
+
+PFNGLVIEWPORTINDEXEDFPROC glad_glViewportIndexedf = NULL;
+#define glViewportIndexedf glad_glViewportIndexedf
+PFNGLGETPROGRAMBINARYPROC glad_glGetProgramBinary = NULL;
+#define glGetProgramBinary glad_glGetProgramBinary
+PFNGLPROGRAMBINARYPROC glad_glProgramBinary = NULL;
+#define glProgramBinary glad_glProgramBinary
+PFNGLPROGRAMPARAMETERIPROC glad_glProgramParameteri = NULL;
+#define glProgramParameteri glad_glProgramParameteri
+#endif
+
+#ifndef GL_VERSION_4_2
+#define GL_COMMAND_BARRIER_BIT 0x00000040
+#define GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT 0x00000001
+#define GL_TEXTURE_FETCH_BARRIER_BIT 0x00000008
+#define GL_SHADER_IMAGE_ACCESS_BARRIER_BIT 0x00000020
+
+typedef void (APIENTRYP PFNGLMEMORYBARRIERPROC)(GLbitfield barriers);
+typedef void (APIENTRYP PFNGLBINDIMAGETEXTUREPROC)(GLuint unit, GLuint texture, GLint level, GLboolean layered, GLint layer, GLenum access, GLenum format);
+typedef void (APIENTRYP PFNGLTEXSTORAGE2DPROC)(GLenum target, GLsizei levels, GLenum internalformat, GLsizei width, GLsizei height);
+
+PFNGLMEMORYBARRIERPROC glad_glMemoryBarrier = NULL;
+#define glMemoryBarrier glad_glMemoryBarrier
+PFNGLBINDIMAGETEXTUREPROC glad_glBindImageTexture = NULL;
+#define glBindImageTexture glad_glBindImageTexture
+PFNGLTEXSTORAGE2DPROC glad_glTexStorage2D = NULL;
+#define glTexStorage2D glad_glTexStorage2D
+#endif
+
+#ifndef GL_VERSION_4_3
+#define GL_COMPUTE_SHADER 0x91B9
+#define GL_SHADER_STORAGE_BUFFER 0x90D2
+#define GL_SHADER_STORAGE_BARRIER_BIT 0x00002000
+
+typedef void (APIENTRYP PFNGLDISPATCHCOMPUTEPROC)(GLuint num_groups_x, GLuint num_groups_y, GLuint num_groups_z);
+typedef void (APIENTRYP PFNGLTEXSTORAGE2DMULTISAMPLEPROC)(GLenum target, GLsizei samples, GLenum internalformat, GLsizei width, GLsizei height, GLboolean fixedsamplelocations);
+typedef void (APIENTRYP PFNGLTEXTUREVIEWPROC)(GLuint texture, GLenum target, GLuint origtexture, GLenum internalformat, GLuint minlevel, GLuint numlevels, GLuint minlayer, GLuint numlayers);
+
+PFNGLDISPATCHCOMPUTEPROC glad_glDispatchCompute = NULL;
+#define glDispatchCompute glad_glDispatchCompute
+PFNGLTEXSTORAGE2DMULTISAMPLEPROC glad_glTexStorage2DMultisample = NULL;
+#define glTexStorage2DMultisample glad_glTexStorage2DMultisample
+PFNGLTEXTUREVIEWPROC glad_glTextureView = NULL;
+#define glTextureView glad_glTextureView
+#endif
+
+// the ARB extension has the same tokens and an entry point of the same type
+#ifndef GL_KHR_parallel_shader_compile
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+
+typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+
+PFNGLMAXSHADERCOMPILERTHREADSKHRPROC glad_glMaxShaderCompilerThreadsKHR = NULL;
+#define glMaxShaderCompilerThreadsKHR glad_glMaxShaderCompilerThreadsKHR
+#endif
+
+struct GLCapabilities
+{
+	int major_version = 0;
+	int minor_version = 0;
+
+	bool compute = false; // compute shaders, SSBOs, image load/store and indirect draws (GL 4.3)
+	bool vertex_layer = false; // gl_Layer and gl_ViewportIndex from the vertex shader (ARB_shader_viewport_layer_array)
+	bool program_binary = false; // linked programs can be saved and loaded, in at least one format (GL 4.1)
+	bool parallel_compile = false; // compiles and links don't block and can be polled (KHR or ARB_parallel_shader_compile)
+	bool texture_views = false; // immutable textures can be viewed with another format of the same size (GL 4.3)
+};
+
+GLCapabilities gl_caps;
+
+bool hasGLVersion(int major, int minor)
+{
+	return gl_caps.major_version > major || (gl_caps.major_version == major && gl_caps.minor_version >= minor);
+}
+
+bool hasGLExtension(const char* name)
+{
+	int count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+	for (int i = 0; i < count; ++i)
+	{
+		if (strcmp((const char*)glGetStringi(GL_EXTENSIONS, i), name) == 0)
+			return true;
+	}
+	return false;
+}
+
+/**
+must be called after gladLoadGLLoader with the context current
+*/
+void loadGLExtensions()
+{
+	glGetIntegerv(GL_MAJOR_VERSION, &gl_caps.major_version);
+	glGetIntegerv(GL_MINOR_VERSION, &gl_caps.minor_version);
+
+#ifndef GL_VERSION_4_0
+	glad_glDrawElementsIndirect = (PFNGLDRAWELEMENTSINDIRECTPROC)glfwGetProcAddress("glDrawElementsIndirect");
+#endif
+#ifndef GL_VERSION_4_1
+	glad_glViewportIndexedf = (PFNGLVIEWPORTINDEXEDFPROC)glfwGetProcAddress("glViewportIndexedf");
+	glad_glGetProgramBinary = (PFNGLGETPROGRAMBINARYPROC)glfwGetProcAddress("glGetProgramBinary");
+	glad_glProgramBinary = (PFNGLPROGRAMBINARYPROC)glfwGetProcAddress("glProgramBinary");
+	glad_glProgramParameteri = (PFNGLPROGRAMPARAMETERIPROC)glfwGetProcAddress("glProgramParameteri");
+#endif
+#ifndef GL_VERSION_4_2
+	glad_glMemoryBarrier = (PFNGLMEMORYBARRIERPROC)glfwGetProcAddress("glMemoryBarrier");
+	glad_glBindImageTexture = (PFNGLBINDIMAGETEXTUREPROC)glfwGetProcAddress("glBindImageTexture");
+	glad_glTexStorage2D = (PFNGLTEXSTORAGE2DPROC)glfwGetProcAddress("glTexStorage2D");
+#endif
+#ifndef GL_VERSION_4_3
+	glad_glDispatchCompute = (PFNGLDISPATCHCOMPUTEPROC)glfwGetProcAddress("glDispatchCompute");
+	glad_glTexStorage2DMultisample = (PFNGLTEXSTORAGE2DMULTISAMPLEPROC)glfwGetProcAddress("glTexStorage2DMultisample");
+	glad_glTextureView = (PFNGLTEXTUREVIEWPROC)glfwGetProcAddress("glTextureView");
+#endif
+#ifndef GL_KHR_parallel_shader_compile
+	if (hasGLExtension("GL_KHR_parallel_shader_compile"))
+		glad_glMaxShaderCompilerThreadsKHR = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)glfwGetProcAddress("glMaxShaderCompilerThreadsKHR");
+	else if (hasGLExtension("GL_ARB_parallel_shader_compile"))
+		glad_glMaxShaderCompilerThreadsKHR = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)glfwGetProcAddress("glMaxShaderCompilerThreadsARB");
+#endif
+
+	gl_caps.compute = hasGLVersion(4, 3) && glDispatchCompute && glMemoryBarrier && glBindImageTexture && glDrawElementsIndirect;
+	gl_caps.vertex_layer = hasGLVersion(4, 1) && glViewportIndexedf && hasGLExtension("GL_ARB_shader_viewport_layer_array");
+	gl_caps.texture_views = hasGLVersion(4, 3) && glTexStorage2D && glTexStorage2DMultisample && glTextureView;
+
+	int binary_formats = 0;
+	if (hasGLVersion(4, 1))
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &binary_formats);
+	gl_caps.program_binary = binary_formats > 0 && glGetProgramBinary && glProgramBinary && glProgramParameteri;
+
+	// as many compiler threads as the driver wants to use
+	gl_caps.parallel_compile = glMaxShaderCompilerThreadsKHR != NULL;
+	if (gl_caps.parallel_compile)
+		glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+
+	std::cout << "OpenGL " << gl_caps.major_version << "." << gl_caps.minor_version << ", compute: " << gl_caps.compute << ", vertex layer: " << gl_caps.vertex_layer
+		<< ", program binaries: " << gl_caps.program_binary << ", parallel compile: " << gl_caps.parallel_compile << ", texture views: " << gl_caps.texture_views << std::endl;
+}
\ No newline at end of file
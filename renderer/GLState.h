@@ -0,0 +1,279 @@
+#pragma once
+#include <glad/glad.h>
+
+/**
+keeps a copy of the GL state the renderer changes and drops calls that would set it
+to what it already is. everything that binds programs, vertex arrays, textures or
+framebuffers, or changes blend, depth, cull or viewport state, should go through
+gl_state so the copy stays right. call invalidate if something else touched the state.
+*/
+
+struct GLStateStats
+{
+	unsigned int issued = 0;
+	unsigned int elided = 0;
+};
+
+class GLState
+{
+public:
+	static const unsigned int max_texture_units = 16;
+
+	// counts of the last finished frame
+	GLStateStats frame_stats;
+
+	GLState()
+	{
+		invalidate();
+	}
+
+	/**
+	forgets everything so the next call of each kind always reaches the driver
+	*/
+	void invalidate()
+	{
+		m_program = unknown;
+		m_vao = unknown;
+		m_active_unit = unknown;
+		for (unsigned int i = 0; i < max_texture_units; ++i)
+		{
+			for (unsigned int j = 0; j < num_texture_targets; ++j)
+				m_textures[i][j] = unknown;
+		}
+		for (unsigned int i = 0; i < num_caps; ++i)
+			m_caps[i] = unknown;
+
+		m_blend_src = unknown;
+		m_blend_dst = unknown;
+		m_depth_func = unknown;
+		m_depth_mask = unknown;
+		m_color_mask = unknown;
+		m_cull_face = unknown;
+		m_draw_framebuffer = unknown;
+		m_read_framebuffer = unknown;
+		m_viewport[0] = unknown;
+	}
+
+	void endFrame()
+	{
+		frame_stats = m_stats;
+		m_stats = GLStateStats();
+	}
+
+	void useProgram(unsigned int program)
+	{
+		if (changed(m_program, program))
+			glUseProgram(program);
+	}
+
+	void bindVertexArray(unsigned int vao)
+	{
+		if (changed(m_vao, vao))
+			glBindVertexArray(vao);
+	}
+
+	void activeTexture(unsigned int unit)
+	{
+		if (changed(m_active_unit, unit))
+			glActiveTexture(GL_TEXTURE0 + unit);
+	}
+
+	/**
+	binds texture to target on the given unit, the active unit is only changed if the binding is
+	*/
+	void bindTexture(unsigned int unit, unsigned int target, unsigned int texture)
+	{
+		int target_index = textureTargetIndex(target);
+		if (unit >= max_texture_units || target_index < 0)
+		{
+			activeTexture(unit);
+			glBindTexture(target, texture);
+			++m_stats.issued;
+			return;
+		}
+
+		if (!changed(m_textures[unit][target_index], texture))
+			return;
+
+		activeTexture(unit);
+		glBindTexture(target, texture);
+	}
+
+	// for textures that are deleted, so a new texture with the same name isn't thought to be bound
+	void forgetTexture(unsigned int texture)
+	{
+		for (unsigned int i = 0; i < max_texture_units; ++i)
+		{
+			for (unsigned int j = 0; j < num_texture_targets; ++j)
+			{
+				if (m_textures[i][j] == texture)
+					m_textures[i][j] = unknown;
+			}
+		}
+	}
+
+	void enable(unsigned int cap)
+	{
+		setCap(cap, true);
+	}
+	void disable(unsigned int cap)
+	{
+		setCap(cap, false);
+	}
+
+	void blendFunc(unsigned int src, unsigned int dst)
+	{
+		if (m_blend_src == src && m_blend_dst == dst)
+		{
+			++m_stats.elided;
+			return;
+		}
+		m_blend_src = src;
+		m_blend_dst = dst;
+		++m_stats.issued;
+		glBlendFunc(src, dst);
+	}
+
+	void depthFunc(unsigned int func)
+	{
+		if (changed(m_depth_func, func))
+			glDepthFunc(func);
+	}
+
+	void depthMask(bool write)
+	{
+		if (changed(m_depth_mask, write))
+			glDepthMask(write ? GL_TRUE : GL_FALSE);
+	}
+
+	void colorMask(bool write)
+	{
+		if (changed(m_color_mask, write))
+		{
+			GLboolean mask = write ? GL_TRUE : GL_FALSE;
+			glColorMask(mask, mask, mask, mask);
+		}
+	}
+
+	void cullFace(unsigned int face)
+	{
+		if (changed(m_cull_face, face))
+			glCullFace(face);
+	}
+
+	/**
+	GL_FRAMEBUFFER binds both the draw and the read framebuffer like glBindFramebuffer does
+	*/
+	void bindFramebuffer(unsigned int target, unsigned int fbo)
+	{
+		if (target == GL_FRAMEBUFFER)
+		{
+			if (m_draw_framebuffer == fbo && m_read_framebuffer == fbo)
+			{
+				++m_stats.elided;
+				return;
+			}
+			m_draw_framebuffer = fbo;
+			m_read_framebuffer = fbo;
+			++m_stats.issued;
+			glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+		}
+		else if (changed(target == GL_READ_FRAMEBUFFER ? m_read_framebuffer : m_draw_framebuffer, fbo))
+		{
+			glBindFramebuffer(target, fbo);
+		}
+	}
+
+	void viewport(int x, int y, int width, int height)
+	{
+		unsigned int viewport[4] = { (unsigned int)x, (unsigned int)y, (unsigned int)width, (unsigned int)height };
+		if (viewport[0] == m_viewport[0] && viewport[1] == m_viewport[1] && viewport[2] == m_viewport[2] && viewport[3] == m_viewport[3])
+		{
+			++m_stats.elided;
+			return;
+		}
+		for (unsigned int i = 0; i < 4; ++i)
+			m_viewport[i] = viewport[i];
+		++m_stats.issued;
+		glViewport(x, y, width, height);
+	}
+
+private:
+	static const unsigned int unknown = 0xFFFFFFFF;
+	static const unsigned int num_texture_targets = 5;
+	static const unsigned int num_caps = 6;
+
+	GLStateStats m_stats;
+
+	unsigned int m_program;
+	unsigned int m_vao;
+	unsigned int m_active_unit;
+	unsigned int m_textures[max_texture_units][num_texture_targets];
+	unsigned int m_caps[num_caps];
+
+	unsigned int m_blend_src;
+	unsigned int m_blend_dst;
+	unsigned int m_depth_func;
+	unsigned int m_depth_mask;
+	unsigned int m_color_mask;
+	unsigned int m_cull_face;
+	unsigned int m_draw_framebuffer;
+	unsigned int m_read_framebuffer;
+	unsigned int m_viewport[4];
+
+	// stores value and returns true if it's different from what was there
+	bool changed(unsigned int& current, unsigned int value)
+	{
+		if (current == value)
+		{
+			++m_stats.elided;
+			return false;
+		}
+		current = value;
+		++m_stats.issued;
+		return true;
+	}
+
+	int textureTargetIndex(unsigned int target)
+	{
+		switch (target)
+		{
+		case GL_TEXTURE_2D: return 0;
+		case GL_TEXTURE_CUBE_MAP: return 1;
+		case GL_TEXTURE_2D_MULTISAMPLE: return 2;
+		case GL_TEXTURE_2D_ARRAY: return 3;
+		case GL_TEXTURE_BUFFER: return 4;
+		}
+		return -1;
+	}
+
+	int capIndex(unsigned int cap)
+	{
+		switch (cap)
+		{
+		case GL_BLEND: return 0;
+		case GL_DEPTH_TEST: return 1;
+		case GL_CULL_FACE: return 2;
+		case GL_STENCIL_TEST: return 3;
+		case GL_MULTISAMPLE: return 4;
+		case GL_SCISSOR_TEST: return 5;
+		}
+		return -1;
+	}
+
+	void setCap(unsigned int cap, bool enabled)
+	{
+		int index = capIndex(cap);
+		if (index >= 0 && !changed(m_caps[index], enabled))
+			return;
+		if (index < 0)
+			++m_stats.issued;
+
+		if (enabled)
+			glEnable(cap);
+		else
+			glDisable(cap);
+	}
+};
+
+GLState gl_state;
\ No newline at end of file
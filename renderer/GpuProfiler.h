@@ -0,0 +1,354 @@
+#pragma once
+#include <glad/glad.h>
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+// of a scope over the last frames it was measured in
+struct GpuProfileStats
+{
+	std::string name;
+	unsigned int depth = 0;		// of its scope, the frame is 0
+	float last_ms = 0.0f;
+	float min_ms = 0.0f;
+	float avg_ms = 0.0f;
+	float p99_ms = 0.0f;
+	unsigned int samples = 0;	// in the window the others are of
+};
+
+/**
+gpu time of named scopes of a frame, like GpuTimer but for a whole frame of them. the scopes nest, each
+is timed with a pair of GL_TIMESTAMP queries, since GL_TIME_ELAPSED ones can't overlap. the queries of a
+ring of frames in flight are read once they're all available, so reading never waits on the GPU, and a
+frame still in flight when its queries are needed again is dropped. the stats are of the last window of
+frames each scope was measured in, in the order the scopes nest, each after its parent. stats has the
+scopes of the last frame read, json all of them
+*/
+class GpuProfiler
+{
+public:
+	static const unsigned int frames_in_flight = 4;
+	static const unsigned int window = 120;
+
+	~GpuProfiler()
+	{
+		for (unsigned int i = 0; i < frames_in_flight; ++i)
+		{
+			if (!m_frames[i].queries.empty())
+				glDeleteQueries(m_frames[i].queries.size(), m_frames[i].queries.data());
+		}
+	}
+
+	// starts the frame's scope, reading the results of the frames before it that are done
+	void beginFrame()
+	{
+		readResults();
+
+		Frame& frame = m_frames[m_frame];
+		if (frame.pending)
+		{
+			++m_dropped;
+			frame.pending = false;
+		}
+		frame.used = 0;
+		frame.records.clear();
+
+		m_in_frame = true;
+		begin("frame");
+	}
+	void endFrame()
+	{
+		while (!m_stack.empty())
+			end();
+		m_in_frame = false;
+
+		m_frames[m_frame].pending = true;
+		m_frame = (m_frame + 1) % frames_in_flight;
+	}
+
+	// a scope inside the one begun last, outside of a frame nothing is timed
+	void begin(const char* name)
+	{
+		if (!m_in_frame)
+			return;
+
+		unsigned int parent = m_stack.empty() ? no_scope : m_stack.back();
+		unsigned int scope = findScope(parent, name);
+		Frame& frame = m_frames[m_frame];
+		frame.records.push_back({ scope, query(frame), 0 });
+		m_stack.push_back(scope);
+		m_open.push_back(frame.records.size() - 1);
+	}
+	void end()
+	{
+		if (m_stack.empty())
+			return;
+
+		Frame& frame = m_frames[m_frame];
+		frame.records[m_open.back()].end_query = query(frame);
+		m_stack.pop_back();
+		m_open.pop_back();
+	}
+
+	const std::vector<GpuProfileStats>& stats()
+	{
+		return m_stats;
+	}
+
+	// frames whose results were never read, the GPU was more than frames_in_flight behind
+	unsigned int dropped()
+	{
+		return m_dropped;
+	}
+
+	// the stats of every scope, nested in their parents
+	std::string json()
+	{
+		std::ostringstream out;
+		out << "{\n\t\"frames_in_flight\": " << frames_in_flight << ",\n\t\"window\": " << window << ",\n\t\"frames\": " << m_frames_read
+			<< ",\n\t\"dropped\": " << m_dropped << ",\n\t\"scopes\": [";
+		for (unsigned int i = 0, first = 1; i < m_scopes.size(); ++i)
+		{
+			if (m_scopes[i].parent != no_scope)
+				continue;
+			out << (first ? "\n" : ",\n");
+			writeJson(out, i, 2);
+			first = 0;
+		}
+		out << "\n\t]\n}\n";
+		return out.str();
+	}
+
+	bool writeJson(const std::string& path)
+	{
+		std::ofstream file(path);
+		if (file << json())
+			return true;
+		std::cout << "ERROR::GPU_PROFILER::COULD_NOT_WRITE " << path << std::endl;
+		return false;
+	}
+
+private:
+	static const unsigned int no_scope = ~0u;
+
+	struct Scope
+	{
+		std::string name;
+		unsigned int parent;
+		unsigned int depth;
+		std::vector<unsigned int> children;
+		std::vector<float> samples;		// a ring of the last window of them
+		unsigned int next = 0;
+		float last_ms = 0.0f;
+		unsigned int last_frame = 0;	// read with a sample of it
+	};
+
+	// a scope's queries in one frame
+	struct Record
+	{
+		unsigned int scope;
+		unsigned int begin_query;
+		unsigned int end_query;
+	};
+
+	struct Frame
+	{
+		std::vector<unsigned int> queries;
+		unsigned int used = 0;
+		std::vector<Record> records;
+		bool pending = false;
+	};
+
+	Frame m_frames[frames_in_flight];
+	unsigned int m_frame = 0;
+	bool m_in_frame = false;
+	std::vector<unsigned int> m_stack;	// of the scopes begun and not ended
+	std::vector<unsigned int> m_open;	// their records in the frame
+
+	std::vector<Scope> m_scopes;
+	std::vector<GpuProfileStats> m_stats;
+	unsigned int m_frames_read = 0;
+	unsigned int m_dropped = 0;
+
+	unsigned int findScope(unsigned int parent, const char* name)
+	{
+		if (parent != no_scope)
+		{
+			for (unsigned int child : m_scopes[parent].children)
+			{
+				if (m_scopes[child].name == name)
+					return child;
+			}
+		}
+		else
+		{
+			for (unsigned int i = 0; i < m_scopes.size(); ++i)
+			{
+				if (m_scopes[i].parent == no_scope && m_scopes[i].name == name)
+					return i;
+			}
+		}
+
+		Scope scope;
+		scope.name = name;
+		scope.parent = parent;
+		scope.depth = parent == no_scope ? 0 : m_scopes[parent].depth + 1;
+		m_scopes.push_back(scope);
+		if (parent != no_scope)
+			m_scopes[parent].children.push_back(m_scopes.size() - 1);
+		return m_scopes.size() - 1;
+	}
+
+	// a timestamp of now from the frame's queries, which grow to the most it has needed
+	unsigned int query(Frame& frame)
+	{
+		if (frame.used == frame.queries.size())
+		{
+			frame.queries.push_back(0);
+			glGenQueries(1, &frame.queries.back());
+		}
+		unsigned int q = frame.queries[frame.used++];
+		glQueryCounter(q, GL_TIMESTAMP);
+		return q;
+	}
+
+	void readResults()
+	{
+		bool read = false;
+		// oldest first, so the last times are the newest
+		for (unsigned int j = 1; j <= frames_in_flight; ++j)
+		{
+			Frame& frame = m_frames[(m_frame + j) % frames_in_flight];
+			if (!frame.pending || frame.used == 0)
+				continue;
+
+			// the queries finish in order, the last one being done means they all are
+			int available = 0;
+			glGetQueryObjectiv(frame.queries[frame.used - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+			if (!available)
+				continue;
+
+			for (const Record& record : frame.records)
+			{
+				GLuint64 begin_time = 0;
+				GLuint64 end_time = 0;
+				glGetQueryObjectui64v(record.begin_query, GL_QUERY_RESULT, &begin_time);
+				glGetQueryObjectui64v(record.end_query, GL_QUERY_RESULT, &end_time);
+				Scope& scope = m_scopes[record.scope];
+				addSample(scope, (float)((end_time - begin_time) / 1.0e6));
+				scope.last_frame = m_frames_read;
+			}
+			frame.pending = false;
+			++m_frames_read;
+			read = true;
+		}
+		if (read)
+			updateStats();
+	}
+
+	static void addSample(Scope& scope, float ms)
+	{
+		if (scope.samples.size() < window)
+			scope.samples.push_back(ms);
+		else
+			scope.samples[scope.next] = ms;
+		scope.next = (scope.next + 1) % window;
+		scope.last_ms = ms;
+	}
+
+	void updateStats()
+	{
+		m_stats.clear();
+		for (unsigned int i = 0; i < m_scopes.size(); ++i)
+		{
+			if (m_scopes[i].parent == no_scope)
+				addStats(i);
+		}
+	}
+
+	void addStats(unsigned int index)
+	{
+		const Scope& scope = m_scopes[index];
+		if (scope.last_frame + 1 != m_frames_read)
+			return;
+		m_stats.push_back(statsOf(scope));
+		for (unsigned int child : scope.children)
+			addStats(child);
+	}
+
+	static GpuProfileStats statsOf(const Scope& scope)
+	{
+		GpuProfileStats stats;
+		stats.name = scope.name;
+		stats.depth = scope.depth;
+		stats.last_ms = scope.last_ms;
+		stats.samples = scope.samples.size();
+		if (scope.samples.empty())
+			return stats;
+
+		std::vector<float> sorted = scope.samples;
+		std::sort(sorted.begin(), sorted.end());
+		float sum = 0.0f;
+		for (float ms : sorted)
+			sum += ms;
+		stats.min_ms = sorted.front();
+		stats.avg_ms = sum / sorted.size();
+		stats.p99_ms = sorted[(sorted.size() * 99 + 99) / 100 - 1];
+		return stats;
+	}
+
+	void writeJson(std::ostringstream& out, unsigned int index, unsigned int indent)
+	{
+		const Scope& scope = m_scopes[index];
+		GpuProfileStats stats = statsOf(scope);
+		std::string tabs(indent, '\t');
+		out << tabs << "{ \"name\": \"" << escape(stats.name) << "\", \"last_ms\": " << stats.last_ms << ", \"min_ms\": " << stats.min_ms << ", \"avg_ms\": " << stats.avg_ms
+			<< ", \"p99_ms\": " << stats.p99_ms << ", \"samples\": " << stats.samples;
+		if (!scope.children.empty())
+		{
+			out << ", \"children\": [\n";
+			for (unsigned int i = 0; i < scope.children.size(); ++i)
+			{
+				writeJson(out, scope.children[i], indent + 1);
+				out << (i + 1 < scope.children.size() ? ",\n" : "\n");
+			}
+			out << tabs << "]";
+		}
+		out << " }";
+	}
+
+	static std::string escape(const std::string& text)
+	{
+		std::string escaped;
+		for (char c : text)
+		{
+			if (c == '"' || c == '\\')
+				escaped += '\\';
+			escaped += c;
+		}
+		return escaped;
+	}
+};
+
+// times the GL commands of the block it's declared in as a scope of the profiler, nothing without one
+class GpuScope
+{
+public:
+	GpuScope(GpuProfiler* profiler, const char* name) : m_profiler(profiler)
+	{
+		if (m_profiler)
+			m_profiler->begin(name);
+	}
+	~GpuScope()
+	{
+		if (m_profiler)
+			m_profiler->end();
+	}
+
+private:
+	GpuProfiler* m_profiler;
+};
\ No newline at end of file
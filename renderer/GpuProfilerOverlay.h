@@ -0,0 +1,137 @@
+#pragma once
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include "GLState.h"
+#include "GpuProfiler.h"
+#include "ShaderVariants.h"
+
+#include <cstddef>
+#include <cmath>
+#include <vector>
+#include <string>
+#include <algorithm>
+
+/**
+draws a GpuProfiler's stats over the bound framebuffer, a row for each scope, indented by how deep it is.
+a row's bar is its average time, the darker part of it the minimum and the white tick the 99th
+percentile, on a track that's the budget long. the colors follow the names, so a scope keeps its color
+when the rows above it change. there's no text, the names go with the colors in the profiler's json
+*/
+class GpuProfilerOverlay
+{
+public:
+	// the program of ProfilerOverlayVertex.shader and ProfilerOverlayFragment.shader
+	GpuProfilerOverlay(ShaderProgram* program, float budget_ms) : m_program(program), m_budget_ms(budget_ms)
+	{
+		glGenVertexArrays(1, &m_VAO);
+		glGenBuffers(1, &m_VBO);
+		gl_state.bindVertexArray(m_VAO);
+		glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
+		glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, color));
+		glEnableVertexAttribArray(1);
+		gl_state.bindVertexArray(0);
+	}
+	~GpuProfilerOverlay()
+	{
+		// so a new array with the same name isn't thought to be bound
+		gl_state.bindVertexArray(0);
+		glDeleteVertexArrays(1, &m_VAO);
+		glDeleteBuffers(1, &m_VBO);
+	}
+
+	// width and height of the viewport it's drawn in
+	void draw(GpuProfiler& profiler, unsigned int width, unsigned int height)
+	{
+		const std::vector<GpuProfileStats>& stats = profiler.stats();
+		if (stats.empty())
+			return;
+
+		m_vertices.clear();
+		float top = margin;
+		rect(margin - padding, top - padding, track_width + indent * maxDepth(stats) + 2.0f * padding, stats.size() * row_height + 2.0f * padding, glm::vec4(0.0f, 0.0f, 0.0f, 0.6f));
+		for (const GpuProfileStats& scope : stats)
+		{
+			float left = margin + indent * scope.depth;
+			glm::vec3 color = nameColor(scope.name);
+			rect(left, top, track_width, bar_height, glm::vec4(1.0f, 1.0f, 1.0f, 0.15f));
+			rect(left, top, length(scope.avg_ms), bar_height, glm::vec4(color, 1.0f));
+			rect(left, top, length(scope.min_ms), bar_height, glm::vec4(color * 0.5f, 1.0f));
+			rect(left + length(scope.p99_ms) - 1.0f, top, 2.0f, bar_height, glm::vec4(1.0f));
+			top += row_height;
+		}
+
+		glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
+		glBufferData(GL_ARRAY_BUFFER, m_vertices.size() * sizeof(Vertex), m_vertices.data(), GL_STREAM_DRAW);
+
+		m_program->use();
+		m_program->setVec2("screen_size", glm::vec2(width, height));
+		gl_state.disable(GL_DEPTH_TEST);
+		gl_state.enable(GL_BLEND);
+		gl_state.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		gl_state.bindVertexArray(m_VAO);
+		glDrawArrays(GL_TRIANGLES, 0, m_vertices.size());
+		gl_state.enable(GL_DEPTH_TEST);
+	}
+
+	void setBudget(float budget_ms)
+	{
+		m_budget_ms = budget_ms;
+	}
+
+private:
+	// in pixels
+	static constexpr float margin = 16.0f;
+	static constexpr float padding = 6.0f;
+	static constexpr float track_width = 320.0f;
+	static constexpr float indent = 12.0f;
+	static constexpr float bar_height = 10.0f;
+	static constexpr float row_height = 14.0f;
+
+	struct Vertex
+	{
+		glm::vec2 position;	// in pixels from the top left
+		glm::vec4 color;
+	};
+
+	ShaderProgram* m_program;
+	float m_budget_ms;
+	unsigned int m_VAO;
+	unsigned int m_VBO;
+	std::vector<Vertex> m_vertices;
+
+	float length(float ms)
+	{
+		return std::min(ms / m_budget_ms, 1.0f) * track_width;
+	}
+
+	void rect(float x, float y, float w, float h, const glm::vec4& color)
+	{
+		Vertex corners[4] = { { { x, y }, color }, { { x + w, y }, color }, { { x + w, y + h }, color }, { { x, y + h }, color } };
+		// counterclockwise once y is flipped
+		unsigned int order[6] = { 0, 2, 1, 0, 3, 2 };
+		for (unsigned int i : order)
+			m_vertices.push_back(corners[i]);
+	}
+
+	static unsigned int maxDepth(const std::vector<GpuProfileStats>& stats)
+	{
+		unsigned int depth = 0;
+		for (const GpuProfileStats& scope : stats)
+			depth = std::max(depth, scope.depth);
+		return depth;
+	}
+
+	// a bright color from a hash of the name
+	static glm::vec3 nameColor(const std::string& name)
+	{
+		unsigned int hash = 2166136261u;
+		for (char c : name)
+			hash = (hash ^ (unsigned char)c) * 16777619u;
+		float hue = (hash % 360) / 360.0f * 6.2831853f;
+		return glm::vec3(0.6f + 0.4f * std::cos(hue), 0.6f + 0.4f * std::cos(hue - 2.0943951f), 0.6f + 0.4f * std::cos(hue + 2.0943951f));
+	}
+};
\ No newline at end of file
@@ -0,0 +1,45 @@
+#pragma once
+#include <glad/glad.h>
+
+#include "QueryRing.h"
+
+/**
+times a range of GL commands on the GPU with a pair of timestamps, so timers can be nested.
+results are read a few frames late, once they're available, so the CPU never waits on the GPU
+*/
+class GpuTimer
+{
+public:
+	void begin()
+	{
+		if (m_queries.readResults())
+		{
+			m_ms = (float)((m_queries.result(1) - m_queries.result(0)) / 1.0e6);
+			++m_samples;
+		}
+		glQueryCounter(m_queries.query(0), GL_TIMESTAMP);
+	}
+	void end()
+	{
+		glQueryCounter(m_queries.query(1), GL_TIMESTAMP);
+		m_queries.endFrame();
+	}
+
+	// milliseconds of the last measured range
+	float ms()
+	{
+		return m_ms;
+	}
+
+	// number of times a newer measurement was read so far
+	unsigned int samples()
+	{
+		return m_samples;
+	}
+
+private:
+	QueryRing m_queries{ 2 };
+
+	float m_ms = 0.0f;
+	unsigned int m_samples = 0;
+};
\ No newline at end of file
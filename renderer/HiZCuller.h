@@ -0,0 +1,315 @@
+#pragma once
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "GLExtensions.h"
+#include "ComputeShader.h"
+#include "GLState.h"
+#include "InstanceCuller.h"
+#include "Bounds.h"
+
+#include <vector>
+
+/**
+two pass hierarchical-z occlusion culling.
+the early pass tests every object against the depth pyramid built during the previous
+frame and writes a one instance indirect command for each survivor. after those are drawn
+the pyramid is rebuilt from the current depth and the late pass re-tests only the rejected
+objects against it, so anything that became disoccluded this frame is drawn in the same frame.
+the pyramid built here is also what the next frame's early pass tests against.
+*/
+class HiZCuller
+{
+public:
+	HiZCuller(int width, int height)
+	{
+		m_reduce_shader = new ComputeShader("shaders/HiZReduceCompute.shader");
+		m_cull_shader = new ComputeShader("shaders/OcclusionCullCompute.shader");
+
+		// both read their depth on unit 7
+		m_reduce_shader->use();
+		m_reduce_shader->setInt("depth_texture", 7);
+		m_cull_shader->use();
+		m_cull_shader->setInt("hiz", 7);
+
+		glGenBuffers(1, &m_bounds_buffer);
+		glGenBuffers(1, &m_visibility_buffer);
+		glGenBuffers(1, &m_command_buffer);
+
+		glGenFramebuffers(1, &m_depth_fbo);
+		glGenTextures(1, &m_depth_texture);
+		glGenTextures(1, &m_pyramid);
+
+		resize(width, height);
+	}
+	~HiZCuller()
+	{
+		glDeleteBuffers(1, &m_bounds_buffer);
+		glDeleteBuffers(1, &m_visibility_buffer);
+		glDeleteBuffers(1, &m_command_buffer);
+
+		glDeleteFramebuffers(1, &m_depth_fbo);
+		glDeleteTextures(1, &m_depth_texture);
+		glDeleteTextures(1, &m_pyramid);
+		gl_state.forgetTexture(m_depth_texture);
+		gl_state.forgetTexture(m_pyramid);
+
+		delete(m_reduce_shader);
+		delete(m_cull_shader);
+	}
+
+	/**
+	registers an object drawn with num_elements indices and returns its index.
+	its indirect command lives at commandOffset(index) in the command buffer
+	*/
+	unsigned int addObject(unsigned int num_elements)
+	{
+		DrawElementsIndirectCommand command;
+		command.count = num_elements;
+		command.instance_count = 1;
+		command.first_index = 0;
+		command.base_vertex = 0;
+		command.base_instance = 0;
+		m_commands.push_back(command);
+
+		m_bounds.push_back(AABB{ glm::vec3(0.0f), glm::vec3(0.0f) });
+		m_buffers_dirty = true;
+
+		return m_commands.size() - 1;
+	}
+	void setBounds(unsigned int index, const AABB& world_bounds)
+	{
+		m_bounds[index] = world_bounds;
+	}
+	unsigned int numObjects()
+	{
+		return m_commands.size();
+	}
+	unsigned int commandOffset(unsigned int index)
+	{
+		return index * sizeof(DrawElementsIndirectCommand);
+	}
+	void bindCommands()
+	{
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_command_buffer);
+	}
+
+	void resize(int width, int height)
+	{
+		m_width = width;
+		m_height = height;
+		m_viewport_width = width;
+		m_viewport_height = height;
+
+		gl_state.bindTexture(7, GL_TEXTURE_2D, m_depth_texture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, width, height, 0, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+		gl_state.bindFramebuffer(GL_FRAMEBUFFER, m_depth_fbo);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, m_depth_texture, 0);
+		glDrawBuffer(GL_NONE);
+		glReadBuffer(GL_NONE);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		{
+			std::cout << "ERROR::FRAMEBUFFER:: Hi-Z depth framebuffer is not complete!" << std::endl;
+		}
+		gl_state.bindFramebuffer(GL_FRAMEBUFFER, 0);
+
+		// the pyramid base is the power of two at or below the screen size so every level halves exactly
+		m_pyramid_width = 1;
+		while (m_pyramid_width * 2 <= width)
+			m_pyramid_width *= 2;
+		m_pyramid_height = 1;
+		while (m_pyramid_height * 2 <= height)
+			m_pyramid_height *= 2;
+
+		m_levels = 1;
+		while ((m_pyramid_width >> m_levels) > 0 || (m_pyramid_height >> m_levels) > 0)
+			++m_levels;
+
+		gl_state.bindTexture(7, GL_TEXTURE_2D, m_pyramid);
+		for (int i = 0; i < m_levels; ++i)
+		{
+			glTexImage2D(GL_TEXTURE_2D, i, GL_R32F, levelWidth(i), levelHeight(i), 0, GL_RED, GL_FLOAT, NULL);
+		}
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, m_levels - 1);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		gl_state.bindTexture(7, GL_TEXTURE_2D, 0);
+
+		// the old pyramid no longer matches the screen
+		m_has_pyramid = false;
+	}
+
+	/**
+	the part of the depth the frame is drawn into, from its origin. the pyramid is built from it alone,
+	so it covers the view the same way whatever its size
+	*/
+	void setViewport(int width, int height)
+	{
+		m_viewport_width = width;
+		m_viewport_height = height;
+	}
+
+	/**
+	tests every object against last frame's pyramid. frustum culling uses the current
+	view_proj, while the occlusion test projects with the matrix the pyramid was built with
+	*/
+	void testEarly(const glm::mat4& view_proj)
+	{
+		uploadBounds();
+		runTest(view_proj, m_pyramid_view_proj, false, m_has_pyramid);
+	}
+
+	/**
+	resolves the depth of source_fbo and rebuilds the pyramid from it.
+	leaves source_fbo bound as the framebuffer
+	*/
+	void buildPyramid(unsigned int source_fbo, const glm::mat4& view_proj)
+	{
+		gl_state.bindFramebuffer(GL_READ_FRAMEBUFFER, source_fbo);
+		gl_state.bindFramebuffer(GL_DRAW_FRAMEBUFFER, m_depth_fbo);
+		glBlitFramebuffer(0, 0, m_viewport_width, m_viewport_height, 0, 0, m_viewport_width, m_viewport_height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+
+		m_reduce_shader->use();
+		gl_state.bindTexture(7, GL_TEXTURE_2D, m_depth_texture);
+
+		for (int i = 0; i < m_levels; ++i)
+		{
+			bool from_depth = i == 0;
+			glm::ivec2 src_size = from_depth ? glm::ivec2(m_viewport_width, m_viewport_height) : glm::ivec2(levelWidth(i - 1), levelHeight(i - 1));
+			glm::ivec2 dst_size = glm::ivec2(levelWidth(i), levelHeight(i));
+
+			m_reduce_shader->setBool("from_depth", from_depth);
+			glUniform2i(m_reduce_shader->uniformLoc("src_size"), src_size.x, src_size.y);
+			glUniform2i(m_reduce_shader->uniformLoc("dst_size"), dst_size.x, dst_size.y);
+
+			if (!from_depth)
+				glBindImageTexture(0, m_pyramid, i - 1, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+			glBindImageTexture(1, m_pyramid, i, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+
+			m_reduce_shader->dispatch(dst_size.x, dst_size.y, 1, 8, 8);
+
+			glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+		}
+
+		m_pyramid_view_proj = view_proj;
+		m_has_pyramid = true;
+
+		gl_state.bindFramebuffer(GL_FRAMEBUFFER, source_fbo);
+	}
+
+	/**
+	re-tests the objects the early pass rejected against the pyramid of this frame.
+	objects drawn by the early pass get a zero instance command so they are not drawn twice
+	*/
+	void testLate(const glm::mat4& view_proj)
+	{
+		runTest(view_proj, view_proj, true, m_has_pyramid);
+	}
+
+	void invalidate()
+	{
+		m_has_pyramid = false;
+	}
+
+private:
+	ComputeShader* m_reduce_shader;
+	ComputeShader* m_cull_shader;
+
+	unsigned int m_bounds_buffer;
+	unsigned int m_visibility_buffer;
+	unsigned int m_command_buffer;
+
+	std::vector<DrawElementsIndirectCommand> m_commands;
+	std::vector<AABB> m_bounds;
+	std::vector<glm::vec4> m_bounds_upload;
+	bool m_buffers_dirty = true;
+
+	unsigned int m_depth_fbo;
+	unsigned int m_depth_texture;
+	unsigned int m_pyramid;
+
+	int m_width;
+	int m_height;
+	int m_viewport_width;
+	int m_viewport_height;
+	int m_pyramid_width;
+	int m_pyramid_height;
+	int m_levels;
+
+	bool m_has_pyramid = false;
+	glm::mat4 m_pyramid_view_proj = glm::mat4(1.0f);
+
+	int levelWidth(int level)
+	{
+		return MAX(m_pyramid_width >> level, 1);
+	}
+	int levelHeight(int level)
+	{
+		return MAX(m_pyramid_height >> level, 1);
+	}
+
+	void uploadBounds()
+	{
+		if (m_buffers_dirty)
+		{
+			// every object starts out visible so the first frame draws everything in the early pass
+			std::vector<unsigned int> visibility(m_commands.size(), 1);
+
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_visibility_buffer);
+			glBufferData(GL_SHADER_STORAGE_BUFFER, visibility.size() * sizeof(unsigned int), visibility.data(), GL_DYNAMIC_COPY);
+
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_command_buffer);
+			glBufferData(GL_SHADER_STORAGE_BUFFER, m_commands.size() * sizeof(DrawElementsIndirectCommand), m_commands.data(), GL_DYNAMIC_COPY);
+
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_bounds_buffer);
+			glBufferData(GL_SHADER_STORAGE_BUFFER, m_bounds.size() * 2 * sizeof(glm::vec4), NULL, GL_DYNAMIC_DRAW);
+
+			m_buffers_dirty = false;
+		}
+
+		m_bounds_upload.resize(m_bounds.size() * 2);
+		for (unsigned int i = 0; i < m_bounds.size(); ++i)
+		{
+			m_bounds_upload[i * 2 + 0] = glm::vec4(m_bounds[i].min, 1.0f);
+			m_bounds_upload[i * 2 + 1] = glm::vec4(m_bounds[i].max, 1.0f);
+		}
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_bounds_buffer);
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, m_bounds_upload.size() * sizeof(glm::vec4), m_bounds_upload.data());
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	}
+
+	void runTest(const glm::mat4& frustum_view_proj, const glm::mat4& occlusion_view_proj, bool late_pass, bool use_pyramid)
+	{
+		if (m_commands.empty())
+			return;
+
+		Frustum frustum(frustum_view_proj);
+
+		m_cull_shader->use();
+		m_cull_shader->setUInt("num_objects", m_commands.size());
+		m_cull_shader->setBool("late_pass", late_pass);
+		m_cull_shader->setBool("use_pyramid", use_pyramid);
+		glUniform4fv(m_cull_shader->uniformLoc("frustum_planes"), 6, glm::value_ptr(frustum.planes[0]));
+		m_cull_shader->setMat4("view_proj", occlusion_view_proj);
+		m_cull_shader->setVec2("hiz_size", glm::vec2(m_pyramid_width, m_pyramid_height));
+		m_cull_shader->setInt("hiz_levels", m_levels);
+
+		gl_state.bindTexture(7, GL_TEXTURE_2D, m_pyramid);
+
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_bounds_buffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_visibility_buffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, m_command_buffer);
+
+		m_cull_shader->dispatch(m_commands.size(), 1, 1, 64);
+
+		glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+	}
+};
\ No newline at end of file
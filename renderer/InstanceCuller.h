@@ -0,0 +1,172 @@
+#pragma once
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <gl_util/Shader.h>
+
+#include "GLExtensions.h"
+#include "ComputeShader.h"
+#include "GLState.h"
+#include "Bounds.h"
+#include "Model.h"
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+// matches the layout glDrawElementsIndirect reads from GL_DRAW_INDIRECT_BUFFER
+struct DrawElementsIndirectCommand
+{
+	unsigned int count;
+	unsigned int instance_count;
+	unsigned int first_index;
+	unsigned int base_vertex;
+	unsigned int base_instance;
+};
+
+/**
+frustum and distance culls the instances of a model on the GPU.
+surviving transforms are compacted into the buffer the model's instance attributes
+read from, and the instance counts of one indirect command per mesh are written by
+the compute pass, so the draw never needs the result on the CPU.
+*/
+class InstanceCuller
+{
+public:
+	Model* model;
+	unsigned int num_instances;
+
+	// instances further than this from the camera are culled
+	float max_distance = 5000.0f;
+
+	InstanceCuller(Model* model, const glm::mat4* transforms, unsigned int num_instances)
+		: model(model), num_instances(num_instances)
+	{
+		glm::vec3 extents = model->bounds.extents();
+		m_bounds_center = model->bounds.center();
+		// the vertex shaders sway the vertices along x by up to (1.5 - 0.5 * z) * 0.1, most at one of the z
+		// extremes, this has to stay in sync with animate() in VelocityVertex.shader and the same lines of Vertex.shader
+		float sway = std::max(std::abs(1.5f - 0.5f * model->bounds.min.z), std::abs(1.5f - 0.5f * model->bounds.max.z)) * 0.1f;
+		m_bounds_radius = glm::length(extents) + sway;
+
+		m_reset_commands.reserve(model->meshes.size());
+		for (unsigned int i = 0; i < model->meshes.size(); ++i)
+		{
+			DrawElementsIndirectCommand command;
+			command.count = model->meshes[i].indices.size();
+			command.instance_count = gl_caps.compute ? 0 : num_instances;
+			command.first_index = 0;
+			command.base_vertex = 0;
+			command.base_instance = 0;
+			m_reset_commands.push_back(command);
+		}
+
+		glGenBuffers(1, &m_instance_buffer);
+		glGenBuffers(1, &m_visible_buffer);
+		glGenBuffers(1, &m_command_buffer);
+
+		glBindBuffer(GL_ARRAY_BUFFER, m_instance_buffer);
+		glBufferData(GL_ARRAY_BUFFER, num_instances * sizeof(glm::mat4), transforms, GL_STATIC_DRAW);
+
+		// without compute shaders every instance is drawn straight from the source buffer
+		glBindBuffer(GL_ARRAY_BUFFER, m_visible_buffer);
+		if (gl_caps.compute)
+			glBufferData(GL_ARRAY_BUFFER, num_instances * sizeof(glm::mat4), NULL, GL_DYNAMIC_COPY);
+		else
+			glBufferData(GL_ARRAY_BUFFER, num_instances * sizeof(glm::mat4), transforms, GL_STATIC_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_command_buffer);
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, m_reset_commands.size() * sizeof(DrawElementsIndirectCommand), m_reset_commands.data(), GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+		setupInstanceAttributes();
+
+		if (gl_caps.compute)
+			m_cull_shader = new ComputeShader("shaders/InstanceCullCompute.shader");
+	}
+	~InstanceCuller()
+	{
+		glDeleteBuffers(1, &m_instance_buffer);
+		glDeleteBuffers(1, &m_visible_buffer);
+		glDeleteBuffers(1, &m_command_buffer);
+
+		delete(m_cull_shader);
+	}
+
+	/**
+	runs the culling pass. the draw commands are reset with a buffer upload, never read back
+	*/
+	void cull(const glm::mat4& view_proj, const glm::vec3& view_pos)
+	{
+		if (!gl_caps.compute)
+			return;
+
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_command_buffer);
+		glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, m_reset_commands.size() * sizeof(DrawElementsIndirectCommand), m_reset_commands.data());
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+		Frustum frustum(view_proj);
+
+		m_cull_shader->use();
+		m_cull_shader->setUInt("num_instances", num_instances);
+		m_cull_shader->setUInt("num_commands", m_reset_commands.size());
+		m_cull_shader->setVec3("bounds_center", m_bounds_center);
+		m_cull_shader->setFloat("bounds_radius", m_bounds_radius);
+		glUniform4fv(m_cull_shader->uniformLoc("frustum_planes"), 6, glm::value_ptr(frustum.planes[0]));
+		m_cull_shader->setVec3("view_pos", view_pos);
+		m_cull_shader->setFloat("max_distance", max_distance);
+
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_instance_buffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_visible_buffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, m_command_buffer);
+
+		m_cull_shader->dispatch(num_instances, 1, 1, 64);
+
+		// the indirect draw reads the counts and the instance attributes read the compacted transforms
+		glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+	}
+
+	void draw()
+	{
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_command_buffer);
+		for (unsigned int i = 0; i < model->meshes.size(); ++i)
+		{
+			model->meshes[i].DrawIndirect(i * sizeof(DrawElementsIndirectCommand));
+		}
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	}
+
+private:
+	ComputeShader* m_cull_shader = nullptr;
+
+	unsigned int m_instance_buffer;
+	unsigned int m_visible_buffer;
+	unsigned int m_command_buffer;
+
+	std::vector<DrawElementsIndirectCommand> m_reset_commands;
+
+	glm::vec3 m_bounds_center;
+	float m_bounds_radius;
+
+	void setupInstanceAttributes()
+	{
+		// instance matrices take up attribute locations 3 to 6
+		glBindBuffer(GL_ARRAY_BUFFER, m_visible_buffer);
+		for (unsigned int i = 0; i < model->meshes.size(); ++i)
+		{
+			gl_state.bindVertexArray(model->meshes[i].VAO);
+			std::size_t vec4size = sizeof(glm::vec4);
+			for (unsigned int j = 0; j < 4; ++j)
+			{
+				glEnableVertexAttribArray(3 + j);
+				glVertexAttribPointer(3 + j, 4, GL_FLOAT, GL_FALSE, 4 * vec4size, (void*)(j * vec4size));
+				glVertexAttribDivisor(3 + j, 1);
+			}
+		}
+		gl_state.bindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+};
\ No newline at end of file
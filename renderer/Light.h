@@ -8,6 +8,28 @@
 
 #include <string>
 
+// layouts of the lights in the Lights uniform block of Fragment.shader (std140)
+struct DirLightData
+{
+	glm::vec4 direction;
+
+	glm::vec4 ambient;
+	glm::vec4 diffuse;
+	glm::vec4 specular;
+
+	int shadow_view;		// 0 when the light has cascaded shadows, -1 without
+	int padding[3];
+};
+// point and spot lights in the light list of the clustered shading, 5 RGBA32F texels each
+struct ClusterLightData
+{
+	glm::vec4 position_radius;
+	glm::vec4 color_ambient;		// color, ambient strength
+	glm::vec4 attenuation_type;		// constant, linear, quadratic, 0 for point and 1 for spot lights
+	glm::vec4 direction_shadow;		// spot direction, first shadow atlas view or -1
+	glm::vec4 cutoff;				// spot inner and outer cutoff
+};
+
 enum LightType
 {
 	DIRECTIONAL_LIGHT,
@@ -25,53 +47,84 @@ struct Light
 
 	float ambient_strength;
 
-	unsigned int shadow_fbo;
-	unsigned int shadow_map;
-
 	const bool casts_shadow;
 
+	// first of the light's views in the shadow atlas, or 0 for a directional light with cascades. -1 until it has a shadow
+	int shadow_view = -1;
+
+	// set when the copy in the light buffer is out of date, change lights through the setters so it's kept
+	bool dirty = true;
+
 	Light(glm::vec3 color, glm::vec3 position, glm::vec3 direction, float ambient_strength, bool casts_shadow) : color(color), position(position), direction(direction), ambient_strength(ambient_strength), casts_shadow(casts_shadow) {};
+	virtual ~Light() {}
 
 	void setColor(float r, float g, float b)
 	{
 		color.x = r;
 		color.y = g;
 		color.z = b;
+		updateRadius();
+		dirty = true;
+	}
+	void setPosition(const glm::vec3& new_position)
+	{
+		position = new_position;
+		dirty = true;
+	}
+	void setDirection(const glm::vec3& new_direction)
+	{
+		direction = new_direction;
+		dirty = true;
+	}
+	void setAmbientStrength(float strength)
+	{
+		ambient_strength = strength;
+		updateRadius();
+		dirty = true;
+	}
+
+protected:
+	// the range of the lights that have one follows their brightness
+	virtual void updateRadius()
+	{
+	}
+
+	glm::vec4 ambient()
+	{
+		return glm::vec4(color * ambient_strength, 0.0f);
 	}
-	void uniformShader(Shader* shader, const std::string& uniform_name);
 
-	// gets the unifrom locations needed for this light from the shader
-	void setUniformLocations(Shader* shader);
+	/**
+	distance at which the attenuated light falls below 1/256 of its brightest channel.
+	the shader fades the light out to exactly 0 there so it can be culled at that range
+	*/
+	float attenuationRadius(float constant, float linear, float quadratic)
+	{
+		float brightest = glm::max(color.x, glm::max(color.y, color.z)) * glm::max(1.0f, ambient_strength);
+		float c = constant - 256.0f * brightest;
+		if (c >= 0.0f)
+			return 0.0f;
+		if (quadratic <= 0.0f)
+			return linear > 0.0f ? -c / linear : 1e30f;
+		return (-linear + glm::sqrt(linear * linear - 4.0f * quadratic * c)) / (2.0f * quadratic);
+	}
 };
 struct DirLight : public Light
 {
-	const static unsigned int shadow_width = 2048;
-	const static unsigned int shadow_height = 2048;
-
 	DirLight(glm::vec3 color, glm::vec3 position, glm::vec3 direction, float ambient_strength, bool casts_shadow)
 		: Light(color, position, direction, ambient_strength, casts_shadow)
 	{
 		type = DIRECTIONAL_LIGHT;
-
-		if (casts_shadow)
-		{
-			shadow_fbo = createDirectionalDepthMapBuffer(&shadow_map, shadow_width, shadow_height);
-		}
-	}
-	~DirLight()
-	{
-		if(casts_shadow)
-			glDeleteFramebuffers(1, &shadow_fbo);
 	}
-	void uniformShader(Shader* shader, const std::string& uniform_name)
+	void writeData(DirLightData& data)
 	{
-		shader->setVec3(uniform_name + ".direction", direction);
+		data.direction = glm::vec4(direction, 0.0f);
 
-		shader->setVec3(uniform_name + ".ambient", color.x * ambient_strength, color.y * ambient_strength, color.z * ambient_strength);
-		shader->setVec3(uniform_name + ".diffuse", color.x, color.y, color.z);
-		shader->setVec3(uniform_name + ".specular", color.x, color.y, color.z);
+		data.ambient = ambient();
+		data.diffuse = glm::vec4(color, 0.0f);
+		data.specular = glm::vec4(color, 0.0f);
 
-		shader->setBool(uniform_name + ".casts_shadow", casts_shadow);
+		data.shadow_view = shadow_view;
 	}
 };
 struct PointLight : public Light
@@ -80,36 +133,47 @@ struct PointLight : public Light
 	float linear;
 	float quadratic;
 
+	// lights are culled beyond this distance
+	float radius;
+
 	PointLight(glm::vec3 color, glm::vec3 position, float ambient_strength, bool casts_shadow)
 		: Light(color, position, glm::vec3(0.0f, 0.0f, 0.0f), ambient_strength, casts_shadow), constant(1.0f), linear(0.09f), quadratic(0.032f)
 	{
 		type = POINT_LIGHT;
-
-		if (casts_shadow)
-		{
-			shadow_fbo = createOmnidirectionalDepthMapBuffer(&shadow_map, 1024);
-		}
+		updateRadius();
 	}
-	~PointLight()
+	void setAttenuation(float new_constant, float new_linear, float new_quadratic)
 	{
-		if (casts_shadow)
-		{
-			glDeleteFramebuffers(1, &shadow_fbo);
-		}
+		constant = new_constant;
+		linear = new_linear;
+		quadratic = new_quadratic;
+		updateRadius();
+		dirty = true;
 	}
-	void uniformShader(Shader* shader, const std::string& uniform_name)
+	// cuts the light off closer than its attenuation would, it's kept when the light's brightness changes
+	void setRadius(float new_radius)
 	{
-		shader->setVec3(uniform_name + ".position", position);
+		m_set_radius = new_radius;
+		updateRadius();
+		dirty = true;
+	}
 
-		shader->setVec3(uniform_name + ".ambient", color.x * ambient_strength, color.y * ambient_strength, color.z * ambient_strength);
-		shader->setVec3(uniform_name + ".diffuse", color.x, color.y, color.z);
-		shader->setVec3(uniform_name + ".specular", color.x, color.y, color.z);
+	void writeData(ClusterLightData& data)
+	{
+		data.position_radius = glm::vec4(position, radius);
+		data.color_ambient = glm::vec4(color, ambient_strength);
+		data.attenuation_type = glm::vec4(constant, linear, quadratic, 0.0f);
+		data.direction_shadow = glm::vec4(0.0f, 0.0f, 0.0f, (float)shadow_view);
+		data.cutoff = glm::vec4(0.0f);
+	}
 
-		shader->setFloat(uniform_name + ".constant", constant);
-		shader->setFloat(uniform_name + ".linear", linear);
-		shader->setFloat(uniform_name + ".quadratic", quadratic);
+protected:
+	// of setRadius, 0 while the radius follows the attenuation
+	float m_set_radius = 0.0f;
 
-		shader->setBool(uniform_name + ".casts_shadow", casts_shadow);
+	void updateRadius() override
+	{
+		radius = m_set_radius > 0.0f ? m_set_radius : attenuationRadius(constant, linear, quadratic);
 	}
 };
 struct SpotLight : Light
@@ -121,27 +185,53 @@ struct SpotLight : Light
 	float linear;
 	float quadratic;
 
+	float radius;
+
 	SpotLight(glm::vec3 color, glm::vec3 position, glm::vec3 direction, float ambient_strength, bool casts_shadow)
 		: Light(color, position, direction, ambient_strength, casts_shadow), inner_cutoff(glm::cos(glm::radians(12.5f))), outer_cutoff(glm::cos(glm::radians(17.5f))),
 		constant(1.0f), linear(0.09f), quadratic(0.032f)
 	{
 		type = SPOT_LIGHT;
+		updateRadius();
 	}
 
-	void uniformShader(Shader* shader, const std::string& uniform_name)
+	void setCutoff(float inner, float outer)
+	{
+		inner_cutoff = inner;
+		outer_cutoff = outer;
+		dirty = true;
+	}
+	void setAttenuation(float new_constant, float new_linear, float new_quadratic)
+	{
+		constant = new_constant;
+		linear = new_linear;
+		quadratic = new_quadratic;
+		updateRadius();
+		dirty = true;
+	}
+	// cuts the light off closer than its attenuation would, it's kept when the light's brightness changes
+	void setRadius(float new_radius)
 	{
-		shader->setVec3(uniform_name + ".position", position);
-		shader->setVec3(uniform_name + ".direction", direction);
+		m_set_radius = new_radius;
+		updateRadius();
+		dirty = true;
+	}
 
-		shader->setFloat(uniform_name + ".innercutoff", inner_cutoff);
-		shader->setFloat(uniform_name + ".outercutoff", outer_cutoff);
+	void writeData(ClusterLightData& data)
+	{
+		data.position_radius = glm::vec4(position, radius);
+		data.color_ambient = glm::vec4(color, ambient_strength);
+		data.attenuation_type = glm::vec4(constant, linear, quadratic, 1.0f);
+		data.direction_shadow = glm::vec4(glm::normalize(direction), (float)shadow_view);
+		data.cutoff = glm::vec4(inner_cutoff, outer_cutoff, 0.0f, 0.0f);
+	}
 
-		shader->setVec3(uniform_name + ".ambient", color.x * ambient_strength, color.y * ambient_strength, color.z * ambient_strength);
-		shader->setVec3(uniform_name + ".diffuse", color.x, color.y, color.z);
-		shader->setVec3(uniform_name + ".specular", color.x, color.y, color.z);
+protected:
+	// of setRadius, 0 while the radius follows the attenuation
+	float m_set_radius = 0.0f;
 
-		shader->setFloat(uniform_name + ".constant", constant);
-		shader->setFloat(uniform_name + ".linear", linear);
-		shader->setFloat(uniform_name + ".quadratic", quadratic);
+	void updateRadius() override
+	{
+		radius = m_set_radius > 0.0f ? m_set_radius : attenuationRadius(constant, linear, quadratic);
 	}
 };
\ No newline at end of file
@@ -0,0 +1,84 @@
+#pragma once
+#include <glad/glad.h>
+
+#include "Light.h"
+
+#include <cstddef>
+
+// the Lights uniform block
+struct LightBufferData
+{
+	DirLightData dirlight;
+};
+
+/**
+the uniform buffer every lit program reads the directional light from. it's only written
+again when the light is marked dirty, so a static light costs nothing per frame.
+point and spot lights are in the clustered light list instead
+*/
+class LightBuffer
+{
+public:
+	static const unsigned int binding = 1;
+
+	// bytes uploaded by the last update
+	unsigned int uploaded_bytes = 0;
+
+	LightBuffer()
+	{
+		glGenBuffers(1, &m_ubo);
+		glBindBuffer(GL_UNIFORM_BUFFER, m_ubo);
+		glBufferData(GL_UNIFORM_BUFFER, sizeof(LightBufferData), NULL, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+		glBindBufferBase(GL_UNIFORM_BUFFER, binding, m_ubo);
+	}
+	~LightBuffer()
+	{
+		glDeleteBuffers(1, &m_ubo);
+	}
+
+	/**
+	points the program's Lights block at the buffer
+	*/
+	void bindToProgram(unsigned int program)
+	{
+		unsigned int index = glGetUniformBlockIndex(program, "Lights");
+		if (index != GL_INVALID_INDEX)
+			glUniformBlockBinding(program, index, binding);
+	}
+
+	void setDirLight(DirLight* light)
+	{
+		m_dirlight = light;
+		m_dirlight->dirty = true;
+	}
+
+	void update()
+	{
+		uploaded_bytes = 0;
+
+		if (m_dirlight && m_dirlight->dirty)
+		{
+			m_dirlight->writeData(m_data.dirlight);
+			upload(offsetof(LightBufferData, dirlight), sizeof(DirLightData), &m_data.dirlight);
+			m_dirlight->dirty = false;
+		}
+	}
+
+private:
+	unsigned int m_ubo;
+
+	LightBufferData m_data = {};
+
+	DirLight* m_dirlight = nullptr;
+
+	void upload(std::size_t offset, std::size_t size, const void* data)
+	{
+		glBindBuffer(GL_UNIFORM_BUFFER, m_ubo);
+		glBufferSubData(GL_UNIFORM_BUFFER, offset, size, data);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+		uploaded_bytes += size;
+	}
+};
\ No newline at end of file
@@ -8,6 +8,10 @@
 #include <gl_util/Shader.h>
 
 #include "Util.h"
+#include "GLExtensions.h"
+#include "GLState.h"
+#include "Bounds.h"
+#include "CpuProfiler.h"
 
 #include <iostream>
 #include <string>
@@ -21,12 +25,27 @@
 #define calculate_time(x) float t1 = get_millis(); x; float t2 = get_millis(); std::cout << "time: " << (t2 - t1) << "ms" << std::endl
 
 
+// also the texture unit the first texture of each type is bound to, see setMaterialSamplers
 enum TextureType {
 	DIFFUSE,
 	SPECULAR,
 	NORMAL,
 	EMISSION
 };
+
+/**
+points the material samplers of a program at their texture units.
+sampler uniforms are stored in the program, so this only needs to be called once per program
+*/
+template<typename ShaderType>
+void setMaterialSamplers(ShaderType& shader)
+{
+	gl_state.useProgram(shader.m_ID);
+	shader.setInt("material.diffuse1", DIFFUSE);
+	shader.setInt("material.specular1", SPECULAR);
+	shader.setInt("material.normal1", NORMAL);
+	shader.setInt("material.emission1", EMISSION);
+}
 struct Vertex {
 	glm::vec3 position;
 	glm::vec3 normal;
@@ -36,88 +55,138 @@ struct Texture {
 	unsigned int id;
 	TextureType type;
 	std::string path;
+	bool has_cutout = false;	// alpha low enough somewhere to be discarded
 };
+/**
+besides the interleaved vertices the mesh keeps its positions tightly packed in a second
+buffer for the depth only passes, and meshes whose diffuse texture has cut outs also keep
+positions and uvs together, so the pre-pass can discard the same samples as the shading pass
+*/
 struct Mesh {
 public:
+	// bytes of a vertex in each stream
+	static const unsigned int position_stride = sizeof(glm::vec3);
+	static const unsigned int cutout_stride = sizeof(glm::vec3) + sizeof(glm::vec2);
+
 	unsigned int VAO, VBO, EBO;
+	unsigned int depthVAO, positionVBO;
+	// only for alpha tested meshes, 0 otherwise
+	unsigned int cutoutVAO = 0, cutoutVBO = 0;
+
+	bool alpha_tested = false;
 
 	std::vector<Vertex> vertices;
 	std::vector<unsigned int> indices;
 	std::vector<Texture> textures;
-	std::vector<unsigned int> texture_locations;
+
+	// object space bounds of the vertex positions
+	AABB bounds;
 
 	Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures)
 		: vertices(vertices), indices(indices), textures(textures)
 	{
+		calculateBounds();
+		setupTextureUnits();
 		setupMesh();
+		setupDepthStreams();
 	}
-	void Draw(Shader& shader)
+	// with the program in use, its material samplers set by setMaterialSamplers
+	void Draw()
 	{
-		// only sets up shader texture locations on the first draw call
-		if (!has_rendered)
-		{
-			setupShader(shader);
-			has_rendered = true;
+		bindTextures();
 
-			print("textures: " << textures.size());
-			print("locations: " << texture_locations.size());
-		}
+		gl_state.bindVertexArray(VAO);
+		glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+	}
+	void DrawInstanced(unsigned int instances)
+	{
+		bindTextures();
 
-		for (unsigned int i = 0; i < texture_locations.size(); ++i)
-		{
-			glActiveTexture(GL_TEXTURE0 + i);
+		gl_state.bindVertexArray(VAO);
+		glDrawElementsInstanced(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0, instances);
+	}
+	/**
+	draws with the DrawElementsIndirectCommand stored at offset bytes into the
+	currently bound GL_DRAW_INDIRECT_BUFFER, so the instance count can be written on the GPU
+	*/
+	void DrawIndirect(unsigned int offset)
+	{
+		bindTextures();
+
+		gl_state.bindVertexArray(VAO);
+		glDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)(std::size_t)offset);
+	}
 
-			glEnable(GL_BLEND);
-			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	// positions only, no textures are bound
+	void DrawDepth(unsigned int instances = 1)
+	{
+		gl_state.bindVertexArray(depthVAO);
+		glDrawElementsInstanced(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0, instances);
+	}
+	void DrawDepthIndirect(unsigned int offset)
+	{
+		gl_state.bindVertexArray(depthVAO);
+		glDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)(std::size_t)offset);
+	}
+	// positions and uvs with only the diffuse texture bound, for alpha tested meshes
+	void DrawCutout()
+	{
+		gl_state.bindTexture(DIFFUSE, GL_TEXTURE_2D, textures[m_texture_units[DIFFUSE]].id);
+		gl_state.bindVertexArray(cutoutVAO);
+		glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+	}
+	void DrawCutoutIndirect(unsigned int offset)
+	{
+		gl_state.bindTexture(DIFFUSE, GL_TEXTURE_2D, textures[m_texture_units[DIFFUSE]].id);
+		gl_state.bindVertexArray(cutoutVAO);
+		glDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)(std::size_t)offset);
+	}
 
-			glUniform1i(texture_locations[i], i);
+private:
+	// indices into textures of the first texture of each type, -1 if there is none
+	int m_texture_units[EMISSION + 1];
 
-			glBindTexture(GL_TEXTURE_2D, textures[i].id);
-		}
+	void setupTextureUnits()
+	{
+		for (unsigned int i = 0; i <= EMISSION; ++i)
+			m_texture_units[i] = -1;
 
-		glBindVertexArray(VAO);
-		glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-		glBindVertexArray(0);
+		for (unsigned int i = 0; i < textures.size(); ++i)
+		{
+			if (m_texture_units[textures[i].type] < 0)
+				m_texture_units[textures[i].type] = i;
+		}
 	}
-	void DrawInstanced(Shader& shader, unsigned int instances)
+	void bindTextures()
 	{
-		// only sets up shader texture locations on the first draw call
-		if (!has_rendered)
+		for (unsigned int i = 0; i <= EMISSION; ++i)
 		{
-			setupShader(shader);
-			has_rendered = true;
-
-			print("textures: " << textures.size());
-			print("locations: " << texture_locations.size());
+			if (m_texture_units[i] >= 0)
+				gl_state.bindTexture(i, GL_TEXTURE_2D, textures[m_texture_units[i]].id);
 		}
+	}
+	void calculateBounds()
+	{
+		bounds.min = glm::vec3(0.0f);
+		bounds.max = glm::vec3(0.0f);
+		if (vertices.empty())
+			return;
 
-		for (unsigned int i = 0; i < texture_locations.size(); ++i)
+		bounds.min = vertices[0].position;
+		bounds.max = vertices[0].position;
+		for (unsigned int i = 1; i < vertices.size(); ++i)
 		{
-			glActiveTexture(GL_TEXTURE0 + i);
-
-			glEnable(GL_BLEND);
-			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-			glUniform1i(texture_locations[i], i);
-
-			glBindTexture(GL_TEXTURE_2D, textures[i].id);
+			bounds.min = glm::min(bounds.min, vertices[i].position);
+			bounds.max = glm::max(bounds.max, vertices[i].position);
 		}
-
-		glBindVertexArray(VAO);
-		glDrawElementsInstanced(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0, instances);
-		glBindVertexArray(0);
 	}
-
-private:
-	bool has_rendered = false;
-
 	void setupMesh()
 	{
 		glGenVertexArrays(1, &VAO);
 		glGenBuffers(1, &VBO);
 		glGenBuffers(1, &EBO);
 
-		glBindVertexArray(VAO);
+		gl_state.bindVertexArray(VAO);
 		glBindBuffer(GL_ARRAY_BUFFER, VBO);
 
 		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
@@ -135,70 +204,89 @@ private:
 		glEnableVertexAttribArray(2);
 		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, texCoords));
 
-		glBindVertexArray(0);
+		gl_state.bindVertexArray(0);
 	}
-	void setupShader(Shader& shader)
+	// the attribute locations match the interleaved VAO, so the same shaders can read either
+	void setupDepthStreams()
 	{
-		// finds and stores all uniform locations of the texture samplers
+		alpha_tested = m_texture_units[DIFFUSE] >= 0 && textures[m_texture_units[DIFFUSE]].has_cutout;
 
-		unsigned int diffuse_num = 1;
-		unsigned int specular_num = 1;
-		unsigned int normal_num = 1;
-		unsigned int emission_num = 1;
+		std::vector<glm::vec3> positions(vertices.size());
+		for (unsigned int i = 0; i < vertices.size(); ++i)
+			positions[i] = vertices[i].position;
 
-		for (unsigned int i = 0; i < textures.size(); ++i)
-		{
-			glActiveTexture(GL_TEXTURE0 + i);
+		glGenVertexArrays(1, &depthVAO);
+		glGenBuffers(1, &positionVBO);
+		gl_state.bindVertexArray(depthVAO);
+		glBindBuffer(GL_ARRAY_BUFFER, positionVBO);
+		glBufferData(GL_ARRAY_BUFFER, positions.size() * position_stride, positions.data(), GL_STATIC_DRAW);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
 
-			std::string number;
-			std::string name;
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, position_stride, (void*)0);
 
-			switch (textures[i].type)
+		if (alpha_tested)
+		{
+			std::vector<float> cutout(vertices.size() * 5);
+			for (unsigned int i = 0; i < vertices.size(); ++i)
 			{
-			case DIFFUSE:
-				name = "diffuse";
-				number = std::to_string(diffuse_num++);
-				break;
-			case SPECULAR:
-				name = "specular";
-				number = std::to_string(specular_num++);
-				break;
-			case NORMAL:
-				name = "normal";
-				number = std::to_string(normal_num++);
-				break;
-			case EMISSION:
-				name = "emission";
-				number = std::to_string(emission_num++);
+				cutout[i * 5 + 0] = vertices[i].position.x;
+				cutout[i * 5 + 1] = vertices[i].position.y;
+				cutout[i * 5 + 2] = vertices[i].position.z;
+				cutout[i * 5 + 3] = vertices[i].texCoords.x;
+				cutout[i * 5 + 4] = vertices[i].texCoords.y;
 			}
-			std::string uniform_name = "material." + name + number;
-			unsigned int loc = shader.uniformLoc(uniform_name);
-			texture_locations.push_back(loc);
-			print("found " << uniform_name << " texture at " << loc);
-			glBindTexture(GL_TEXTURE_2D, textures[i].id);
+
+			glGenVertexArrays(1, &cutoutVAO);
+			glGenBuffers(1, &cutoutVBO);
+			gl_state.bindVertexArray(cutoutVAO);
+			glBindBuffer(GL_ARRAY_BUFFER, cutoutVBO);
+			glBufferData(GL_ARRAY_BUFFER, cutout.size() * sizeof(float), cutout.data(), GL_STATIC_DRAW);
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+
+			glEnableVertexAttribArray(0);
+			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, cutout_stride, (void*)0);
+			glEnableVertexAttribArray(2);
+			glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, cutout_stride, (void*)sizeof(glm::vec3));
 		}
+
+		gl_state.bindVertexArray(0);
 	}
 };
 class Model {
 public:
 	std::vector<Mesh> meshes;
 
+	// union of all mesh bounds
+	AABB bounds;
+
 	Model(const std::string& path)
 	{
+		CPU_ZONE("Model::Model");
 		calculate_time(loadModel(path));
+
+		bounds.min = glm::vec3(0.0f);
+		bounds.max = glm::vec3(0.0f);
+		for (unsigned int i = 0; i < meshes.size(); ++i)
+		{
+			if (i == 0)
+				bounds = meshes[i].bounds;
+			else
+				bounds.expand(meshes[i].bounds);
+		}
 	}
-	void Draw(Shader& shader)
+	void Draw()
 	{
 		for (unsigned int i = 0; i < meshes.size(); ++i)
 		{
-			meshes[i].Draw(shader);
+			meshes[i].Draw();
 		}
 	}
-	void DrawInstanced(Shader& shader, unsigned int instances)
+	void DrawInstanced(unsigned int instances)
 	{
 		for (unsigned int i = 0; i < meshes.size(); ++i)
 		{
-			meshes[i].DrawInstanced(shader, instances);
+			meshes[i].DrawInstanced(instances);
 		}
 	}
 private:
@@ -208,7 +296,11 @@ private:
 	void loadModel(const std::string& path)
 	{
 		Assimp::Importer importer;
-		const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate);
+		const aiScene* scene;
+		{
+			CPU_ZONE("Model::import");
+			scene = importer.ReadFile(path, aiProcess_Triangulate);
+		}
 
 		if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
 		{
@@ -241,6 +333,7 @@ private:
 	}
 	Mesh processMesh(aiMesh* mesh, const aiScene* scene)
 	{
+		CPU_ZONE("Model::processMesh");
 		std::vector<Vertex> vertices;
 		vertices.reserve(mesh->mNumVertices);
 		std::vector<unsigned int> indices;
@@ -305,6 +398,7 @@ private:
 	}
 	std::vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType type, TextureType typeName)
 	{
+		CPU_ZONE("Model::loadMaterialTextures");
 		std::vector<Texture> textures;
 		for (unsigned int i = 0; i < mat->GetTextureCount(type); ++i)
 		{
@@ -323,7 +417,7 @@ private:
 			if (!skip)
 			{
 				Texture texture;
-				texture.id = TextureFromFile(str.C_Str(), directory, true);
+				texture.id = TextureFromFile(str.C_Str(), directory, true, GL_TEXTURE_2D, &texture.has_cutout);
 				texture.type = typeName;
 				texture.path = str.C_Str();
 				textures.push_back(texture);
@@ -0,0 +1,318 @@
+#pragma once
+#include <glad/glad.h>
+
+#include "GLState.h"
+#include "ThreadPool.h"
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <filesystem>
+#include <chrono>
+#include <random>
+#include <cmath>
+#include <iostream>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define NOISE_TEXTURE_SSE
+#endif
+
+struct NoiseSettings
+{
+	unsigned int size = 64;			// texels along x and y
+	unsigned int depth = 64;		// texels along z, 1 for a 2D texture
+	unsigned int period = 4;		// lattice cells across the texture in the first octave, a power of 2
+	unsigned int octaves = 4;		// each one has twice the cells of the last, up to 256
+	float persistence = 0.5f;		// amplitude of each octave relative to the last
+	unsigned int seed = 0;
+};
+
+/**
+improved perlin noise that repeats every period lattice cells, the same function Fragment.shader
+used to evaluate per fragment. noise is made a row at a time: along a row only x changes, so the
+y and z weights of the 8 corners of each cell are folded into two lines in x, one for each x side
+of the cell, and every texel is a fade and two multiply-adds, done 4 texels at a time with SSE2
+*/
+class PerlinNoise
+{
+public:
+	PerlinNoise(unsigned int seed)
+	{
+		for (unsigned int i = 0; i < 256; ++i)
+			m_p[i] = i;
+		std::mt19937 random(seed);
+		for (unsigned int i = 255; i > 0; --i)
+			std::swap(m_p[i], m_p[random() % (i + 1)]);
+		for (unsigned int i = 0; i < 256; ++i)
+			m_p[i + 256] = m_p[i];
+
+		// the gradients of grad() in the old shader, as vectors
+		for (int h = 0; h < 16; ++h)
+		{
+			m_gradients[h][0] = grad(h, 1, 0, 0);
+			m_gradients[h][1] = grad(h, 0, 1, 0);
+			m_gradients[h][2] = grad(h, 0, 0, 1);
+		}
+	}
+
+	/**
+	adds amplitude * noise to out[i] for count texels at x = (i + 0.5) * x_scale, all at y and z
+	*/
+	void addRow(float* out, unsigned int count, float x_scale, float y, float z, unsigned int period, float amplitude) const
+	{
+		unsigned int mask = period - 1;
+		int y0 = (int)std::floor(y);
+		int z0 = (int)std::floor(z);
+		float fy = y - y0;
+		float fz = z - z0;
+		float v = fade(fy);
+		float w = fade(fz);
+		y0 &= mask;
+		z0 &= mask;
+		int y1 = (y0 + 1) & mask;
+		int z1 = (z0 + 1) & mask;
+
+		// per cell, the noise on its low x side is g0 * fx + c0, and g1 * fx + c1 on its high side
+		float cells[256][4];
+		for (unsigned int x = 0; x < period; ++x)
+		{
+			int x_sides[2] = { (int)x, (int)((x + 1) & mask) };
+			for (int side = 0; side < 2; ++side)
+			{
+				int a = m_p[x_sides[side]];
+				float corners[4][3] = {
+					{ (1 - v) * (1 - w), fy, fz },
+					{ v * (1 - w), fy - 1, fz },
+					{ (1 - v) * w, fy, fz - 1 },
+					{ v * w, fy - 1, fz - 1 }
+				};
+				int hashes[4] = {
+					m_p[m_p[a + y0] + z0], m_p[m_p[a + y1] + z0],
+					m_p[m_p[a + y0] + z1], m_p[m_p[a + y1] + z1]
+				};
+				float g = 0.0f;
+				float c = 0.0f;
+				for (int i = 0; i < 4; ++i)
+				{
+					const float* gradient = m_gradients[hashes[i] & 15];
+					g += corners[i][0] * gradient[0];
+					c += corners[i][0] * (gradient[1] * corners[i][1] + gradient[2] * corners[i][2]);
+				}
+				// the high side is measured from x - 1
+				cells[x][side * 2] = g;
+				cells[x][side * 2 + 1] = side == 0 ? c : c - g;
+			}
+		}
+
+		unsigned int i = 0;
+#ifdef NOISE_TEXTURE_SSE
+		__m128 lanes = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+		__m128 scale = _mm_set1_ps(x_scale);
+		__m128i cell_mask = _mm_set1_epi32(mask);
+		__m128 amp = _mm_set1_ps(amplitude);
+		for (; i + 4 <= count; i += 4)
+		{
+			// x is never negative, so truncating is flooring
+			__m128 x = _mm_mul_ps(_mm_add_ps(_mm_set1_ps((float)i), lanes), scale);
+			__m128i xi = _mm_cvttps_epi32(x);
+			__m128 fx = _mm_sub_ps(x, _mm_cvtepi32_ps(xi));
+
+			alignas(16) int cell[4];
+			_mm_store_si128((__m128i*)cell, _mm_and_si128(xi, cell_mask));
+			__m128 g0 = _mm_loadu_ps(cells[cell[0]]);
+			__m128 c0 = _mm_loadu_ps(cells[cell[1]]);
+			__m128 g1 = _mm_loadu_ps(cells[cell[2]]);
+			__m128 c1 = _mm_loadu_ps(cells[cell[3]]);
+			_MM_TRANSPOSE4_PS(g0, c0, g1, c1);
+
+			// fx * fx * fx * (fx * (fx * 6 - 15) + 10)
+			__m128 u = _mm_add_ps(_mm_mul_ps(fx, _mm_sub_ps(_mm_mul_ps(fx, _mm_set1_ps(6.0f)), _mm_set1_ps(15.0f))), _mm_set1_ps(10.0f));
+			u = _mm_mul_ps(u, _mm_mul_ps(fx, _mm_mul_ps(fx, fx)));
+
+			__m128 low = _mm_add_ps(_mm_mul_ps(g0, fx), c0);
+			__m128 high = _mm_add_ps(_mm_mul_ps(g1, fx), c1);
+			__m128 noise = _mm_add_ps(low, _mm_mul_ps(u, _mm_sub_ps(high, low)));
+			_mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), _mm_mul_ps(noise, amp)));
+		}
+#endif
+		for (; i < count; ++i)
+		{
+			float x = (i + 0.5f) * x_scale;
+			int xi = (int)x;
+			float fx = x - xi;
+			const float* cell = cells[xi & mask];
+			float low = cell[0] * fx + cell[1];
+			float high = cell[2] * fx + cell[3];
+			out[i] += (low + fade(fx) * (high - low)) * amplitude;
+		}
+	}
+
+private:
+	int m_p[512];
+	float m_gradients[16][3];
+
+	static float fade(float t)
+	{
+		return t * t * t * (t * (t * 6 - 15) + 10);
+	}
+	static float grad(int hash, float x, float y, float z)
+	{
+		int h = hash & 15;
+		float u = h < 8 ? x : y;
+		float v = h < 4 ? y : h == 12 || h == 14 ? x : z;
+		return ((h & 1) == 0 ? u : -u) + ((h & 2) == 0 ? v : -v);
+	}
+};
+
+/**
+tileable fbm baked on the CPU into a 2 channel signed texture, 2D when settings.depth is 1
+and 3D otherwise. the channels are independent noise, so one fetch gives a 2D offset.
+rows are spread over a thread pool, and the texels are kept in cache_dir keyed by the
+settings, so later runs only read a file
+*/
+class NoiseTexture
+{
+public:
+	static const unsigned int texture_unit = 16;
+	static const unsigned int channels = 2;
+
+	NoiseSettings settings;
+	unsigned int target;
+
+	// how long the texels took to make or load, and whether they were loaded
+	float bake_ms = 0.0f;
+	bool from_cache = false;
+
+	NoiseTexture(const NoiseSettings& settings, const std::string& cache_dir = "cache") : settings(settings)
+	{
+		target = settings.depth > 1 ? GL_TEXTURE_3D : GL_TEXTURE_2D;
+
+		auto start = std::chrono::high_resolution_clock::now();
+		std::string path = cache_dir + "/" + cacheName();
+		std::vector<signed char> texels;
+		from_cache = load(path, texels);
+		if (!from_cache)
+		{
+			texels = bake(settings);
+			save(cache_dir, path, texels);
+		}
+		bake_ms = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+		glGenTextures(1, &m_texture);
+		gl_state.bindTexture(texture_unit, target, m_texture);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		if (target == GL_TEXTURE_3D)
+			glTexImage3D(GL_TEXTURE_3D, 0, GL_RG8_SNORM, settings.size, settings.size, settings.depth, 0, GL_RG, GL_BYTE, texels.data());
+		else
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RG8_SNORM, settings.size, settings.size, 0, GL_RG, GL_BYTE, texels.data());
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glGenerateMipmap(target);
+		glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(target, GL_TEXTURE_WRAP_R, GL_REPEAT);
+	}
+	~NoiseTexture()
+	{
+		glDeleteTextures(1, &m_texture);
+		gl_state.forgetTexture(m_texture);
+	}
+
+	void bind()
+	{
+		gl_state.bindTexture(texture_unit, target, m_texture);
+	}
+
+	/**
+	the texels of settings, x fastest, then y, then z, with the channels interleaved
+	*/
+	static std::vector<signed char> bake(const NoiseSettings& settings)
+	{
+		unsigned int octaves = settings.octaves;
+		while (octaves > 1 && (settings.period << (octaves - 1)) > 256)
+			--octaves;
+
+		std::vector<PerlinNoise> noise;
+		for (unsigned int c = 0; c < channels; ++c)
+			noise.emplace_back(settings.seed * channels + c);
+
+		// so the octaves add up to at most 1
+		float total = 0.0f;
+		for (unsigned int o = 0; o < octaves; ++o)
+			total += std::pow(settings.persistence, (float)o);
+
+		std::vector<signed char> texels(settings.size * settings.size * settings.depth * channels);
+		ThreadPool pool;
+		pool.parallelFor(settings.size * settings.depth, [&](unsigned int row)
+			{
+				unsigned int y = row % settings.size;
+				unsigned int z = row / settings.size;
+				std::vector<float> values(settings.size);
+				for (unsigned int c = 0; c < channels; ++c)
+				{
+					std::fill(values.begin(), values.end(), 0.0f);
+					float amplitude = 1.0f / total;
+					for (unsigned int o = 0; o < octaves; ++o)
+					{
+						unsigned int period = settings.period << o;
+						float scale = (float)period / settings.size;
+						// a 2D texture is the z = 0 plane
+						float fz = settings.depth > 1 ? (z + 0.5f) * period / settings.depth : 0.0f;
+						noise[c].addRow(values.data(), settings.size, scale, (y + 0.5f) * scale, fz, period, amplitude);
+						amplitude *= settings.persistence;
+					}
+
+					signed char* out = &texels[(row * settings.size) * channels + c];
+					for (unsigned int x = 0; x < settings.size; ++x)
+					{
+						float value = values[x] < -1.0f ? -1.0f : values[x] > 1.0f ? 1.0f : values[x];
+						out[x * channels] = (signed char)std::lround(value * 127.0f);
+					}
+				}
+			});
+		return texels;
+	}
+
+private:
+	unsigned int m_texture;
+
+	// bumped whenever the noise itself changes, so old files aren't used
+	static const unsigned int cache_version = 1;
+
+	std::string cacheName()
+	{
+		return "noise_v" + std::to_string(cache_version)
+			+ "_" + std::to_string(settings.size) + "x" + std::to_string(settings.depth)
+			+ "_p" + std::to_string(settings.period)
+			+ "_o" + std::to_string(settings.octaves)
+			+ "_" + std::to_string((int)std::lround(settings.persistence * 1000.0f))
+			+ "_s" + std::to_string(settings.seed) + ".bin";
+	}
+
+	bool load(const std::string& path, std::vector<signed char>& texels)
+	{
+		std::ifstream file(path, std::ios::binary | std::ios::ate);
+		if (!file)
+			return false;
+
+		size_t expected = settings.size * settings.size * settings.depth * channels;
+		if ((size_t)file.tellg() != expected)
+			return false;
+
+		texels.resize(expected);
+		file.seekg(0);
+		return (bool)file.read((char*)texels.data(), expected);
+	}
+
+	void save(const std::string& cache_dir, const std::string& path, const std::vector<signed char>& texels)
+	{
+		std::error_code error;
+		std::filesystem::create_directories(cache_dir, error);
+		std::ofstream file(path, std::ios::binary);
+		if (!error && file.write((const char*)texels.data(), texels.size()))
+			return;
+		std::cout << "ERROR::NOISE_TEXTURE::COULD_NOT_WRITE_CACHE " << path << std::endl;
+	}
+};
\ No newline at end of file
@@ -0,0 +1,299 @@
+#pragma once
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "GLExtensions.h"
+#include "GLState.h"
+#include "GpuTimer.h"
+#include "ComputeShader.h"
+#include "Bloom.h"
+
+#include <iostream>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+
+// the effects of PostProcess, with what their params mean
+enum PostEffect
+{
+	// per pixel, as many as fit are done in one dispatch
+	POST_BLOOM,			// x strength, y radius, z threshold. it's mixed in per pixel, but its mip chain is built from the stage's input before
+	POST_TONEMAP,		// x exposure, then the ACES curve
+	POST_COLOR_GRADE,	// x contrast, y saturation, z warmth, 1 1 0 leaves the image as it is
+	POST_VIGNETTE,		// x strength, y the distance from the center it starts at, 1 in the corners
+	POST_GRAYSCALE,
+	POST_THRESHOLD,		// x the luminance below which it's black, white above
+	POST_GAMMA,			// x gamma
+	// neighborhood, these read around each texel so they start a new dispatch, at their own resolution
+	POST_EDGES,			// the laplacian
+	POST_BLUR			// a 3x3 tent
+};
+
+const char* postEffectName(PostEffect effect)
+{
+	const char* names[] = { "bloom", "tonemap", "color grade", "vignette", "grayscale", "threshold", "gamma", "edges", "blur" };
+	return names[effect];
+}
+
+struct PostNode
+{
+	PostEffect effect;
+	glm::vec4 params;
+	float scale;		// of the resolution, only neighborhood effects can be below 1
+};
+
+struct PostProcessStats
+{
+	unsigned int nodes = 0;
+	unsigned int dispatches = 0;
+	unsigned int programs = 0;	// compiled so far, one for each different stage
+	float ms = 0.0f;
+};
+
+/**
+a chain of post-processing effects declared as nodes and run with compute shaders. the chain is cut
+into stages, each one dispatch that reads the previous stage's texture once: a neighborhood effect
+starts a stage, and every per pixel effect after it is fused into the same one, so tonemapping,
+grading, vignetting and gamma cost one read and one write of the image between them.
+neighborhood effects below full resolution get a stage of their own and the next one samples them
+back up. needs gl_caps.compute
+*/
+class PostProcess
+{
+public:
+	static const unsigned int texture_unit = 17;
+	static const unsigned int max_stage_effects = 8;
+
+	PostProcess(unsigned int width, unsigned int height) : m_width(width), m_height(height)
+	{
+		// the edges are clamped so neighborhood effects don't wrap around
+		glGenSamplers(1, &m_sampler);
+		glSamplerParameteri(m_sampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glSamplerParameteri(m_sampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glSamplerParameteri(m_sampler, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glSamplerParameteri(m_sampler, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glBindSampler(texture_unit, m_sampler);
+
+		m_timer = new GpuTimer();
+	}
+	~PostProcess()
+	{
+		deleteTextures();
+		glDeleteSamplers(1, &m_sampler);
+		for (auto& program : m_programs)
+			delete(program.second);
+		delete(m_bloom);
+		delete(m_timer);
+	}
+
+	void add(PostEffect effect, const glm::vec4& params = glm::vec4(0.0f), float scale = 1.0f)
+	{
+		m_nodes.push_back({ effect, params, isNeighborhood(effect) ? scale : 1.0f });
+		m_dirty = true;
+	}
+	void clear()
+	{
+		m_nodes.clear();
+		m_dirty = true;
+	}
+
+	// params can change every frame without rebuilding the stages
+	void setParams(unsigned int node, const glm::vec4& params)
+	{
+		m_nodes[node].params = params;
+	}
+	const std::vector<PostNode>& nodes()
+	{
+		return m_nodes;
+	}
+
+	void resize(unsigned int width, unsigned int height)
+	{
+		m_width = width;
+		m_height = height;
+		m_dirty = true;
+		if (m_bloom)
+			m_bloom->resize(width, height);
+	}
+
+	/**
+	runs the chain on input_texture, which must be at least as large as the output, into the
+	output texture. with no nodes it's copied. when the frame was drawn at a lower resolution it's
+	frame_scale of the input from its origin, and only that part of the output is written
+	*/
+	void apply(unsigned int input_texture, const glm::vec2& frame_scale = glm::vec2(1.0f))
+	{
+		if (m_dirty)
+			build();
+
+		m_timer->begin();
+		unsigned int src = input_texture;
+		for (unsigned int i = 0; i < m_stages.size(); ++i)
+		{
+			Stage& stage = m_stages[i];
+			bool last = i + 1 == m_stages.size();
+
+			glm::vec4 params[max_stage_effects];
+			for (unsigned int j = 0; j < stage.nodes.size(); ++j)
+				params[j] = m_nodes[stage.nodes[j]].params;
+			if (stage.bloom)
+				m_bloom->apply(src, params[0].y, params[0].z, frame_scale);
+
+			stage.shader->use();
+			glUniform4fv(stage.params_loc, stage.nodes.size(), glm::value_ptr(params[0]));
+			glUniform2i(stage.size_loc, stage.width, stage.height);
+			glUniform2f(stage.frame_scale_loc, frame_scale.x, frame_scale.y);
+			gl_state.bindTexture(texture_unit, GL_TEXTURE_2D, src);
+			glBindImageTexture(0, stage.texture, 0, GL_FALSE, 0, GL_WRITE_ONLY, last ? GL_RGBA8 : GL_RGBA16F);
+			stage.shader->dispatch((unsigned int)std::ceil(stage.width * frame_scale.x), (unsigned int)std::ceil(stage.height * frame_scale.y), 1, 8, 8);
+
+			// every stage's texture is sampled after, the output's by whoever draws it
+			glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+			src = stage.texture;
+		}
+		m_timer->end();
+
+		stats.nodes = m_nodes.size();
+		stats.dispatches = m_stages.size();
+		stats.programs = m_programs.size();
+		stats.ms = m_timer->ms();
+	}
+
+	// null until a chain has bloom
+	const Bloom* bloom()
+	{
+		return m_bloom;
+	}
+
+	// rgba8, at the size of the chain. valid after apply
+	unsigned int output()
+	{
+		return m_stages.back().texture;
+	}
+
+	PostProcessStats stats;
+
+private:
+	struct Stage
+	{
+		int neighborhood = 0;				// NEIGHBORHOOD in the shader
+		bool bloom = false;					// the chain is built from the input first, it's the first node
+		float scale = 1.0f;
+		std::vector<unsigned int> nodes;	// the per pixel ones after it
+
+		ComputeShader* shader = nullptr;
+		unsigned int params_loc;
+		unsigned int size_loc;
+		unsigned int frame_scale_loc;
+		unsigned int texture = 0;
+		unsigned int width;
+		unsigned int height;
+	};
+
+	std::vector<PostNode> m_nodes;
+	std::vector<Stage> m_stages;
+	bool m_dirty = true;
+
+	unsigned int m_width;
+	unsigned int m_height;
+
+	unsigned int m_sampler;
+	GpuTimer* m_timer;
+	Bloom* m_bloom = nullptr;
+
+	// by their defines, so switching between chains doesn't compile again
+	std::unordered_map<std::string, ComputeShader*> m_programs;
+
+	static bool isNeighborhood(PostEffect effect)
+	{
+		return effect == POST_EDGES || effect == POST_BLUR;
+	}
+
+	void build()
+	{
+		deleteTextures();
+		m_stages.clear();
+
+		for (unsigned int i = 0; i < m_nodes.size(); ++i)
+		{
+			const PostNode& node = m_nodes[i];
+			bool neighborhood = isNeighborhood(node.effect);
+			// per pixel effects can't be fused into a stage below full resolution, the output is full.
+			// bloom needs what the stage reads to be its input, so only the start of one will do
+			if (neighborhood || m_stages.empty() || m_stages.back().scale != 1.0f || m_stages.back().nodes.size() == max_stage_effects
+				|| (node.effect == POST_BLOOM && (m_stages.back().neighborhood || !m_stages.back().nodes.empty())))
+				m_stages.push_back(Stage());
+
+			if (neighborhood)
+			{
+				m_stages.back().neighborhood = node.effect == POST_EDGES ? 1 : 2;
+				m_stages.back().scale = glm::clamp(node.scale, 0.125f, 1.0f);
+			}
+			else
+			{
+				m_stages.back().bloom |= node.effect == POST_BLOOM;
+				m_stages.back().nodes.push_back(i);
+			}
+		}
+		// the last stage writes the output, which is at full resolution
+		if (m_stages.empty() || m_stages.back().scale != 1.0f)
+			m_stages.push_back(Stage());
+
+		for (unsigned int i = 0; i < m_stages.size(); ++i)
+		{
+			Stage& stage = m_stages[i];
+			bool last = i + 1 == m_stages.size();
+			stage.width = std::max((unsigned int)(m_width * stage.scale), 1u);
+			stage.height = std::max((unsigned int)(m_height * stage.scale), 1u);
+
+			stage.shader = program(stage, last);
+			stage.params_loc = stage.shader->uniformLoc("params");
+			stage.size_loc = stage.shader->uniformLoc("dst_size");
+			stage.frame_scale_loc = stage.shader->uniformLoc("frame_scale");
+			stage.shader->use();
+			stage.shader->setInt("src", texture_unit);
+			stage.shader->setInt("bloom_texture", Bloom::texture_unit);
+			if (stage.bloom && !m_bloom)
+				m_bloom = new Bloom(m_width, m_height);
+
+			glGenTextures(1, &stage.texture);
+			gl_state.bindTexture(texture_unit, GL_TEXTURE_2D, stage.texture);
+			glTexImage2D(GL_TEXTURE_2D, 0, last ? GL_RGBA8 : GL_RGBA16F, stage.width, stage.height, 0, GL_RGBA, GL_FLOAT, NULL);
+			// a single level, or it isn't complete to bind as an image
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		}
+
+		m_dirty = false;
+	}
+
+	ComputeShader* program(const Stage& stage, bool last)
+	{
+		const char* functions[] = { "bloom", "tonemap", "colorGrade", "vignette", "grayscale", "threshold", "gammaCorrect" };
+
+		std::string defines = "#define NEIGHBORHOOD " + std::to_string(stage.neighborhood) + "\n";
+		defines += std::string("#define DST_FORMAT ") + (last ? "rgba8" : "rgba16f") + "\n";
+		defines += "#define PIXEL_OPS";
+		for (unsigned int i = 0; i < stage.nodes.size(); ++i)
+			defines += std::string(" color = ") + functions[m_nodes[stage.nodes[i]].effect] + "(color, params[" + std::to_string(i) + "], uv);";
+		defines += "\n";
+
+		auto found = m_programs.find(defines);
+		if (found != m_programs.end())
+			return found->second;
+		return m_programs[defines] = new ComputeShader("shaders/PostProcessCompute.shader", defines);
+	}
+
+	void deleteTextures()
+	{
+		for (Stage& stage : m_stages)
+		{
+			glDeleteTextures(1, &stage.texture);
+			gl_state.forgetTexture(stage.texture);
+		}
+	}
+};
\ No newline at end of file
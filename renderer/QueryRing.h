@@ -0,0 +1,78 @@
+#pragma once
+#include <glad/glad.h>
+
+#include <vector>
+
+/**
+the queries of the last few frames, the same number of them each frame, read a few frames late once
+they're available so the CPU never waits on the GPU. the caller issues query(i) of the current frame
+with glBeginQuery or glQueryCounter, a frame's queries are expected to finish in the order of i
+*/
+class QueryRing
+{
+public:
+	static const unsigned int num_frames = 3;
+
+	QueryRing(unsigned int queries_per_frame = 1)
+		: m_queries_per_frame(queries_per_frame), m_queries(num_frames * queries_per_frame), m_results(queries_per_frame, 0)
+	{
+		glGenQueries(m_queries.size(), m_queries.data());
+	}
+	~QueryRing()
+	{
+		glDeleteQueries(m_queries.size(), m_queries.data());
+	}
+
+	// query i of the current frame
+	unsigned int query(unsigned int i = 0)
+	{
+		return m_queries[m_frame * m_queries_per_frame + i];
+	}
+
+	// moves on to the next frame, measured is if the current one's queries were issued
+	void endFrame(bool measured = true)
+	{
+		m_pending[m_frame] = measured;
+		m_frame = (m_frame + 1) % num_frames;
+	}
+
+	/**
+	reads the frames whose results are available, oldest first so the results are of the newest.
+	returns if any was read
+	*/
+	bool readResults()
+	{
+		bool read = false;
+		for (unsigned int j = 0; j < num_frames; ++j)
+		{
+			unsigned int i = (m_frame + j) % num_frames;
+			if (!m_pending[i])
+				continue;
+
+			// the queries finish in order, the last one being done means they all are
+			int available = 0;
+			glGetQueryObjectiv(m_queries[(i + 1) * m_queries_per_frame - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+			if (!available)
+				continue;
+
+			for (unsigned int k = 0; k < m_queries_per_frame; ++k)
+				glGetQueryObjectui64v(m_queries[i * m_queries_per_frame + k], GL_QUERY_RESULT, &m_results[k]);
+			m_pending[i] = false;
+			read = true;
+		}
+		return read;
+	}
+
+	// of query i in the newest frame read
+	GLuint64 result(unsigned int i = 0)
+	{
+		return m_results[i];
+	}
+
+private:
+	unsigned int m_queries_per_frame;
+	std::vector<unsigned int> m_queries;
+	std::vector<GLuint64> m_results;
+	bool m_pending[num_frames] = { false, false, false };
+	unsigned int m_frame = 0;
+};
\ No newline at end of file
@@ -0,0 +1,412 @@
+#pragma once
+#include <glad/glad.h>
+
+#include "GLExtensions.h"
+#include "GLState.h"
+#include "RenderTargetPool.h"
+#include "GpuProfiler.h"
+#include "CpuProfiler.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <functional>
+#include <algorithm>
+
+struct RenderGraphStats
+{
+	unsigned int passes = 0;		// that run
+	unsigned int culled = 0;		// nothing that runs uses what they write
+	unsigned int targets = 0;		// transient render targets of the passes that run
+	unsigned int allocations = 0;	// textures from the pool the targets are placed in
+	double bytes = 0.0;				// of the targets if each had its own memory
+	double aliased_bytes = 0.0;		// of the allocations
+};
+
+/**
+the passes of a frame and the render targets they read and write. the graph orders the passes by
+what they read from each other, culls the ones nothing that runs depends on, and places the transient
+targets of the rest: targets whose lifetimes don't overlap share an allocation, the same texture when
+they're alike and, with texture views, one of another format of the same size per pixel. allocations,
+views and framebuffers come from a RenderTargetPool, so declaring the frame again reuses them.
+passes that write an imported resource or have side effects are what the frame is for and always run.
+the graph is compiled again after anything is declared, so it's meant to be declared when the frame's
+setup changes and executed every frame, the passes decide what to do each frame themselves
+*/
+class RenderGraph
+{
+public:
+	class Pass
+	{
+	public:
+		Pass& read(unsigned int resource)
+		{
+			m_reads.push_back(resource);
+			return *this;
+		}
+		Pass& write(unsigned int resource)
+		{
+			m_writes.push_back(resource);
+			return *this;
+		}
+		// it has effects outside the graph, like the shadow maps it draws, so it's never culled
+		Pass& sideEffects()
+		{
+			m_side_effects = true;
+			return *this;
+		}
+
+	private:
+		friend class RenderGraph;
+
+		std::string m_name;
+		std::function<void()> m_execute;
+		std::vector<unsigned int> m_reads;
+		std::vector<unsigned int> m_writes;
+		bool m_side_effects = false;
+
+		bool m_culled = false;
+		unsigned int m_fbo = 0;			// with the targets it writes attached, or the imported framebuffer it writes
+	};
+
+	RenderGraph(RenderTargetPool* pool) : m_pool(pool)
+	{
+	}
+	~RenderGraph()
+	{
+		release();
+		for (Allocation& allocation : m_allocations)
+			m_pool->release(allocation.texture);
+	}
+
+	unsigned int createTarget(const std::string& name, const RenderTargetDesc& desc)
+	{
+		m_resources.push_back({ name, desc, false, false });
+		m_dirty = true;
+		return m_resources.size() - 1;
+	}
+	// a texture that lives outside the graph, desc says how to attach it
+	unsigned int importTexture(const std::string& name, unsigned int texture, const RenderTargetDesc& desc)
+	{
+		m_resources.push_back({ name, desc, true, false });
+		m_resources.back().texture = texture;
+		m_dirty = true;
+		return m_resources.size() - 1;
+	}
+	// 0 for the default framebuffer
+	unsigned int importFramebuffer(const std::string& name, unsigned int fbo)
+	{
+		m_resources.push_back({ name, RenderTargetDesc(), true, true });
+		m_resources.back().fbo = fbo;
+		m_dirty = true;
+		return m_resources.size() - 1;
+	}
+
+	Pass& addPass(const std::string& name, const std::function<void()>& execute)
+	{
+		m_passes.push_back(Pass());
+		m_passes.back().m_name = name;
+		m_passes.back().m_execute = execute;
+		m_dirty = true;
+		return m_passes.back();
+	}
+
+	// removes every pass and resource, the allocations are kept for the next compile to reuse, the
+	// ones it doesn't go back to the pool
+	void clear()
+	{
+		release();
+		m_passes.clear();
+		m_resources.clear();
+		m_order.clear();
+		m_dirty = true;
+	}
+
+	void execute()
+	{
+		CPU_ZONE("RenderGraph::execute");
+		if (m_dirty)
+			compile();
+
+		for (unsigned int i : m_order)
+		{
+			m_current = &m_passes[i];
+			GpuScope scope(m_profiler, m_current->m_name.c_str());
+			m_current->m_execute();
+		}
+		m_current = nullptr;
+	}
+
+	// valid once compiled, 0 for the targets of culled passes
+	unsigned int texture(unsigned int resource)
+	{
+		return m_resources[resource].texture;
+	}
+	// each pass that runs is a scope of the profiler's, named after it
+	void setProfiler(GpuProfiler* profiler)
+	{
+		m_profiler = profiler;
+	}
+
+	// of the pass being executed
+	unsigned int framebuffer()
+	{
+		return m_current ? m_current->m_fbo : 0;
+	}
+
+	// the passes in the order they run, and the culled ones
+	std::string describe()
+	{
+		std::string order;
+		for (unsigned int i : m_order)
+			order += (order.empty() ? "" : " -> ") + m_passes[i].m_name;
+		std::string culled;
+		for (const Pass& pass : m_passes)
+		{
+			if (pass.m_culled)
+				culled += (culled.empty() ? "" : ", ") + pass.m_name;
+		}
+		return order + (culled.empty() ? "" : ", culled " + culled);
+	}
+
+	RenderGraphStats stats;
+
+private:
+	struct Resource
+	{
+		std::string name;
+		RenderTargetDesc desc;
+		bool imported;
+		bool is_framebuffer;
+
+		unsigned int texture = 0;		// imported, or a view of the allocation, or the allocation itself
+		unsigned int fbo = 0;			// imported framebuffers
+		int first = -1;					// where in the order the passes that use it are
+		int last = -1;
+	};
+
+	struct Allocation
+	{
+		RenderTargetDesc desc;			// of the target it was made for
+		unsigned int texture;
+		int busy_until;					// the last pass in the order that uses a target in it
+		bool used;
+	};
+
+	RenderTargetPool* m_pool;
+	std::deque<Pass> m_passes;
+	std::vector<Resource> m_resources;
+	std::vector<Allocation> m_allocations;
+	std::vector<unsigned int> m_order;
+	bool m_dirty = true;
+	Pass* m_current = nullptr;
+	GpuProfiler* m_profiler = nullptr;
+
+	void compile()
+	{
+		CPU_ZONE("RenderGraph::compile");
+		release();
+		stats = RenderGraphStats();
+
+		// a pass depends on the passes declared before it that write what it reads or writes, or on
+		// every writer of what it reads if none is declared before it
+		unsigned int num_passes = m_passes.size();
+		std::vector<std::vector<unsigned int>> dependencies(num_passes);
+		for (unsigned int i = 0; i < num_passes; ++i)
+		{
+			std::vector<unsigned int> used = m_passes[i].m_reads;
+			used.insert(used.end(), m_passes[i].m_writes.begin(), m_passes[i].m_writes.end());
+			for (unsigned int j = 0; j < used.size(); ++j)
+			{
+				bool is_read = j < m_passes[i].m_reads.size();
+				std::vector<unsigned int> before = writers(used[j], 0, i);
+				if (before.empty() && is_read)
+					before = writers(used[j], i + 1, num_passes);
+				dependencies[i].insert(dependencies[i].end(), before.begin(), before.end());
+			}
+		}
+
+		// what the frame is for, and everything it depends on
+		std::vector<bool> live(num_passes, false);
+		std::vector<unsigned int> stack;
+		for (unsigned int i = 0; i < num_passes; ++i)
+		{
+			bool writes_imported = false;
+			for (unsigned int resource : m_passes[i].m_writes)
+				writes_imported |= m_resources[resource].imported;
+			if (m_passes[i].m_side_effects || writes_imported)
+				stack.push_back(i);
+		}
+		while (!stack.empty())
+		{
+			unsigned int pass = stack.back();
+			stack.pop_back();
+			if (live[pass])
+				continue;
+			live[pass] = true;
+			stack.insert(stack.end(), dependencies[pass].begin(), dependencies[pass].end());
+		}
+
+		// the live passes with their dependencies first, otherwise in the order they were declared
+		std::vector<bool> placed(num_passes, false);
+		for (unsigned int i = 0; i < num_passes; ++i)
+		{
+			m_passes[i].m_culled = !live[i];
+			stats.culled += !live[i];
+		}
+		while (true)
+		{
+			int next = -1;
+			bool remaining = false;
+			for (unsigned int i = 0; i < num_passes && next < 0; ++i)
+			{
+				if (!live[i] || placed[i])
+					continue;
+				remaining = true;
+				bool ready = true;
+				for (unsigned int dependency : dependencies[i])
+					ready &= placed[dependency] || dependency == i;
+				if (ready)
+					next = i;
+			}
+			if (next < 0)
+			{
+				if (remaining)
+				{
+					std::cout << "ERROR::RENDER_GRAPH:: the passes depend on each other in a cycle, running them in the declared order" << std::endl;
+					m_order.clear();
+					for (unsigned int i = 0; i < num_passes; ++i)
+					{
+						if (live[i])
+							m_order.push_back(i);
+					}
+				}
+				break;
+			}
+			placed[next] = true;
+			m_order.push_back(next);
+		}
+		stats.passes = m_order.size();
+
+		// lifetimes of the transient targets
+		for (unsigned int position = 0; position < m_order.size(); ++position)
+		{
+			const Pass& pass = m_passes[m_order[position]];
+			for (const std::vector<unsigned int>* used : { &pass.m_reads, &pass.m_writes })
+			{
+				for (unsigned int resource : *used)
+				{
+					Resource& target = m_resources[resource];
+					if (target.imported)
+						continue;
+					target.first = target.first < 0 ? position : std::min(target.first, (int)position);
+					target.last = std::max(target.last, (int)position);
+				}
+			}
+		}
+
+		// by first use, each into the first allocation it fits that's free by then
+		std::vector<unsigned int> targets;
+		for (unsigned int i = 0; i < m_resources.size(); ++i)
+		{
+			if (!m_resources[i].imported && m_resources[i].first >= 0)
+				targets.push_back(i);
+		}
+		std::stable_sort(targets.begin(), targets.end(), [this](unsigned int a, unsigned int b) { return m_resources[a].first < m_resources[b].first; });
+
+		for (Allocation& allocation : m_allocations)
+		{
+			allocation.busy_until = -1;
+			allocation.used = false;
+		}
+		for (unsigned int resource : targets)
+		{
+			Resource& target = m_resources[resource];
+			int found = -1;
+			for (unsigned int i = 0; i < m_allocations.size() && found < 0; ++i)
+			{
+				if (m_allocations[i].busy_until < target.first && RenderTargetPool::compatible(m_allocations[i].desc, target.desc))
+					found = i;
+			}
+			if (found < 0)
+			{
+				m_allocations.push_back({ target.desc, m_pool->acquire(target.desc), -1, false });
+				found = m_allocations.size() - 1;
+			}
+			Allocation& allocation = m_allocations[found];
+			allocation.busy_until = target.last;
+			allocation.used = true;
+
+			target.texture = gl_caps.texture_views ? m_pool->view(allocation.texture, target.desc) : allocation.texture;
+			stats.bytes += RenderTargetPool::bytes(target.desc);
+			++stats.targets;
+		}
+
+		// the ones no target fits anymore
+		for (unsigned int i = 0; i < m_allocations.size(); )
+		{
+			if (m_allocations[i].used)
+			{
+				stats.aliased_bytes += RenderTargetPool::bytes(m_allocations[i].desc);
+				++i;
+				continue;
+			}
+			m_pool->release(m_allocations[i].texture);
+			m_allocations.erase(m_allocations.begin() + i);
+		}
+		stats.allocations = m_allocations.size();
+
+		for (unsigned int i : m_order)
+			createFramebuffer(m_passes[i]);
+
+		m_dirty = false;
+	}
+
+	std::vector<unsigned int> writers(unsigned int resource, unsigned int begin, unsigned int end)
+	{
+		std::vector<unsigned int> passes;
+		for (unsigned int i = begin; i < end; ++i)
+		{
+			if (std::find(m_passes[i].m_writes.begin(), m_passes[i].m_writes.end(), resource) != m_passes[i].m_writes.end())
+				passes.push_back(i);
+		}
+		return passes;
+	}
+
+	void createFramebuffer(Pass& pass)
+	{
+		std::vector<unsigned int> colors;
+		unsigned int depth = 0;
+		for (unsigned int resource : pass.m_writes)
+		{
+			const Resource& target = m_resources[resource];
+			if (target.is_framebuffer)
+			{
+				pass.m_fbo = target.fbo;
+				return;
+			}
+			if (RenderTargetPool::isDepth(target.desc.internal_format))
+				depth = target.texture;
+			else
+				colors.push_back(target.texture);
+		}
+		if (!colors.empty() || depth)
+			pass.m_fbo = m_pool->framebuffer(colors, depth);
+	}
+
+	// what the last compile placed, the framebuffers and views stay in the pool
+	void release()
+	{
+		for (Pass& pass : m_passes)
+			pass.m_fbo = 0;
+		for (Resource& resource : m_resources)
+		{
+			if (!resource.imported)
+				resource.texture = 0;
+			resource.first = -1;
+			resource.last = -1;
+		}
+		m_order.clear();
+	}
+};
\ No newline at end of file
@@ -0,0 +1,367 @@
+#pragma once
+#include <glad/glad.h>
+
+#include "GLExtensions.h"
+#include "GLState.h"
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+
+struct RenderTargetDesc
+{
+	unsigned int width;
+	unsigned int height;
+	unsigned int internal_format;
+	unsigned int samples = 1;
+	unsigned int filter = GL_LINEAR;	// for sampling it, multisampled targets have none
+};
+
+struct RenderTargetPoolStats
+{
+	unsigned int textures = 0;		// held by the pool, in use or not
+	unsigned int in_use = 0;
+	unsigned int framebuffers = 0;
+	double bytes = 0.0;				// of the textures
+	unsigned int created = 0;		// textures made since the pool was created
+	unsigned int freed = 0;			// and deleted after going unused
+};
+
+/**
+render target textures handed out by their size, format and sample count, with the views of them in
+other formats of the same size per texel and the framebuffers they're attached to. released textures are kept and handed out
+again to whoever asks for the same kind, so nothing is recreated when a frame is declared again, and
+a target of a size the window just left is still there if it comes back. textures go unused for
+max_unused_frames before they're deleted, call endFrame once a frame to count them
+*/
+class RenderTargetPool
+{
+public:
+	RenderTargetPool(unsigned int max_unused_frames = 120) : m_max_unused_frames(max_unused_frames)
+	{
+	}
+	~RenderTargetPool()
+	{
+		while (!m_targets.empty())
+			freeTarget(m_targets.size() - 1);
+	}
+
+	/**
+	a texture nobody else has until it's released, a new one if none desc fits is free. with texture
+	views it can be one of another format, to be viewed as desc's
+	*/
+	unsigned int acquire(const RenderTargetDesc& desc)
+	{
+		int found = -1;
+		for (unsigned int i = 0; i < m_targets.size(); ++i)
+		{
+			const Target& target = m_targets[i];
+			if (target.in_use || !compatible(target.desc, desc))
+				continue;
+			if (found < 0 || target.desc.internal_format == desc.internal_format)
+				found = i;
+		}
+		if (found >= 0)
+		{
+			m_targets[found].in_use = true;
+			m_targets[found].unused_frames = 0;
+			return m_targets[found].texture;
+		}
+
+		Target target;
+		target.desc = desc;
+		target.texture = allocate(desc);
+		target.in_use = true;
+		m_targets.push_back(target);
+		++stats.created;
+		updateStats();
+		return target.texture;
+	}
+	void release(unsigned int texture)
+	{
+		int found = find(texture);
+		if (found >= 0)
+			m_targets[found].in_use = false;
+	}
+
+	/**
+	texture viewed with desc's format, which must have the same size per texel, and desc's filter.
+	kept with the texture, it needs gl_caps.texture_views
+	*/
+	unsigned int view(unsigned int texture, const RenderTargetDesc& desc)
+	{
+		Target& target = m_targets[find(texture)];
+		for (const View& view : target.views)
+		{
+			if (view.desc.internal_format == desc.internal_format && view.desc.filter == desc.filter)
+				return view.texture;
+		}
+
+		View view = { target.desc, 0 };
+		view.desc.internal_format = desc.internal_format;
+		view.desc.filter = desc.filter;
+		glGenTextures(1, &view.texture);
+		glTextureView(view.texture, textureTarget(view.desc), texture, view.desc.internal_format, 0, 1, 0, 1);
+		setParameters(view.texture, view.desc);
+		target.views.push_back(view);
+		return view.texture;
+	}
+
+	/**
+	a framebuffer with the colors attached in order and depth, 0 for none, all of them textures or views
+	from the pool. it's kept until one of them is deleted
+	*/
+	unsigned int framebuffer(const std::vector<unsigned int>& colors, unsigned int depth)
+	{
+		std::vector<unsigned int> attachments = colors;
+		attachments.push_back(depth);
+		for (const Framebuffer& framebuffer : m_framebuffers)
+		{
+			if (framebuffer.attachments == attachments)
+				return framebuffer.fbo;
+		}
+
+		Framebuffer framebuffer = { attachments, 0 };
+		glGenFramebuffers(1, &framebuffer.fbo);
+		gl_state.bindFramebuffer(GL_FRAMEBUFFER, framebuffer.fbo);
+
+		std::vector<unsigned int> draw_buffers;
+		for (unsigned int i = 0; i < colors.size(); ++i)
+		{
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, textureTarget(describe(colors[i])), colors[i], 0);
+			draw_buffers.push_back(GL_COLOR_ATTACHMENT0 + i);
+		}
+		if (depth)
+		{
+			RenderTargetDesc desc = describe(depth);
+			unsigned int attachment = hasStencil(desc.internal_format) ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT;
+			glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, textureTarget(desc), depth, 0);
+		}
+		if (draw_buffers.empty())
+			glDrawBuffer(GL_NONE);
+		else
+			glDrawBuffers(draw_buffers.size(), draw_buffers.data());
+
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		{
+			std::cout << "ERROR::RENDER_TARGET_POOL:: framebuffer is not complete!" << std::endl;
+		}
+		gl_state.bindFramebuffer(GL_FRAMEBUFFER, 0);
+
+		m_framebuffers.push_back(framebuffer);
+		updateStats();
+		return framebuffer.fbo;
+	}
+
+	// deletes what has been released for too long
+	void endFrame()
+	{
+		for (unsigned int i = 0; i < m_targets.size(); )
+		{
+			Target& target = m_targets[i];
+			if (!target.in_use && ++target.unused_frames > m_max_unused_frames)
+			{
+				freeTarget(i);
+				++stats.freed;
+				continue;
+			}
+			++i;
+		}
+		updateStats();
+	}
+
+	RenderTargetPoolStats stats;
+
+	// whether a target of b can be placed in a texture made for a
+	static bool compatible(const RenderTargetDesc& a, const RenderTargetDesc& b)
+	{
+		if (a.width != b.width || a.height != b.height || a.samples != b.samples)
+			return false;
+		// the filter is set on the views when there are any, otherwise it's part of the texture
+		if (a.internal_format == b.internal_format)
+			return gl_caps.texture_views || a.filter == b.filter;
+		// depth formats can only be viewed as themselves
+		return gl_caps.texture_views && !isDepth(a.internal_format) && !isDepth(b.internal_format) && texelBytes(a.internal_format) == texelBytes(b.internal_format);
+	}
+
+	static unsigned int textureTarget(const RenderTargetDesc& desc)
+	{
+		return desc.samples > 1 ? GL_TEXTURE_2D_MULTISAMPLE : GL_TEXTURE_2D;
+	}
+
+	static double bytes(const RenderTargetDesc& desc)
+	{
+		return (double)desc.width * desc.height * desc.samples * texelBytes(desc.internal_format);
+	}
+
+	static unsigned int texelBytes(unsigned int internal_format)
+	{
+		switch (internal_format)
+		{
+		case GL_R8:
+			return 1;
+		case GL_RG8:
+		case GL_R16F:
+		case GL_DEPTH_COMPONENT16:
+			return 2;
+		case GL_RGB8:
+		case GL_SRGB8:
+			return 3;
+		case GL_RGB16F:
+			return 6;
+		case GL_RGBA16F:
+		case GL_RG32F:
+		case GL_DEPTH32F_STENCIL8:
+			return 8;
+		case GL_RGB32F:
+			return 12;
+		case GL_RGBA32F:
+			return 16;
+		default:
+			return 4;
+		}
+	}
+
+	static bool isDepth(unsigned int internal_format)
+	{
+		return internal_format == GL_DEPTH_COMPONENT16 || internal_format == GL_DEPTH_COMPONENT24 || internal_format == GL_DEPTH_COMPONENT32F
+			|| hasStencil(internal_format);
+	}
+	static bool hasStencil(unsigned int internal_format)
+	{
+		return internal_format == GL_DEPTH24_STENCIL8 || internal_format == GL_DEPTH32F_STENCIL8;
+	}
+
+private:
+	struct View
+	{
+		RenderTargetDesc desc;
+		unsigned int texture;
+	};
+
+	struct Target
+	{
+		RenderTargetDesc desc;
+		unsigned int texture;
+		std::vector<View> views;
+		bool in_use = false;
+		unsigned int unused_frames = 0;
+	};
+
+	struct Framebuffer
+	{
+		std::vector<unsigned int> attachments;	// the colors, then the depth or 0
+		unsigned int fbo;
+	};
+
+	std::vector<Target> m_targets;
+	std::vector<Framebuffer> m_framebuffers;
+	unsigned int m_max_unused_frames;
+
+	int find(unsigned int texture)
+	{
+		for (unsigned int i = 0; i < m_targets.size(); ++i)
+		{
+			if (m_targets[i].texture == texture)
+				return i;
+		}
+		return -1;
+	}
+
+	// of a texture or a view in the pool
+	RenderTargetDesc describe(unsigned int texture)
+	{
+		for (const Target& target : m_targets)
+		{
+			if (target.texture == texture)
+				return target.desc;
+			for (const View& view : target.views)
+			{
+				if (view.texture == texture)
+					return view.desc;
+			}
+		}
+		return { 0, 0, 0 };
+	}
+
+	unsigned int allocate(const RenderTargetDesc& desc)
+	{
+		unsigned int texture;
+		glGenTextures(1, &texture);
+		gl_state.bindTexture(0, textureTarget(desc), texture);
+
+		// views need immutable storage
+		if (gl_caps.texture_views && desc.samples > 1)
+			glTexStorage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, desc.samples, desc.internal_format, desc.width, desc.height, GL_TRUE);
+		else if (gl_caps.texture_views)
+			glTexStorage2D(GL_TEXTURE_2D, 1, desc.internal_format, desc.width, desc.height);
+		else if (desc.samples > 1)
+			glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, desc.samples, desc.internal_format, desc.width, desc.height, GL_TRUE);
+		else if (isDepth(desc.internal_format))
+			glTexImage2D(GL_TEXTURE_2D, 0, desc.internal_format, desc.width, desc.height, 0, hasStencil(desc.internal_format) ? GL_DEPTH_STENCIL : GL_DEPTH_COMPONENT,
+				desc.internal_format == GL_DEPTH32F_STENCIL8 ? GL_FLOAT_32_UNSIGNED_INT_24_8_REV : hasStencil(desc.internal_format) ? GL_UNSIGNED_INT_24_8 : GL_FLOAT, NULL);
+		else
+			glTexImage2D(GL_TEXTURE_2D, 0, desc.internal_format, desc.width, desc.height, 0, GL_RGBA, GL_FLOAT, NULL);
+
+		gl_state.bindTexture(0, textureTarget(desc), 0);
+		setParameters(texture, desc);
+		return texture;
+	}
+
+	void setParameters(unsigned int texture, const RenderTargetDesc& desc)
+	{
+		if (desc.samples > 1)
+			return;
+		gl_state.bindTexture(0, GL_TEXTURE_2D, texture);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, desc.filter);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, desc.filter);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		gl_state.bindTexture(0, GL_TEXTURE_2D, 0);
+	}
+
+	// with its views and every framebuffer either is attached to
+	void freeTarget(unsigned int index)
+	{
+		Target& target = m_targets[index];
+		std::vector<unsigned int> textures = { target.texture };
+		for (const View& view : target.views)
+			textures.push_back(view.texture);
+
+		gl_state.bindFramebuffer(GL_FRAMEBUFFER, 0);
+		for (unsigned int i = 0; i < m_framebuffers.size(); )
+		{
+			const std::vector<unsigned int>& attachments = m_framebuffers[i].attachments;
+			bool attached = false;
+			for (unsigned int texture : textures)
+				attached |= std::find(attachments.begin(), attachments.end(), texture) != attachments.end();
+			if (attached)
+			{
+				glDeleteFramebuffers(1, &m_framebuffers[i].fbo);
+				m_framebuffers.erase(m_framebuffers.begin() + i);
+				continue;
+			}
+			++i;
+		}
+
+		for (unsigned int texture : textures)
+		{
+			glDeleteTextures(1, &texture);
+			gl_state.forgetTexture(texture);
+		}
+		m_targets.erase(m_targets.begin() + index);
+	}
+
+	void updateStats()
+	{
+		stats.textures = m_targets.size();
+		stats.in_use = 0;
+		stats.bytes = 0.0;
+		for (const Target& target : m_targets)
+		{
+			stats.in_use += target.in_use;
+			stats.bytes += bytes(target.desc);
+		}
+		stats.framebuffers = m_framebuffers.size();
+	}
+};
\ No newline at end of file
@@ -12,15 +12,63 @@
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
-#include <gl_util/Shader.h>
 #include <gl_util/Camera.h>
 
 #include "Model.h"
 #include "Light.h"
+#include "LightBuffer.h"
+#include "ClusteredLights.h"
+#include "ShadowAtlas.h"
+#include "CascadedShadows.h"
+#include "ShadowFilter.h"
+#include "NoiseTexture.h"
+#include "ShaderVariants.h"
+#include "InstanceCuller.h"
+#include "HiZCuller.h"
+#include "SoftwareOcclusion.h"
+#include "DepthPrepass.h"
+#include "GpuTimer.h"
+#include "GpuProfiler.h"
+#include "CpuProfiler.h"
+#include "GBuffer.h"
+#include "GLState.h"
+#include "Bounds.h"
 
 #include <vector>
 #include <ctime>
 
+enum RenderPath
+{
+	RENDER_PATH_FORWARD,
+	RENDER_PATH_DEFERRED
+};
+
+// gpu time and estimated render target traffic of the opaque passes, from the last measured frame
+struct RenderPathStats
+{
+	float opaque_ms = 0.0f;		// opaque geometry and its lighting
+	float lighting_ms = 0.0f;	// forward shading pass, or deferred lighting pass
+	double attachment_bytes = 0.0;
+};
+
+// vertex bytes read by the depth only passes, next to what the interleaved vertices would have cost
+struct DepthStreamStats
+{
+	float shadow_ms = 0.0f;
+	double shadow_bytes = 0.0;
+	double shadow_interleaved_bytes = 0.0;
+	double prepass_bytes = 0.0;
+	double prepass_interleaved_bytes = 0.0;
+};
+
+// the pass that writes the motion of what moved on its own since the last frame, see drawVelocity
+struct VelocityStats
+{
+	unsigned int objects = 0;	// render objects and meshes whose transform changed
+	unsigned int instanced = 0;	// instanced models, their vertices are animated every frame
+	float ms = 0.0f;
+};
+
 struct RenderObject
 {
 	unsigned int VAO;
@@ -28,11 +76,28 @@ struct RenderObject
 	unsigned int num_elements;
 
 	glm::mat4 model;
+	// what it was drawn with last frame, for the motion vectors
+	glm::mat4 prev_model;
+
+	// object space bounds, objects without bounds are never culled
+	AABB bounds;
+	bool has_bounds;
 
 	RenderObject(unsigned int VAO, unsigned int texture, unsigned int num_elements, glm::mat4 model) :
-		VAO(VAO), texture(texture), num_elements(num_elements), model(model) {}
+		VAO(VAO), texture(texture), num_elements(num_elements), model(model), prev_model(model), bounds{ glm::vec3(0.0f), glm::vec3(0.0f) }, has_bounds(false) {}
+
+	RenderObject(unsigned int VAO, unsigned int texture, unsigned int num_elements, glm::mat4 model, const AABB& bounds) :
+		VAO(VAO), texture(texture), num_elements(num_elements), model(model), prev_model(model), bounds(bounds), has_bounds(true) {}
+
+	AABB worldBounds() const
+	{
+		if (!has_bounds)
+			return { glm::vec3(-1e30f), glm::vec3(1e30f) };
+		return bounds.transform(model);
+	}
 
-	void setModelUniform(Shader* shader)
+	template<typename ShaderType>
+	void setModelUniform(ShaderType* shader)
 	{
 		model_uniform_loc = shader->uniformLoc("model");
 		glUniformMatrix4fv(model_uniform_loc, 1, GL_FALSE, glm::value_ptr(model));
@@ -49,15 +114,73 @@ class Renderer
 
 	int m_screen_width;
 	int m_screen_height;
+	// the part of the scene framebuffer drawn into
+	int m_viewport_width;
+	int m_viewport_height;
 
 	glm::mat4* curr_view;
 	glm::mat4* curr_projection;
+	// without the jitter of TAA, for what should only change when the camera does
+	glm::mat4* curr_unjittered_projection;
 	unsigned int m_ubo_matrices;
 
 	std::vector<RenderObject> m_render_objects;
 
 	std::vector<Model*> m_models;
 	std::vector<glm::mat4*> m_model_transforms;
+	std::vector<glm::mat4> m_prev_model_transforms;
+
+	std::vector<InstanceCuller*> m_instanced_models;
+
+	// hi-z occlusion culling of render objects and model meshes
+	HiZCuller* m_hiz_culler = nullptr;
+	bool m_occlusion_culling = true;
+	unsigned int m_scene_fbo = 0;
+	std::vector<unsigned int> m_render_object_cull_index;
+	std::vector<unsigned int> m_model_cull_index;
+
+	// cpu occlusion culling against a few large, simple occluders
+	struct Occluder
+	{
+		OccluderMesh mesh;
+		int render_object;		// index of the render object it moves with, or -1
+		glm::mat4* transform;	// model transform when it isn't a render object
+	};
+	SoftwareOcclusion m_software_occlusion;
+	bool m_software_culling = true;
+	std::vector<Occluder> m_occluders;
+	std::vector<char> m_render_object_visible;
+	std::vector<char> m_mesh_visible;
+	std::vector<unsigned int> m_model_mesh_offset;
+
+	DepthPrepass* m_depth_prepass;
+
+	// forward shading, or a G-buffer pass followed by a fullscreen lighting pass
+	RenderPath m_render_path = RENDER_PATH_FORWARD;
+	GBuffer* m_gbuffer;
+	unsigned int m_fullscreen_VAO;
+	int m_scene_samples = 1;
+
+	// gpu time of the opaque passes, and of the shading or lighting pass within them.
+	// the deferred path's passes are drawn in two steps, its opaque time is the G-buffer's and the lighting's
+	GpuTimer* m_opaque_timer;
+	GpuTimer* m_gbuffer_timer;
+	GpuTimer* m_shading_timer;
+
+	// of the frame beginFrame set up, for the steps after it
+	bool m_frame_occlusion_culling = false;
+	glm::mat4 m_frame_view_proj;
+	// the animation time of the instanced models
+	float m_frame_angle = 0.0f;
+
+	// of the last frame, kept by endFrame for the motion vectors
+	glm::mat4 m_prev_view_proj = glm::mat4(1.0f);
+	float m_prev_angle = 0.0f;
+	GpuTimer* m_velocity_timer;
+	VelocityStats m_velocity_stats;
+
+	// scopes of the frame's steps, when there is one
+	GpuProfiler* m_profiler = nullptr;
 
 	unsigned int m_cubemap_VAO;
 	unsigned int m_light_VAO;
@@ -65,63 +188,96 @@ class Renderer
 	unsigned int m_texture;
 	unsigned int m_cubemap_texture;
 
-	DirLight* m_dirlight;
-	PointLight* m_pointlight;
-	SpotLight* m_spotlight;
+	// every point and spot light is in m_clustered_lights
+	DirLight* m_dirlight = nullptr;
 
-	const float m_shadow_r = 10.0f;
-	const float m_shadow_near_plane = -20.0f;
-	const float m_shadow_far_plane = 20.0f;
+	LightBuffer* m_light_buffer;
+	ClusteredLights* m_clustered_lights;
 
-	Shader* m_shader;
-	Shader* m_outline_shader;
-	Shader* m_light_shader;
-	Shader* m_skybox_shader;
-	Shader* m_shadow_shader;
-	Shader* m_point_shadow_shader;
+	// shadow maps of the point and spot lights that cast one, cascades for the directional light,
+	// and what each shadow caster id draws
+	struct ShadowCaster
+	{
+		int render_object;	// or -1
+		int model;			// with mesh, when it isn't a render object
+		unsigned int mesh;
+	};
+	ShadowAtlas* m_shadow_atlas;
+	CascadedShadows* m_cascades;
+	std::vector<ShadowCaster> m_shadow_casters;
+	std::vector<AABB> m_shadow_caster_bounds;
+	std::vector<unsigned int> m_cascade_casters;
+	std::vector<unsigned int> m_render_object_shadow_caster;
+	std::vector<unsigned int> m_model_shadow_caster;
+
+	// baked noise for the NOISE_OFFSETS variant of Fragment.shader
+	NoiseTexture* m_noise;
+
+	// programs with compile time features, see ShaderVariants.h. the lit and deferred lighting
+	// programs get the lighting features of the frame, every renderable adds what it needs
+	ShaderCache m_shader_cache;
+	ShaderVariants* m_lit_shaders;
+	ShaderVariants* m_gbuffer_shaders;
+	ShaderVariants* m_deferred_shaders;
+	ShaderVariants* m_depth_shaders;
+	ShaderVariants* m_velocity_shaders;
+	unsigned int m_frame_features = 0;
+	bool m_noise_offsets = false;
+
+	// owned by m_shader_cache
+	ShaderProgram* m_outline_shader;
+	ShaderProgram* m_light_shader;
+	ShaderProgram* m_skybox_shader;
+	ShaderProgram* m_shadow_shader;
+	ShaderProgram* m_cascade_shadow_shader;
+	ShaderProgram* m_point_shadow_shader = nullptr;
 
-	unsigned int m_model_loc;
 	unsigned int m_outline_model_loc;
 	unsigned int m_light_model_loc;
 	unsigned int m_shadow_model_loc;
+	unsigned int m_cascade_shadow_model_loc;
+	unsigned int m_shadow_matrix_loc_shadow;
 	unsigned int m_point_shadow_model_loc;
+	unsigned int m_point_shadow_first_view_loc;
+	unsigned int m_point_shadow_faces_loc;
 
-	unsigned int m_shadow_matrix_loc_shadow;
-	unsigned int m_shadow_matrix_loc_point_shadow;
+	// point light faces drawn with one instanced draw per caster, needs gl_caps.vertex_layer
+	bool m_point_shadow_instancing = false;
+	std::vector<int> m_point_shadow_faces;
+
+	DepthStreamStats m_depth_stream_stats;
 
-	unsigned int m_point_shadow_lightpos_loc;
-	unsigned int m_point_shadow_farplane_loc;
+	ShadowFilterMode m_shadow_filter;
 
 public:
 	Renderer(GLFWwindow* window) : window(window)
 	{
-		m_shader = new Shader("shaders/Vertex.shader", "shaders/Fragment.shader");
-		m_outline_shader = new Shader("shaders/Vertex.shader", "shaders/OutlineFragment.shader");
-		m_light_shader = new Shader("shaders/LightVertex.shader", "shaders/LightFragment.shader");
-		m_skybox_shader = new Shader("shaders/SkyboxVertex.shader", "shaders/SkyboxFragment.shader");
-		m_shadow_shader = new Shader("shaders/ShadowVertex.shader", "shaders/ShadowFragment.shader");
-		m_point_shadow_shader = new Shader("shaders/PointLightShadowVertex.shader", "shaders/PointLightShadowFragment.shader");
-		m_point_shadow_shader->addGeometryShader("shaders/PointLightShadowGeometry.shader");
+		CPU_ZONE("Renderer::Renderer");
+
+		// lights and shadows are shared by every lit program, which are bound to them in setupProgram
+		m_light_buffer = new LightBuffer();
+		m_clustered_lights = new ClusteredLights();
+		m_shadow_atlas = new ShadowAtlas(2048, 2);
+		m_cascades = new CascadedShadows(2048, 4);
+
+		m_noise = new NoiseTexture(NoiseSettings());
+		m_noise->bind();
+
+		// without parallel compiles in the driver, programs are compiled on a thread with a shared context
+		if (!gl_caps.parallel_compile && window)
+			m_shader_cache.startWorker(window);
+		loadPrograms();
+		m_point_shadow_instancing = m_point_shadow_shader != nullptr;
 
 		glfwGetWindowSize(window, &m_screen_width, &m_screen_height);
+		m_viewport_width = m_screen_width;
+		m_viewport_height = m_screen_height;
 
 		m_render_objects.reserve(4);
 
 		m_models.reserve(20);
 		m_model_transforms.reserve(20);
 
-		m_model_loc = m_shader->uniformLoc("model");
-		m_outline_model_loc = m_outline_shader->uniformLoc("model");
-		m_light_model_loc = m_light_shader->uniformLoc("model");
-		m_shadow_model_loc = m_shadow_shader->uniformLoc("model");
-		m_point_shadow_model_loc = m_point_shadow_shader->uniformLoc("model");
-
-		m_shadow_matrix_loc_shadow = m_shadow_shader->uniformLoc("shadowSpaceMatrix");
-		m_shadow_matrix_loc_point_shadow = m_point_shadow_shader->uniformLoc("shadow_matrices");
-
-		m_point_shadow_lightpos_loc = m_point_shadow_shader->uniformLoc("light_pos");
-		m_point_shadow_farplane_loc = m_point_shadow_shader->uniformLoc("far_plane");
-
 		// skybox
 		std::vector<std::string> faces
 		{
@@ -183,7 +339,7 @@ public:
 
 		glGenVertexArrays(1, &m_cubemap_VAO);
 
-		glBindVertexArray(m_cubemap_VAO);
+		gl_state.bindVertexArray(m_cubemap_VAO);
 
 		glBindBuffer(GL_ARRAY_BUFFER, cubemapVBO);
 		glBufferData(GL_ARRAY_BUFFER, sizeof(cubemapVertices), cubemapVertices, GL_STATIC_DRAW);
@@ -193,14 +349,6 @@ public:
 		glEnableVertexAttribArray(0);
 
 		// uniform buffer objects
-		unsigned int uniform_block_index_vertex = glGetUniformBlockIndex(m_shader->m_ID, "Matrices"); // optional, could use binding = 0 in shader
-		unsigned int uniform_block_index_light = glGetUniformBlockIndex(m_light_shader->m_ID, "Matrices");
-		unsigned int uniform_block_index_skybox = glGetUniformBlockIndex(m_skybox_shader->m_ID, "Matrices");
-
-		glUniformBlockBinding(m_shader->m_ID, uniform_block_index_vertex, 0);
-		glUniformBlockBinding(m_light_shader->m_ID, uniform_block_index_light, 0);
-		glUniformBlockBinding(m_skybox_shader->m_ID, uniform_block_index_skybox, 0);
-
 		glGenBuffers(1, &m_ubo_matrices);
 
 		glBindBuffer(GL_UNIFORM_BUFFER, m_ubo_matrices);
@@ -208,40 +356,275 @@ public:
 		glBindBufferRange(GL_UNIFORM_BUFFER, 0, m_ubo_matrices, 0, 2 * sizeof(glm::mat4));
 		glBindBuffer(GL_UNIFORM_BUFFER, 0);
 
+		// the lighting pass's triangle is made in the vertex shader, but a vertex array must still be bound
+		glGenVertexArrays(1, &m_fullscreen_VAO);
+		m_gbuffer = new GBuffer(m_screen_width, m_screen_height);
+
+		if (gl_caps.compute)
+			m_hiz_culler = new HiZCuller(m_screen_width, m_screen_height);
+
+		m_depth_prepass = new DepthPrepass();
+		m_opaque_timer = new GpuTimer();
+		m_gbuffer_timer = new GpuTimer();
+		m_shading_timer = new GpuTimer();
+		m_velocity_timer = new GpuTimer();
 	}
 	~Renderer()
 	{
-		delete(m_shader);
-		delete(m_outline_shader);
-		delete(m_light_shader);
-		delete(m_skybox_shader);
-		delete(m_shadow_shader);
+		delete(m_lit_shaders);
+		delete(m_gbuffer_shaders);
+		delete(m_deferred_shaders);
+		delete(m_depth_shaders);
+		delete(m_velocity_shaders);
+
+		delete(m_hiz_culler);
+		delete(m_depth_prepass);
+		delete(m_light_buffer);
+		delete(m_clustered_lights);
+		delete(m_shadow_atlas);
+		delete(m_cascades);
+		delete(m_noise);
+		delete(m_opaque_timer);
+		delete(m_gbuffer_timer);
+		delete(m_shading_timer);
+		delete(m_velocity_timer);
+		delete(m_gbuffer);
+		glDeleteVertexArrays(1, &m_fullscreen_VAO);
 	}
 	
-	void addRenderObject(unsigned int VAO, unsigned int texture, unsigned int num_elements, glm::mat4& model)
+	unsigned int addRenderObject(unsigned int VAO, unsigned int texture, unsigned int num_elements, glm::mat4& model)
 	{
 		m_render_objects.emplace_back(VAO, texture, num_elements, model);
+		addRenderObjectCulling(num_elements);
+		return m_render_objects.size() - 1;
+	}
+
+	/**
+	bounds are in object space, they let the object be occlusion culled
+	*/
+	unsigned int addRenderObject(unsigned int VAO, unsigned int texture, unsigned int num_elements, glm::mat4& model, const AABB& bounds)
+	{
+		m_render_objects.emplace_back(VAO, texture, num_elements, model, bounds);
+		addRenderObjectCulling(num_elements);
+		return m_render_objects.size() - 1;
+	}
+
+	// moves the render object, the motion vectors of the frame after get its last transform
+	void setRenderObjectTransform(unsigned int render_object, const glm::mat4& model)
+	{
+		m_render_objects[render_object].model = model;
+	}
+
+	/**
+	draws a low poly stand in for the render object into the cpu occlusion buffer.
+	positions are in the object's space and triangles must face outwards
+	*/
+	void addOccluder(unsigned int render_object, const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& indices)
+	{
+		m_occluders.push_back({ { positions, indices }, (int)render_object, nullptr });
 	}
 
 	void addModel(Model* model, glm::mat4* transform)
 	{
+		CPU_ZONE("Renderer::addModel");
 		m_models.push_back(model);
 		m_model_transforms.push_back(transform);
+		m_prev_model_transforms.push_back(*transform);
+
+		m_model_mesh_offset.push_back(m_mesh_visible.size());
+		m_mesh_visible.resize(m_mesh_visible.size() + model->meshes.size(), 1);
+
+		m_model_shadow_caster.push_back(m_shadow_casters.size());
+		for (unsigned int i = 0; i < model->meshes.size(); ++i)
+		{
+			m_shadow_atlas->addCaster();
+			m_shadow_casters.push_back({ -1, (int)m_models.size() - 1, i });
+		}
+
+		// big opaque meshes with few triangles are used as occluders
+		for (unsigned int i = 0; i < model->meshes.size(); ++i)
+		{
+			Mesh& mesh = model->meshes[i];
+			if (!m_software_occlusion.isGoodOccluder(mesh.indices.size() / 3, mesh.bounds, mesh.alpha_tested))
+				continue;
+
+			Occluder occluder = { {}, -1, transform };
+			occluder.mesh.positions.reserve(mesh.vertices.size());
+			for (unsigned int j = 0; j < mesh.vertices.size(); ++j)
+				occluder.mesh.positions.push_back(mesh.vertices[j].position);
+			occluder.mesh.indices = mesh.indices;
+			m_occluders.push_back(occluder);
+		}
+
+		// each mesh is culled on its own
+		if (m_hiz_culler)
+		{
+			m_model_cull_index.push_back(m_hiz_culler->numObjects());
+			for (unsigned int i = 0; i < model->meshes.size(); ++i)
+				m_hiz_culler->addObject(model->meshes[i].indices.size());
+		}
+	}
+
+	/**
+	the culler is frustum culled against the camera and drawn every frame with the instancing shader
+	*/
+	void addInstancedModel(InstanceCuller* culler)
+	{
+		m_instanced_models.push_back(culler);
 	}
 	
 	void setDirLight(DirLight* light)
 	{
 		m_dirlight = light;
+		if (light->casts_shadow)
+			light->shadow_view = 0;
+		m_light_buffer->setDirLight(light);
+	}
+
+	/**
+	point and spot lights, as many as needed. the ones that cast shadows get them from
+	the shadow atlas for as long as there's room in it
+	*/
+	void addPointLight(PointLight* light)
+	{
+		m_clustered_lights->addPointLight(light);
+		if (light->casts_shadow)
+			m_shadow_atlas->addLight(light);
 	}
 
-	void setPointLight(PointLight* light)
+	void addSpotLight(SpotLight* light)
 	{
-		m_pointlight = light;
+		m_clustered_lights->addSpotLight(light);
+		if (light->casts_shadow)
+			m_shadow_atlas->addLight(light);
+	}
+
+	/**
+	off, every fragment loops over every light
+	*/
+	void setClusteredShading(bool enabled)
+	{
+		m_clustered_lights->setEnabled(enabled);
+	}
+
+	const ClusterStats& getClusterStats()
+	{
+		return m_clustered_lights->stats;
+	}
+
+	/**
+	texels of shadow map drawn a frame at most, views past it wait for a later frame
+	*/
+	void setShadowBudget(unsigned int texels)
+	{
+		m_shadow_atlas->setBudget(texels);
+	}
+
+	/**
+	draws each point light caster once, instanced for the cube faces it touches, instead of once per face.
+	only has an effect if the vertex shader can choose the layer and viewport
+	*/
+	void setPointShadowInstancing(bool instancing)
+	{
+		m_point_shadow_instancing = instancing && m_point_shadow_shader;
+	}
+
+	bool getPointShadowInstancing()
+	{
+		return m_point_shadow_instancing;
+	}
+
+	DepthStreamStats getDepthStreamStats()
+	{
+		m_depth_stream_stats.shadow_ms = m_shadow_atlas->stats.gpu_ms + m_cascades->stats.gpu_ms;
+		return m_depth_stream_stats;
+	}
+
+	/**
+	VSM and ESM need compute shaders, without them hardware PCF is used instead
+	*/
+	void setShadowFilter(ShadowFilterMode filter)
+	{
+		if ((filter == SHADOW_FILTER_VSM || filter == SHADOW_FILTER_ESM) && !gl_caps.compute)
+		{
+			std::cout << "ERROR::RENDERER:: " << shadowFilterName(filter) << " shadows need compute shaders" << std::endl;
+			filter = SHADOW_FILTER_HARDWARE;
+		}
+		m_shadow_filter = filter;
+		m_cascades->setFilter(filter);
+
+		// programs made later get it in setupProgram
+		auto set_filter = [filter](ShaderProgram& program)
+		{
+			gl_state.useProgram(program.m_ID);
+			program.setInt("shadow_filter", filter);
+		};
+		m_lit_shaders->forEach(set_filter);
+		m_deferred_shaders->forEach(set_filter);
 	}
 
-	void setSpotLight(SpotLight* light)
+	ShadowFilterMode getShadowFilter()
 	{
-		m_spotlight = light;
+		return m_shadow_filter;
+	}
+
+	const ShadowAtlasStats& getShadowStats()
+	{
+		return m_shadow_atlas->stats;
+	}
+
+	// 2 to 4 cascades for the directional light's shadow
+	void setCascadeCount(unsigned int count)
+	{
+		m_cascades->setCascadeCount(count);
+	}
+
+	void setCascadeRenderMode(CascadeRenderMode mode)
+	{
+		m_cascades->mode = mode;
+	}
+
+	const CascadeStats& getCascadeStats()
+	{
+		return m_cascades->stats;
+	}
+
+	const NoiseTexture& getNoiseTexture()
+	{
+		return *m_noise;
+	}
+
+	// warps the diffuse textures of the forward path with the noise texture
+	void setNoiseOffsets(bool enabled)
+	{
+		m_noise_offsets = enabled;
+	}
+
+	bool getNoiseOffsets()
+	{
+		return m_noise_offsets;
+	}
+
+	const ShaderCacheStats& getShaderCacheStats()
+	{
+		return m_shader_cache.stats;
+	}
+
+	ShaderCompileMode getShaderCompileMode()
+	{
+		return m_shader_cache.mode();
+	}
+
+	// a program of whole shader files, loaded from the binary cache when it can be, and owned by the renderer. use waits for it
+	ShaderProgram* loadShader(const std::string& vertex_path, const std::string& fragment_path)
+	{
+		return m_shader_cache.load(vertex_path, fragment_path);
+	}
+
+	// the features the lit programs of the last frame were compiled with, see ShaderFeature
+	unsigned int getFrameFeatures()
+	{
+		return m_frame_features;
 	}
 	
 	void setTexture(unsigned int texture)
@@ -258,6 +641,7 @@ public:
 	{
 		curr_view = view;
 		curr_projection = proj;
+		curr_unjittered_projection = proj;
 	}
 
 	void setCamera(Camera* camera)
@@ -265,19 +649,142 @@ public:
 		m_camera = camera;
 	}
 
-	void updateLightUniforms()
+	/**
+	the framebuffer the scene is drawn into, its depth is used to build the occlusion culling pyramid
+	*/
+	void setSceneFramebuffer(unsigned int fbo)
+	{
+		m_scene_fbo = fbo;
+
+		gl_state.bindFramebuffer(GL_FRAMEBUFFER, fbo);
+		glGetIntegerv(GL_SAMPLES, &m_scene_samples);
+		m_scene_samples = m_scene_samples > 0 ? m_scene_samples : 1;
+		gl_state.bindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+
+	/**
+	the size of the scene framebuffer, the G-buffer and the occlusion culling depth follow it
+	*/
+	void resize(int width, int height)
 	{
-		m_shader->use();
+		CPU_ZONE("Renderer::resize");
+		m_screen_width = width;
+		m_screen_height = height;
+		m_viewport_width = width;
+		m_viewport_height = height;
+
+		m_gbuffer->resize(width, height);
+		if (m_hiz_culler)
+		{
+			m_hiz_culler->resize(width, height);
+			m_hiz_culler->invalidate();
+		}
+	}
 
-		m_dirlight->uniformShader(m_shader, "dirlight");
-		m_pointlight->uniformShader(m_shader, "pointlight");
-		m_spotlight->uniformShader(m_shader, "spotlight");
+	/**
+	the part of the scene framebuffer and the G-buffer the frame is drawn into, from their origin, so it can
+	be drawn at a lower resolution without resizing them. the caller sets the GL viewport to it
+	*/
+	void setViewport(int width, int height)
+	{
+		m_viewport_width = glm::clamp(width, 1, m_screen_width);
+		m_viewport_height = glm::clamp(height, 1, m_screen_height);
+		if (m_hiz_culler)
+			m_hiz_culler->setViewport(m_viewport_width, m_viewport_height);
+	}
+
+	/**
+	both paths light with the same clustered lights, deferred writes the surfaces to a G-buffer first
+	and lights every pixel once, so its cost doesn't depend on overdraw or on how many lights a mesh is near
+	*/
+	void setRenderPath(RenderPath path)
+	{
+		m_render_path = path;
+	}
+
+	RenderPath getRenderPath()
+	{
+		return m_render_path;
+	}
+
+	/**
+	render target traffic is estimated from the samples each pass wrote and the bytes each sample touches
+	*/
+	RenderPathStats getRenderPathStats()
+	{
+		RenderPathStats stats;
+		stats.opaque_ms = m_render_path == RENDER_PATH_DEFERRED ? m_gbuffer_timer->ms() + m_shading_timer->ms() : m_opaque_timer->ms();
+		stats.lighting_ms = m_shading_timer->ms();
+
+		if (m_render_path == RENDER_PATH_DEFERRED)
+		{
+			// geometry writes the G-buffer and tests depth, lighting reads the G-buffer once a pixel
+			// and writes color and depth to every sample of the scene target
+			double pixels = (double)m_viewport_width * m_viewport_height;
+			stats.attachment_bytes = m_gbuffer->writtenSamples() * (double)(GBuffer::bytes_per_pixel + 4)
+				+ pixels * GBuffer::bytes_per_pixel + pixels * m_scene_samples * 8.0;
+		}
+		else
+		{
+			// the pre-pass tests and writes depth, shading tests depth and writes color
+			stats.attachment_bytes = m_depth_prepass->depthSamples() * 8.0 + m_depth_prepass->shadedSamples() * 8.0;
+		}
+		return stats;
+	}
+
+	void setOcclusionCulling(bool enabled)
+	{
+		m_occlusion_culling = enabled;
+		if (m_hiz_culler && !enabled)
+			m_hiz_culler->invalidate();
+	}
+
+	void setSoftwareOcclusionCulling(bool enabled)
+	{
+		m_software_culling = enabled;
+	}
+
+	/**
+	auto runs the pre-pass only while the measured overdraw makes it worth it
+	*/
+	void setDepthPrepassMode(DepthPrepassMode mode)
+	{
+		m_depth_prepass->mode = mode;
+	}
+
+	DepthPrepass* getDepthPrepass()
+	{
+		return m_depth_prepass;
+	}
+
+	const SoftwareOcclusionStats& getSoftwareOcclusionStats()
+	{
+		return m_software_occlusion.stats;
+	}
+
+	/**
+	uploads the directional light if it changed, point and spot lights are uploaded when they're clustered in draw
+	*/
+	void updateLightUniforms()
+	{
+		CPU_ZONE("Renderer::updateLightUniforms");
+		m_light_buffer->update();
 	}
 
 	void updateUniformBuffer(glm::mat4& view, glm::mat4& proj)
 	{
+		updateUniformBuffer(view, proj, proj);
+	}
+	/**
+	proj is what's drawn with, jittered for TAA, and unjittered_proj the camera's own. the lights are
+	assigned to clusters and the cascades fitted with the unjittered one, so a still camera doesn't redo them
+	*/
+	void updateUniformBuffer(glm::mat4& view, glm::mat4& proj, glm::mat4& unjittered_proj)
+	{
+		CPU_ZONE("Renderer::updateUniformBuffer");
 		curr_view = &view;
 		curr_projection = &proj;
+		curr_unjittered_projection = &unjittered_proj;
 
 		// update view and projection uniform buffer
 		glBindBuffer(GL_UNIFORM_BUFFER, m_ubo_matrices);
@@ -286,237 +793,766 @@ public:
 		glBindBuffer(GL_UNIFORM_BUFFER, 0);
 	}
 
-	void draw()
+	/**
+	the G-buffer's textures, for a caller that allocates them itself, like a render graph.
+	the G-buffer's own are freed, and resize leaves it to the caller to set new ones
+	*/
+	void setGBufferTextures(unsigned int albedo, unsigned int normal, unsigned int depth)
 	{
-		// set viewPos uniform for lighting
-		m_shader->use();
-		m_shader->setVec3("viewPos", m_camera->m_Pos);
+		m_gbuffer->setTextures(albedo, normal, depth);
+	}
 
-		if (m_dirlight->casts_shadow)
-		{
-			m_shader->setInt("dirlight.shadow_map", 4);
-			glActiveTexture(GL_TEXTURE0 + 4);
-			glBindTexture(GL_TEXTURE_2D, m_dirlight->shadow_map);
+	void draw()
+	{
+		beginFrame();
+		drawGBuffer();
+		drawScene();
+	}
 
-			glm::mat4 shadow_proj = glm::ortho(-m_shadow_r, m_shadow_r, -m_shadow_r, m_shadow_r, m_shadow_near_plane, m_shadow_far_plane);
+	/**
+	the steps of draw, for a caller that runs them as passes of its own. beginFrame culls and assigns the
+	lights for this frame's view, drawGBuffer draws the deferred path's geometry, and drawScene the rest
+	into the scene framebuffer, or into the bound one for the forward path when none is set
+	*/
+	void beginFrame()
+	{
+		CPU_ZONE("Renderer::beginFrame");
+		m_shader_cache.update();
+		m_frame_features = frameFeatures();
 
-			glm::vec3 eye = glm::vec3(m_dirlight->position);
-			glm::vec3 target = eye + m_dirlight->direction;
-			glm::mat4 shadow_view = glm::lookAt(eye, target, glm::vec3(0.0f, 1.0f, 0.0f));
+		m_shadow_atlas->bind();
+		m_cascades->bind();
 
-			glm::mat4 shadow_space_matrix = shadow_proj * shadow_view;
+		// early occlusion test against the previous frame's depth
+		m_frame_occlusion_culling = m_hiz_culler && m_occlusion_culling && m_scene_fbo;
+		m_frame_view_proj = *curr_projection * *curr_view;
+		m_frame_angle = glfwGetTime();
 
-			unsigned int shadow_space_matrix_loc = m_shader->uniformLoc("shadow_projection");
-			glUniformMatrix4fv(shadow_space_matrix_loc, 1, GL_FALSE, glm::value_ptr(shadow_space_matrix));
-		}
-
-		if (m_pointlight->casts_shadow)
+		updateSoftwareOcclusion(m_frame_view_proj);
+		if (m_frame_occlusion_culling)
 		{
-			m_shader->setInt("pointlight.shadow_map", 5);
-			glActiveTexture(GL_TEXTURE0 + 5);
-			glBindTexture(GL_TEXTURE_CUBE_MAP, m_pointlight->shadow_map);
-
-			//float near = 0.1f;
-			//float far = 25.0f;
-			//glm::mat4 shadow_proj = glm::perspective(glm::radians(90.0f), 1.0f, near, far);
+			updateCullBounds();
+			m_hiz_culler->testEarly(m_frame_view_proj);
+		}
 
-			//std::vector<glm::mat4> shadow_transforms;
-			//shadow_transforms.reserve(6);
-			//shadow_transforms.push_back(shadow_proj * glm::lookAt(m_pointlight->position, m_pointlight->position + glm::vec3(1.0f, 0.0f, 0.0f),  glm::vec3(0.0f, -1.0f, 0.0f)));
-			//shadow_transforms.push_back(shadow_proj * glm::lookAt(m_pointlight->position, m_pointlight->position + glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)));
-			//shadow_transforms.push_back(shadow_proj * glm::lookAt(m_pointlight->position, m_pointlight->position + glm::vec3(0.0f, 1.0f, 0.0f),  glm::vec3(0.0f, 0.0f, 1.0f)));
-			//shadow_transforms.push_back(shadow_proj * glm::lookAt(m_pointlight->position, m_pointlight->position + glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f)));
-			//shadow_transforms.push_back(shadow_proj * glm::lookAt(m_pointlight->position, m_pointlight->position + glm::vec3(0.0f, 0.0f, 1.0f),  glm::vec3(0.0f, -1.0f, 0.0f)));
-			//shadow_transforms.push_back(shadow_proj * glm::lookAt(m_pointlight->position, m_pointlight->position + glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, -1.0f, 0.0f)));
+		// assign the lights to clusters for this view
+		m_clustered_lights->update(*curr_view, *curr_unjittered_projection, m_viewport_width, m_viewport_height);
+		m_clustered_lights->bind();
+	}
 
-			////////glUniformMatrix4fv(glGetUniformLocation(m_point_shadow_shader->m_ID, "shadow_matrices"), 6, GL_FALSE, glm::value_ptr(shadow_transforms[0]));
+	void drawGBuffer()
+	{
+		CPU_ZONE("Renderer::drawGBuffer");
+		if (m_render_path != RENDER_PATH_DEFERRED)
+			return;
 
-			//for (unsigned int i = 0; i < 6; ++i)
-			//{
-			//	std::string name = "shadow_matrices[" + std::to_string(i) + "]";
-			//	unsigned int loc = glGetUniformLocation(m_point_shadow_shader->m_ID, name.c_str());
+		m_gbuffer_timer->begin();
+		drawDeferredGeometry(m_frame_occlusion_culling, m_frame_view_proj);
+		m_gbuffer_timer->end();
+	}
 
-			//	glUniformMatrix4fv(loc, 1, GL_FALSE, glm::value_ptr(shadow_transforms[i]));
-			//}
-		}
+	void drawScene()
+	{
+		CPU_ZONE("Renderer::drawScene");
 
-		if (m_spotlight->casts_shadow)
-		{
-			m_shader->setInt("spotlight.shadow_map", 6);
-			glActiveTexture(GL_TEXTURE0 + 6);
-			glBindTexture(GL_TEXTURE_2D, m_spotlight->shadow_map);
-		}
-		
+		// the G-buffer's framebuffer is still bound
+		if (m_render_path == RENDER_PATH_DEFERRED)
+			gl_state.bindFramebuffer(GL_FRAMEBUFFER, m_scene_fbo);
 
 		// skybox rendering
-		glDisable(GL_DEPTH_TEST);
+		gl_state.disable(GL_DEPTH_TEST);
 		{
+			GpuScope scope(m_profiler, "skybox");
 			m_skybox_shader->use();
 
-			glBindVertexArray(m_cubemap_VAO);
-			glActiveTexture(GL_TEXTURE0);
-			glBindTexture(GL_TEXTURE_CUBE_MAP, m_cubemap_texture); //m_cubemap_texture
+			gl_state.bindVertexArray(m_cubemap_VAO);
+			gl_state.bindTexture(0, GL_TEXTURE_CUBE_MAP, m_cubemap_texture); //m_cubemap_texture
 			glDrawArrays(GL_TRIANGLES, 0, 36);
 		}
-		glEnable(GL_DEPTH_TEST);
+		gl_state.enable(GL_DEPTH_TEST);
 
-		m_shader->use();
-		// render all VAOs
-		glActiveTexture(GL_TEXTURE0);
-		for (unsigned int i = 0; i < m_render_objects.size(); ++i)
+		if (m_render_path == RENDER_PATH_DEFERRED)
 		{
-			RenderObject ro = m_render_objects[i];
-			ro.setModelUniform(m_shader);
-			glBindVertexArray(ro.VAO);
+			GpuScope scope(m_profiler, "lighting");
+			drawDeferredLighting(m_frame_view_proj);
+		}
+		else
+		{
+			GpuScope scope(m_profiler, "forward");
+			m_opaque_timer->begin();
+			drawForward(m_frame_occlusion_culling, m_frame_view_proj);
+			m_opaque_timer->end();
+		}
 
-			glBindTexture(GL_TEXTURE_2D, ro.texture);
+		// render all lights
+		GpuScope scope(m_profiler, "light markers");
+		m_light_shader->use();
+		gl_state.bindVertexArray(m_light_VAO);
+		const std::vector<PointLight*>& point_lights = m_clustered_lights->pointLights();
+		for (unsigned int i = 0; i < point_lights.size(); ++i)
+			drawLightMarker(point_lights[i]->color, point_lights[i]->position);
+
+		const std::vector<SpotLight*>& spot_lights = m_clustered_lights->spotLights();
+		for (unsigned int i = 0; i < spot_lights.size(); ++i)
+			drawLightMarker(spot_lights[i]->color, spot_lights[i]->position);
+	}
 
+	/**
+	motion vectors of what moved since the last frame apart from the camera, into the bound framebuffer,
+	which should have the scene's depth and a two channel float color. each pixel gets how far its surface
+	moved in uv on the last frame's screen, everything else is cleared to 0, and the camera's own motion is
+	left to whoever reads it to get from the depth. the objects are tested against the depth and don't write
+	it, so only what's visible is drawn. call it after drawScene, then endFrame once the frame is done
+	*/
+	void drawVelocity()
+	{
+		CPU_ZONE("Renderer::drawVelocity");
+		m_velocity_stats.objects = 0;
+		m_velocity_stats.instanced = 0;
+		m_velocity_timer->begin();
+
+		glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+		glClear(GL_COLOR_BUFFER_BIT);
+		gl_state.disable(GL_BLEND);
+		gl_state.depthFunc(GL_LEQUAL);
+		gl_state.depthMask(false);
+
+		// render objects are drawn with the alpha tested program, like in drawRenderObjects
+		ShaderProgram* cutout_shader = useVelocityProgram(SHADER_ALPHA_TEST);
+		for (unsigned int i = 0; cutout_shader && i < m_render_objects.size(); ++i)
+		{
+			RenderObject& ro = m_render_objects[i];
+			if (!m_render_object_visible[i] || ro.model == ro.prev_model)
+				continue;
+			cutout_shader->setMat4("model", ro.model);
+			cutout_shader->setMat4("prev_model", ro.prev_model);
+			gl_state.bindVertexArray(ro.VAO);
+			gl_state.bindTexture(0, GL_TEXTURE_2D, ro.texture);
 			glDrawElements(GL_TRIANGLES, ro.num_elements, GL_UNSIGNED_INT, 0);
+			++m_velocity_stats.objects;
 		}
 
-		// render all models
-		for (unsigned int i = 0; i < m_models.size(); ++i)
+		for (unsigned int pass = 0; pass < 2; ++pass)
 		{
-			glUniformMatrix4fv(m_model_loc, 1, GL_FALSE, glm::value_ptr(*m_model_transforms[i]));
+			bool alpha_tested = pass == 1;
+			ShaderProgram* shader = useVelocityProgram(alpha_tested ? SHADER_ALPHA_TEST : 0);
+			for (unsigned int i = 0; shader && i < m_models.size(); ++i)
+			{
+				if (*m_model_transforms[i] == m_prev_model_transforms[i])
+					continue;
+				shader->setMat4("model", *m_model_transforms[i]);
+				shader->setMat4("prev_model", m_prev_model_transforms[i]);
+				for (unsigned int j = 0; j < m_models[i]->meshes.size(); ++j)
+				{
+					Mesh& mesh = m_models[i]->meshes[j];
+					if (mesh.alpha_tested != alpha_tested || !m_mesh_visible[m_model_mesh_offset[i] + j])
+						continue;
+					if (alpha_tested)
+						mesh.DrawCutout();
+					else
+						mesh.DrawDepth();
+					++m_velocity_stats.objects;
+				}
+			}
+		}
 
-			m_models[i]->Draw(*m_shader);
+		// the instances don't move, but their vertices sway with the time, they're drawn as they were culled for this frame
+		for (unsigned int i = 0; i < m_instanced_models.size(); ++i)
+		{
+			ShaderProgram* shader = useVelocityProgram(instancedFeatures(*m_instanced_models[i]->model));
+			if (!shader)
+				continue;
+			m_instanced_models[i]->draw();
+			++m_velocity_stats.instanced;
 		}
 
-		// render all lights
-		m_light_shader->use();
-		glBindVertexArray(m_light_VAO);
+		gl_state.depthMask(true);
+		gl_state.depthFunc(GL_LESS);
+		gl_state.enable(GL_BLEND);
+
+		m_velocity_timer->end();
+		m_velocity_stats.ms = m_velocity_timer->ms();
+	}
+
+	const VelocityStats& getVelocityStats()
+	{
+		return m_velocity_stats;
+	}
+
+	// times the steps of the frame as scopes of the profiler's, inside whichever is open when they're drawn
+	void setProfiler(GpuProfiler* profiler)
+	{
+		m_profiler = profiler;
+	}
+
+	// keeps what this frame was drawn with, the motion vectors of the next one are from it
+	void endFrame()
+	{
+		CPU_ZONE("Renderer::endFrame");
+		m_prev_view_proj = m_frame_view_proj;
+		m_prev_angle = m_frame_angle;
+		for (RenderObject& ro : m_render_objects)
+			ro.prev_model = ro.model;
+		for (unsigned int i = 0; i < m_models.size(); ++i)
+			m_prev_model_transforms[i] = *m_model_transforms[i];
+	}
+
+	/**
+	draws the opaque geometry with the lighting shader, after a depth pre-pass if it pays off
+	*/
+	void drawForward(bool occlusion_culling, const glm::mat4& view_proj)
+	{
+		CPU_ZONE("Renderer::drawForward");
+
+		// depth pre-pass, the opaque geometry is then shaded only where it's visible
+		bool prepass = m_depth_prepass->beginFrame();
+		if (prepass)
 		{
-			m_light_shader->setVec3("lightColor", m_pointlight->color);
+			GpuScope scope(m_profiler, "depth pre-pass");
+			gl_state.colorMask(false);
 
-			glm::mat4 model = glm::mat4(1.0f);
-			model = glm::translate(model, m_pointlight->position);
+			m_depth_prepass->beginDepthQuery();
+			drawRenderObjects(m_depth_shaders->get(SHADER_ALPHA_TEST), occlusion_culling);
+			drawModelsDepth(occlusion_culling);
+			m_depth_prepass->endDepthQuery();
 
-			glUniformMatrix4fv(m_light_model_loc, 1, GL_FALSE, glm::value_ptr(model));
+			gl_state.colorMask(true);
+			gl_state.depthFunc(GL_EQUAL);
+			gl_state.depthMask(false);
+		}
 
-			glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+		ShaderProgram* opaque_shader = useLitProgram(m_frame_features);
+		ShaderProgram* cutout_shader = useLitProgram(m_frame_features | SHADER_ALPHA_TEST);
+		m_shading_timer->begin();
+		m_depth_prepass->beginShadeQuery();
+		{
+			GpuScope scope(m_profiler, "objects");
+			drawRenderObjects(cutout_shader, occlusion_culling);
+		}
+		{
+			GpuScope scope(m_profiler, "models");
+			drawModels(opaque_shader, cutout_shader, occlusion_culling);
 		}
+		m_depth_prepass->endShadeQuery();
+		m_shading_timer->end();
 
+		if (prepass)
 		{
-			m_light_shader->setVec3("lightColor", m_spotlight->color);
+			gl_state.depthFunc(GL_LESS);
+			gl_state.depthMask(true);
+		}
+		m_depth_prepass->endFrame();
 
-			glm::mat4 model = glm::mat4(1.0f);
-			model = glm::translate(model, m_spotlight->position);
+		// render all instanced models
+		if (!m_instanced_models.empty())
+		{
+			GpuScope scope(m_profiler, "instanced models");
+			for (unsigned int i = 0; i < m_instanced_models.size(); ++i)
+				m_instanced_models[i]->cull(view_proj, m_camera->m_Pos);
+
+			for (unsigned int i = 0; i < m_instanced_models.size(); ++i)
+			{
+				ShaderProgram* shader = useLitProgram(m_frame_features | instancedFeatures(*m_instanced_models[i]->model));
+				if (!shader)
+					continue;
+				shader->setFloat("angle", m_frame_angle);
+				m_instanced_models[i]->draw();
+			}
+		}
 
-			glUniformMatrix4fv(m_light_model_loc, 1, GL_FALSE, glm::value_ptr(model));
+		// late occlusion test, draws whatever became visible against this frame's depth
+		if (occlusion_culling)
+		{
+			GpuScope scope(m_profiler, "late occlusion");
+			m_hiz_culler->buildPyramid(m_scene_fbo, view_proj);
+			m_hiz_culler->testLate(view_proj);
 
-			glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+			drawRenderObjects(cutout_shader, true);
+			drawModels(opaque_shader, cutout_shader, true);
 		}
 	}
 
-	void drawDirectionalShadow()
+	/**
+	writes the opaque geometry to the G-buffer, drawDeferredLighting then lights it with one fullscreen
+	pass into the scene framebuffer, which also gets the depth so everything after is tested against it
+	*/
+	void drawDeferredGeometry(bool occlusion_culling, const glm::mat4& view_proj)
 	{
-		m_shadow_shader->use();
+		CPU_ZONE("Renderer::drawDeferredGeometry");
+		gl_state.bindFramebuffer(GL_FRAMEBUFFER, m_gbuffer->fbo);
+		glClear(GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
 
-		glm::mat4 shadow_proj = glm::ortho(-m_shadow_r, m_shadow_r, -m_shadow_r, m_shadow_r, m_shadow_near_plane, m_shadow_far_plane);
+		// the G-buffer's alpha channels hold data, not coverage
+		gl_state.disable(GL_BLEND);
 
-		glm::vec3 eye = glm::vec3(0.0f, 0.0f, 0.0f);
-		glm::vec3 target = eye + m_dirlight->direction;
-		glm::mat4 shadow_view = glm::lookAt(eye, target, glm::vec3(0.0f, 1.0f, 0.0f));
+		m_gbuffer->beginQuery();
+		// nothing can stand in for a G-buffer program, its draws wait for it
+		ShaderProgram* opaque_shader = m_gbuffer_shaders->getReady(0, 0);
+		ShaderProgram* cutout_shader = m_gbuffer_shaders->getReady(SHADER_ALPHA_TEST, SHADER_ALPHA_TEST);
+		{
+			GpuScope scope(m_profiler, "objects");
+			drawRenderObjects(cutout_shader, occlusion_culling);
+		}
+		{
+			GpuScope scope(m_profiler, "models");
+			drawModels(opaque_shader, cutout_shader, occlusion_culling);
+		}
 
-		glm::mat4 shadow_space_matrix = shadow_proj * shadow_view;
+		if (!m_instanced_models.empty())
+		{
+			GpuScope scope(m_profiler, "instanced models");
+			for (unsigned int i = 0; i < m_instanced_models.size(); ++i)
+				m_instanced_models[i]->cull(view_proj, m_camera->m_Pos);
+
+			for (unsigned int i = 0; i < m_instanced_models.size(); ++i)
+			{
+				unsigned int features = instancedFeatures(*m_instanced_models[i]->model);
+				ShaderProgram* shader = m_gbuffer_shaders->getReady(features, features);
+				if (!shader)
+					continue;
+				gl_state.useProgram(shader->m_ID);
+				shader->setFloat("angle", m_frame_angle);
+				m_instanced_models[i]->draw();
+			}
+		}
 
-		glUniformMatrix4fv(m_shadow_matrix_loc_shadow, 1, GL_FALSE, glm::value_ptr(shadow_space_matrix));
+		// late occlusion test against the G-buffer's depth
+		if (occlusion_culling)
+		{
+			GpuScope scope(m_profiler, "late occlusion");
+			m_hiz_culler->buildPyramid(m_gbuffer->fbo, view_proj);
+			m_hiz_culler->testLate(view_proj);
 
-		// render all VAOs
-		for (unsigned int i = 0; i < m_render_objects.size(); ++i)
+			drawRenderObjects(cutout_shader, true);
+			drawModels(opaque_shader, cutout_shader, true);
+		}
+		m_gbuffer->endQuery();
+
+		gl_state.enable(GL_BLEND);
+	}
+
+	void drawDeferredLighting(const glm::mat4& view_proj)
+	{
+		CPU_ZONE("Renderer::drawDeferredLighting");
+		gl_state.bindFramebuffer(GL_FRAMEBUFFER, m_scene_fbo);
+		ShaderProgram* deferred_shader = m_deferred_shaders->getReady(m_frame_features, SHADER_LIGHTING);
+		m_shading_timer->begin();
+		if (deferred_shader)
 		{
-			RenderObject ro = m_render_objects[i];
-			glUniformMatrix4fv(m_shadow_model_loc, 1, GL_FALSE, glm::value_ptr(ro.model));
-			glBindVertexArray(ro.VAO);
+			gl_state.useProgram(deferred_shader->m_ID);
+			deferred_shader->setVec3("viewPos", m_camera->m_Pos);
+			glm::mat4 inv_view_proj = glm::inverse(view_proj);
+			glUniformMatrix4fv(deferred_shader->uniformLoc("inv_view_projection"), 1, GL_FALSE, glm::value_ptr(inv_view_proj));
+			deferred_shader->setVec2("viewport_size", glm::vec2(m_viewport_width, m_viewport_height));
+			m_gbuffer->bindTextures();
+
+			gl_state.depthFunc(GL_ALWAYS);
+			gl_state.bindVertexArray(m_fullscreen_VAO);
+			glDrawArrays(GL_TRIANGLES, 0, 3);
+			gl_state.depthFunc(GL_LESS);
+		}
+		m_shading_timer->end();
+	}
 
-			glDrawElements(GL_TRIANGLES, ro.num_elements, GL_UNSIGNED_INT, 0);
+	/**
+	the lighting features every lit program of this frame needs, from the lights that are in it
+	*/
+	unsigned int frameFeatures()
+	{
+		unsigned int features = m_noise_offsets ? SHADER_NOISE_OFFSETS : 0;
+		if (m_dirlight)
+		{
+			features |= SHADER_DIR_LIGHT;
+			if (m_dirlight->shadow_view >= 0)
+				features |= SHADER_DIR_SHADOWS;
 		}
 
-		// render all models
-		for (unsigned int i = 0; i < m_models.size(); ++i)
+		const std::vector<PointLight*>& point_lights = m_clustered_lights->pointLights();
+		for (unsigned int i = 0; i < point_lights.size(); ++i)
+		{
+			features |= SHADER_POINT_LIGHTS;
+			if (point_lights[i]->shadow_view >= 0)
+				features |= SHADER_POINT_SHADOWS;
+		}
+		const std::vector<SpotLight*>& spot_lights = m_clustered_lights->spotLights();
+		for (unsigned int i = 0; i < spot_lights.size(); ++i)
 		{
-			glUniformMatrix4fv(m_shadow_model_loc, 1, GL_FALSE, glm::value_ptr(*m_model_transforms[i]));
+			features |= SHADER_SPOT_LIGHTS;
+			if (spot_lights[i]->shadow_view >= 0)
+				features |= SHADER_SPOT_SHADOWS;
+		}
+		return features;
+	}
 
-			m_models[i]->Draw(*m_shader);
+	// instanced models are drawn with one program for all of their meshes
+	unsigned int instancedFeatures(const Model& model)
+	{
+		for (unsigned int i = 0; i < model.meshes.size(); ++i)
+		{
+			if (model.meshes[i].alpha_tested)
+				return SHADER_INSTANCED | SHADER_ALPHA_TEST;
 		}
+		return SHADER_INSTANCED;
 	}
 
-	void drawPointShadow()
+	/**
+	while the program of the features compiles, the one with every lighting feature and no noise
+	offsets stands in for it, it lights the same only slower. nullptr if that isn't ready either
+	*/
+	ShaderProgram* useLitProgram(unsigned int features)
 	{
-		m_point_shadow_shader->use();
+		ShaderProgram* shader = m_lit_shaders->getReady(features, (features & (SHADER_INSTANCED | SHADER_ALPHA_TEST)) | SHADER_LIGHTING);
+		if (!shader)
+			return nullptr;
+		gl_state.useProgram(shader->m_ID);
+		shader->setVec3("viewPos", m_camera->m_Pos);
+		return shader;
+	}
 
-		float near = 0.1f;
-		float far = 25.0f;
-		glm::mat4 shadow_proj = glm::perspective(glm::radians(90.0f), 1.0f, near, far);
+	// nothing stands in for a velocity program, what it would draw keeps the camera's motion until it's ready
+	ShaderProgram* useVelocityProgram(unsigned int features)
+	{
+		ShaderProgram* shader = m_velocity_shaders->getReady(features, features);
+		if (!shader)
+			return nullptr;
+		gl_state.useProgram(shader->m_ID);
+		shader->setMat4("prev_view_projection", m_prev_view_proj);
+		shader->setFloat("angle", m_frame_angle);
+		shader->setFloat("prev_angle", m_prev_angle);
+		return shader;
+	}
 
-		std::vector<glm::mat4> shadow_transforms;
-		shadow_transforms.reserve(6);
-		glm::vec3 pos = m_pointlight->position;
-		shadow_transforms.push_back(shadow_proj * glm::lookAt(pos, pos + glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)));
-		shadow_transforms.push_back(shadow_proj * glm::lookAt(pos, pos + glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)));
-		shadow_transforms.push_back(shadow_proj * glm::lookAt(pos, pos + glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f)));
-		shadow_transforms.push_back(shadow_proj * glm::lookAt(pos, pos + glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f)));
-		shadow_transforms.push_back(shadow_proj * glm::lookAt(pos, pos + glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, -1.0f, 0.0f)));
-		shadow_transforms.push_back(shadow_proj * glm::lookAt(pos, pos + glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, -1.0f, 0.0f)));
+	/**
+	queues every program up front, the fixed ones and, when they're made in the background, the variants
+	that stand in for the others while those compile. setup runs when each is linked
+	*/
+	void loadPrograms()
+	{
+		CPU_ZONE("Renderer::loadPrograms");
 
-		for (unsigned int i = 0; i < 6; ++i)
+		// optional, could use binding = 0 in shader
+		auto bind_matrices = [](ShaderProgram& program)
+		{
+			glUniformBlockBinding(program.m_ID, glGetUniformBlockIndex(program.m_ID, "Matrices"), 0);
+		};
+		m_outline_shader = m_shader_cache.load("shaders/Vertex.shader", "shaders/OutlineFragment.shader", "", [this, bind_matrices](ShaderProgram& program)
+		{
+			bind_matrices(program);
+			// sampler units never change, so they're set once here instead of every draw
+			setMaterialSamplers(program);
+			m_outline_model_loc = program.uniformLoc("model");
+		});
+		m_light_shader = m_shader_cache.load("shaders/LightVertex.shader", "shaders/LightFragment.shader", "", [this, bind_matrices](ShaderProgram& program)
+		{
+			bind_matrices(program);
+			m_light_model_loc = program.uniformLoc("model");
+		});
+		m_skybox_shader = m_shader_cache.load("shaders/SkyboxVertex.shader", "shaders/SkyboxFragment.shader", "", bind_matrices);
+		m_shadow_shader = m_shader_cache.load("shaders/ShadowVertex.shader", "shaders/ShadowFragment.shader", "", [this](ShaderProgram& program)
 		{
-			std::string name = "shadow_matrices[" + std::to_string(i) + "]";
+			m_shadow_model_loc = program.uniformLoc("model");
+			m_shadow_matrix_loc_shadow = program.uniformLoc("shadowSpaceMatrix");
+		});
+		m_cascade_shadow_shader = m_shader_cache.load("shaders/CascadeShadowVertex.shader", "shaders/ShadowFragment.shader",
+			"shaders/CascadeShadowGeometry.shader", [this](ShaderProgram& program)
+		{
+			m_cascades->bindToProgram(program.m_ID);
+			m_cascade_shadow_model_loc = program.uniformLoc("model");
+		});
+		if (gl_caps.vertex_layer)
+		{
+			m_point_shadow_shader = m_shader_cache.load("shaders/PointShadowVertex.shader", "shaders/ShadowFragment.shader", "", [this](ShaderProgram& program)
+			{
+				m_shadow_atlas->bindToProgram(program.m_ID);
+				m_point_shadow_model_loc = program.uniformLoc("model");
+				m_point_shadow_first_view_loc = program.uniformLoc("first_view");
+				m_point_shadow_faces_loc = program.uniformLoc("faces");
+			});
+		}
 
-			//m_point_shadow_shader->setMat4(name, shadow_transforms[i]);
-			glUniformMatrix4fv(m_shadow_matrix_loc_point_shadow + i, 1, GL_FALSE, glm::value_ptr(shadow_transforms[i]));
+		auto setup = [this](ShaderProgram& program) { setupProgram(program); };
+		m_lit_shaders = new ShaderVariants(m_shader_cache, "shaders/Vertex.shader", "shaders/Fragment.shader",
+			SHADER_LIGHTING | SHADER_INSTANCED | SHADER_ALPHA_TEST | SHADER_NOISE_OFFSETS, setup);
+		m_gbuffer_shaders = new ShaderVariants(m_shader_cache, "shaders/Vertex.shader", "shaders/GBufferFragment.shader",
+			SHADER_INSTANCED | SHADER_ALPHA_TEST, setup);
+		m_deferred_shaders = new ShaderVariants(m_shader_cache, "shaders/DeferredLightingVertex.shader", "shaders/DeferredLightingFragment.shader",
+			SHADER_LIGHTING, setup);
+		m_depth_shaders = new ShaderVariants(m_shader_cache, "shaders/DepthVertex.shader", "shaders/DepthFragment.shader",
+			SHADER_ALPHA_TEST, setup);
+		m_velocity_shaders = new ShaderVariants(m_shader_cache, "shaders/VelocityVertex.shader", "shaders/VelocityFragment.shader",
+			SHADER_INSTANCED | SHADER_ALPHA_TEST, setup);
+		setShadowFilter(SHADOW_FILTER_HARDWARE);
+
+		// compiling them all would only delay the first frame when every compile blocks, the rest are compiled when they're first drawn with
+		if (m_shader_cache.mode() == SHADER_COMPILE_BLOCKING)
+			return;
+		for (unsigned int features : { 0u, (unsigned int)SHADER_ALPHA_TEST, (unsigned int)SHADER_INSTANCED, (unsigned int)(SHADER_INSTANCED | SHADER_ALPHA_TEST) })
+		{
+			m_lit_shaders->get(features | SHADER_LIGHTING);
+			m_gbuffer_shaders->get(features);
 		}
+		m_deferred_shaders->get(SHADER_LIGHTING);
+		m_depth_shaders->get(0);
+		m_depth_shaders->get(SHADER_ALPHA_TEST);
+	}
 
-		glUniform3f(m_point_shadow_lightpos_loc, pos.x, pos.y, pos.z);
+	/**
+	binds a new program to the uniform blocks and points its samplers at their units,
+	programs that don't use some of them are left as they are
+	*/
+	void setupProgram(ShaderProgram& program)
+	{
+		m_light_buffer->bindToProgram(program.m_ID);
+		m_clustered_lights->bindToProgram(program.m_ID);
+		m_shadow_atlas->bindToProgram(program.m_ID);
+		m_cascades->bindToProgram(program.m_ID);
+
+		setMaterialSamplers(program);
+		program.setInt("g_albedo_specular", GBuffer::albedo_unit);
+		program.setInt("g_normal_shininess", GBuffer::normal_unit);
+		program.setInt("g_depth", GBuffer::depth_unit);
+		program.setInt("noise_texture", NoiseTexture::texture_unit);
+		program.setFloat("noise_period", (float)m_noise->settings.period);
+		program.setInt("shadow_filter", m_shadow_filter);
+	}
 
-		glUniform1f(m_point_shadow_farplane_loc, 25.0f);
+	/**
+	draws the render objects with the given shader, with indirect set each object
+	is drawn with the instance count the occlusion culling pass wrote for it.
+	their textures aren't checked for cut outs, so the shader should alpha test
+	*/
+	void drawRenderObjects(ShaderProgram* shader, bool indirect)
+	{
+		if (!shader)
+			return;
+		shader->use();
+		if (indirect)
+			m_hiz_culler->bindCommands();
 
-		// render all VAOs
 		for (unsigned int i = 0; i < m_render_objects.size(); ++i)
 		{
-			RenderObject ro = m_render_objects[i];
-			glUniformMatrix4fv(m_point_shadow_model_loc, 1, GL_FALSE, glm::value_ptr(ro.model));
-			glBindVertexArray(ro.VAO);
+			if (!m_render_object_visible[i])
+				continue;
 
-			glDrawElements(GL_TRIANGLES, ro.num_elements, GL_UNSIGNED_INT, 0);
+			RenderObject& ro = m_render_objects[i];
+			ro.setModelUniform(shader);
+			gl_state.bindVertexArray(ro.VAO);
+
+			gl_state.bindTexture(0, GL_TEXTURE_2D, ro.texture);
+
+			if (indirect)
+				glDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)(std::size_t)m_hiz_culler->commandOffset(m_render_object_cull_index[i]));
+			else
+				glDrawElements(GL_TRIANGLES, ro.num_elements, GL_UNSIGNED_INT, 0);
 		}
 
-		// render all models
-		for (unsigned int i = 0; i < m_models.size(); ++i)
+		if (indirect)
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	}
+
+	/**
+	draws the meshes without cut outs with opaque_shader first, then the alpha tested ones
+	with cutout_shader, so the discard is only paid for where it's needed
+	*/
+	void drawModels(ShaderProgram* opaque_shader, ShaderProgram* cutout_shader, bool indirect)
+	{
+		if (indirect)
+			m_hiz_culler->bindCommands();
+
+		ShaderProgram* shaders[2] = { opaque_shader, cutout_shader };
+		for (unsigned int pass = 0; pass < 2; ++pass)
 		{
-			glUniformMatrix4fv(m_point_shadow_model_loc, 1, GL_FALSE, glm::value_ptr(*m_model_transforms[i]));
+			bool alpha_tested = pass == 1;
+			ShaderProgram* shader = shaders[pass];
+			if (!shader)
+				continue;
+			shader->use();
+			unsigned int model_loc = shader->uniformLoc("model");
+
+			for (unsigned int i = 0; i < m_models.size(); ++i)
+			{
+				bool transform_set = false;
+				for (unsigned int j = 0; j < m_models[i]->meshes.size(); ++j)
+				{
+					Mesh& mesh = m_models[i]->meshes[j];
+					if (mesh.alpha_tested != alpha_tested || !m_mesh_visible[m_model_mesh_offset[i] + j])
+						continue;
+
+					if (!transform_set)
+					{
+						glUniformMatrix4fv(model_loc, 1, GL_FALSE, glm::value_ptr(*m_model_transforms[i]));
+						transform_set = true;
+					}
+
+					if (indirect)
+						mesh.DrawIndirect(m_hiz_culler->commandOffset(m_model_cull_index[i] + j));
+					else
+						mesh.Draw();
+				}
+			}
+		}
+
+		if (indirect)
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	}
+
+	/**
+	the pre-pass of the models, meshes without cut outs read only their positions and
+	the alpha tested ones positions and uvs, with a program that discards like the shading pass
+	*/
+	void drawModelsDepth(bool indirect)
+	{
+		m_depth_stream_stats.prepass_bytes = 0.0;
+		m_depth_stream_stats.prepass_interleaved_bytes = 0.0;
+
+		if (indirect)
+			m_hiz_culler->bindCommands();
 
-			m_models[i]->Draw(*m_shader);
+		ShaderProgram* shaders[2] = { m_depth_shaders->get(0), m_depth_shaders->get(SHADER_ALPHA_TEST) };
+		for (unsigned int pass = 0; pass < 2; ++pass)
+		{
+			bool alpha_tested = pass == 1;
+			shaders[pass]->use();
+			unsigned int model_loc = shaders[pass]->uniformLoc("model");
+
+			for (unsigned int i = 0; i < m_models.size(); ++i)
+			{
+				bool transform_set = false;
+				for (unsigned int j = 0; j < m_models[i]->meshes.size(); ++j)
+				{
+					Mesh& mesh = m_models[i]->meshes[j];
+					if (mesh.alpha_tested != alpha_tested || !m_mesh_visible[m_model_mesh_offset[i] + j])
+						continue;
+
+					if (!transform_set)
+					{
+						glUniformMatrix4fv(model_loc, 1, GL_FALSE, glm::value_ptr(*m_model_transforms[i]));
+						transform_set = true;
+					}
+
+					if (indirect && alpha_tested)
+						mesh.DrawCutoutIndirect(m_hiz_culler->commandOffset(m_model_cull_index[i] + j));
+					else if (indirect)
+						mesh.DrawDepthIndirect(m_hiz_culler->commandOffset(m_model_cull_index[i] + j));
+					else if (alpha_tested)
+						mesh.DrawCutout();
+					else
+						mesh.DrawDepth();
+
+					m_depth_stream_stats.prepass_bytes += (double)mesh.vertices.size() * (alpha_tested ? Mesh::cutout_stride : Mesh::position_stride);
+					m_depth_stream_stats.prepass_interleaved_bytes += (double)mesh.vertices.size() * sizeof(Vertex);
+				}
+			}
 		}
+
+		if (indirect)
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
 	}
-	int shadow_renders = 0;
+
+	/**
+	brings the shadow atlas up to date, only the views whose light or nearby casters changed are drawn,
+	then fits the directional light's cascades to the camera. call it after updateUniformBuffer
+	*/
 	void drawShadows()
 	{
-		if (m_dirlight->casts_shadow)
+		CPU_ZONE("Renderer::drawShadows");
+		m_shadow_caster_bounds.resize(m_shadow_casters.size());
+		for (unsigned int i = 0; i < m_render_objects.size(); ++i)
+			m_shadow_caster_bounds[m_render_object_shadow_caster[i]] = m_render_objects[i].worldBounds();
+
+		for (unsigned int i = 0; i < m_models.size(); ++i)
 		{
-			glCullFace(GL_FRONT);
-			glEnable(GL_DEPTH_TEST);
-			glViewport(0, 0, DirLight::shadow_width, DirLight::shadow_height);
-			glBindFramebuffer(GL_FRAMEBUFFER, m_dirlight->shadow_fbo);
-			glClear(GL_DEPTH_BUFFER_BIT);
+			for (unsigned int j = 0; j < m_models[i]->meshes.size(); ++j)
+				m_shadow_caster_bounds[m_model_shadow_caster[i] + j] = m_models[i]->meshes[j].bounds.transform(*m_model_transforms[i]);
+		}
+		for (unsigned int i = 0; i < m_shadow_caster_bounds.size(); ++i)
+			m_shadow_atlas->setCasterBounds(i, m_shadow_caster_bounds[i]);
+
+		m_depth_stream_stats.shadow_bytes = 0.0;
+		m_depth_stream_stats.shadow_interleaved_bytes = 0.0;
 
-			drawDirectionalShadow();
+		gl_state.cullFace(GL_FRONT);
+		gl_state.enable(GL_DEPTH_TEST);
 
-			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		ShadowAtlas::DrawCasters draw_casters = [this](const glm::mat4& view_proj, const std::vector<unsigned int>& casters)
+		{
+			m_shadow_shader->use();
+			glUniformMatrix4fv(m_shadow_matrix_loc_shadow, 1, GL_FALSE, glm::value_ptr(view_proj));
+			drawShadowCasters(m_shadow_model_loc, casters);
+		};
+		ShadowAtlas::DrawFaces draw_faces = nullptr;
+		if (m_point_shadow_instancing)
+		{
+			draw_faces = [this](unsigned int first_view, const std::vector<unsigned int>& casters, const std::vector<unsigned int>& face_masks)
+			{
+				m_point_shadow_shader->use();
+				glUniform1i(m_point_shadow_first_view_loc, first_view);
+				drawPointShadowCasters(casters, face_masks);
+			};
+		}
+		{
+			GpuScope scope(m_profiler, "shadow atlas");
+			m_shadow_atlas->update(m_camera->m_Pos, draw_casters, draw_faces);
 		}
 
-		if (m_pointlight->casts_shadow)
+		if (m_dirlight && m_dirlight->casts_shadow)
 		{
-			glCullFace(GL_FRONT);
-			glEnable(GL_DEPTH_TEST);
-			glViewport(0, 0, 1024, 1024);
-			glBindFramebuffer(GL_FRAMEBUFFER, m_pointlight->shadow_fbo);
-			glClear(GL_DEPTH_BUFFER_BIT);
+			GpuScope scope(m_profiler, "cascades");
+			if (m_cascades->update(*curr_view, *curr_unjittered_projection, m_dirlight, m_shadow_atlas->castersChanged()))
+				drawCascades();
+			m_cascades->updateMoments();
+		}
 
-			drawPointShadow();
+		gl_state.cullFace(GL_BACK);
+		gl_state.bindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
 
-			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	/**
+	draws the casters into every cascade, in one layered pass or in a pass for each cascade
+	*/
+	void drawCascades()
+	{
+		CPU_ZONE("Renderer::drawCascades");
+		m_cascades->beginFrame();
+		if (m_cascades->mode == CASCADE_RENDER_LAYERED)
+		{
+			m_cascade_casters.clear();
+			for (unsigned int i = 0; i < m_shadow_caster_bounds.size(); ++i)
+			{
+				for (unsigned int j = 0; j < m_cascades->cascadeCount(); ++j)
+				{
+					if (m_cascades->frustum(j).intersectsAABB(m_shadow_caster_bounds[i]))
+					{
+						m_cascade_casters.push_back(i);
+						break;
+					}
+				}
+			}
+
+			m_cascades->beginLayered();
+			m_cascade_shadow_shader->use();
+			drawShadowCasters(m_cascade_shadow_model_loc, m_cascade_casters);
+			m_cascades->stats.casters_submitted += m_cascade_casters.size();
+		}
+		else
+		{
+			m_shadow_shader->use();
+			for (unsigned int i = 0; i < m_cascades->cascadeCount(); ++i)
+			{
+				m_cascade_casters.clear();
+				for (unsigned int j = 0; j < m_shadow_caster_bounds.size(); ++j)
+				{
+					if (m_cascades->frustum(i).intersectsAABB(m_shadow_caster_bounds[j]))
+						m_cascade_casters.push_back(j);
+				}
+
+				m_cascades->beginCascade(i);
+				glUniformMatrix4fv(m_shadow_matrix_loc_shadow, 1, GL_FALSE, glm::value_ptr(m_cascades->viewProjection(i)));
+				drawShadowCasters(m_shadow_model_loc, m_cascade_casters);
+				m_cascades->stats.casters_submitted += m_cascade_casters.size();
+			}
 		}
+		m_cascades->endFrame();
 	}
 
 	void render()
@@ -524,4 +1560,142 @@ public:
 		// shadow casts
 		//drawShadows();
 	}
+
+private:
+	void drawLightMarker(const glm::vec3& color, const glm::vec3& position)
+	{
+		m_light_shader->setVec3("lightColor", color);
+
+		glm::mat4 model = glm::mat4(1.0f);
+		model = glm::translate(model, position);
+
+		glUniformMatrix4fv(m_light_model_loc, 1, GL_FALSE, glm::value_ptr(model));
+
+		glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+	}
+
+	// the shadow program and its matrices must already be set
+	void drawShadowCasters(unsigned int model_loc, const std::vector<unsigned int>& casters)
+	{
+		for (unsigned int i = 0; i < casters.size(); ++i)
+		{
+			const ShadowCaster& caster = m_shadow_casters[casters[i]];
+			if (caster.render_object >= 0)
+			{
+				RenderObject& ro = m_render_objects[caster.render_object];
+				glUniformMatrix4fv(model_loc, 1, GL_FALSE, glm::value_ptr(ro.model));
+				gl_state.bindVertexArray(ro.VAO);
+				glDrawElements(GL_TRIANGLES, ro.num_elements, GL_UNSIGNED_INT, 0);
+			}
+			else
+			{
+				glUniformMatrix4fv(model_loc, 1, GL_FALSE, glm::value_ptr(*m_model_transforms[caster.model]));
+				Mesh& mesh = m_models[caster.model]->meshes[caster.mesh];
+				mesh.DrawDepth();
+				countShadowVertices(mesh, 1);
+			}
+		}
+	}
+
+	/**
+	draws each caster instanced once for every face in its mask, the faces' indices go
+	to the vertex shader which picks the layer and viewport from them
+	*/
+	void drawPointShadowCasters(const std::vector<unsigned int>& casters, const std::vector<unsigned int>& face_masks)
+	{
+		for (unsigned int i = 0; i < casters.size(); ++i)
+		{
+			m_point_shadow_faces.clear();
+			for (int face = 0; face < 6; ++face)
+			{
+				if (face_masks[i] & (1 << face))
+					m_point_shadow_faces.push_back(face);
+			}
+			glUniform1iv(m_point_shadow_faces_loc, m_point_shadow_faces.size(), m_point_shadow_faces.data());
+
+			const ShadowCaster& caster = m_shadow_casters[casters[i]];
+			if (caster.render_object >= 0)
+			{
+				RenderObject& ro = m_render_objects[caster.render_object];
+				glUniformMatrix4fv(m_point_shadow_model_loc, 1, GL_FALSE, glm::value_ptr(ro.model));
+				gl_state.bindVertexArray(ro.VAO);
+				glDrawElementsInstanced(GL_TRIANGLES, ro.num_elements, GL_UNSIGNED_INT, 0, m_point_shadow_faces.size());
+			}
+			else
+			{
+				glUniformMatrix4fv(m_point_shadow_model_loc, 1, GL_FALSE, glm::value_ptr(*m_model_transforms[caster.model]));
+				Mesh& mesh = m_models[caster.model]->meshes[caster.mesh];
+				mesh.DrawDepth(m_point_shadow_faces.size());
+				countShadowVertices(mesh, m_point_shadow_faces.size());
+			}
+		}
+	}
+
+	void countShadowVertices(const Mesh& mesh, unsigned int instances)
+	{
+		double vertices = (double)mesh.vertices.size() * instances;
+		m_depth_stream_stats.shadow_bytes += vertices * Mesh::position_stride;
+		m_depth_stream_stats.shadow_interleaved_bytes += vertices * sizeof(Vertex);
+	}
+
+	void addRenderObjectCulling(unsigned int num_elements)
+	{
+		m_render_object_visible.push_back(1);
+
+		m_render_object_shadow_caster.push_back(m_shadow_casters.size());
+		m_shadow_atlas->addCaster();
+		m_shadow_casters.push_back({ (int)m_render_objects.size() - 1, -1, 0 });
+
+		if (m_hiz_culler)
+			m_render_object_cull_index.push_back(m_hiz_culler->addObject(num_elements));
+	}
+
+	void updateCullBounds()
+	{
+		for (unsigned int i = 0; i < m_render_objects.size(); ++i)
+			m_hiz_culler->setBounds(m_render_object_cull_index[i], m_render_objects[i].worldBounds());
+
+		for (unsigned int i = 0; i < m_models.size(); ++i)
+		{
+			for (unsigned int j = 0; j < m_models[i]->meshes.size(); ++j)
+				m_hiz_culler->setBounds(m_model_cull_index[i] + j, m_models[i]->meshes[j].bounds.transform(*m_model_transforms[i]));
+		}
+	}
+
+	/**
+	rasterizes the occluders on the cpu and tests every render object and mesh against them
+	*/
+	void updateSoftwareOcclusion(const glm::mat4& view_proj)
+	{
+		CPU_ZONE("Renderer::updateSoftwareOcclusion");
+		if (!m_software_culling || m_occluders.empty())
+		{
+			std::fill(m_render_object_visible.begin(), m_render_object_visible.end(), 1);
+			std::fill(m_mesh_visible.begin(), m_mesh_visible.end(), 1);
+			return;
+		}
+
+		m_software_occlusion.begin(view_proj);
+		for (unsigned int i = 0; i < m_occluders.size(); ++i)
+		{
+			const Occluder& occluder = m_occluders[i];
+			if (occluder.render_object >= 0)
+				m_software_occlusion.submit(occluder.mesh, m_render_objects[occluder.render_object].model);
+			else
+				m_software_occlusion.submit(occluder.mesh, *occluder.transform);
+		}
+		m_software_occlusion.rasterize();
+
+		for (unsigned int i = 0; i < m_render_objects.size(); ++i)
+		{
+			RenderObject& ro = m_render_objects[i];
+			m_render_object_visible[i] = !ro.has_bounds || m_software_occlusion.isVisible(ro.worldBounds());
+		}
+
+		for (unsigned int i = 0; i < m_models.size(); ++i)
+		{
+			for (unsigned int j = 0; j < m_models[i]->meshes.size(); ++j)
+				m_mesh_visible[m_model_mesh_offset[i] + j] = m_software_occlusion.isVisible(m_models[i]->meshes[j].bounds.transform(*m_model_transforms[i]));
+		}
+	}
 };
\ No newline at end of file
@@ -0,0 +1,768 @@
+#pragma once
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "GLState.h"
+#include "GLExtensions.h"
+#include "CpuProfiler.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <functional>
+#include <unordered_map>
+#include <chrono>
+#include <filesystem>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+
+/**
+compile time features of the shaders, each one becomes a #define of 0 or 1 with the name in
+shaderFeatureName. the sources default every feature they read to the most general value, so
+they still compile on their own
+*/
+enum ShaderFeature
+{
+	SHADER_DIR_LIGHT = 1 << 0,		// the directional light is lit
+	SHADER_DIR_SHADOWS = 1 << 1,	// and has cascaded shadows
+	SHADER_POINT_LIGHTS = 1 << 2,	// there are point lights in the clusters
+	SHADER_POINT_SHADOWS = 1 << 3,	// at least one of them has a shadow map
+	SHADER_SPOT_LIGHTS = 1 << 4,
+	SHADER_SPOT_SHADOWS = 1 << 5,
+	SHADER_INSTANCED = 1 << 6,		// transforms come from attributes 3 to 6 instead of the model uniform
+	SHADER_ALPHA_TEST = 1 << 7,		// cut outs are discarded, otherwise only positions are read for depth
+	SHADER_NOISE_OFFSETS = 1 << 8	// the diffuse texture is warped by NoiseTexture
+};
+const unsigned int num_shader_features = 9;
+
+// everything the lighting shaders need to know about the lights
+const unsigned int SHADER_LIGHTING = SHADER_DIR_LIGHT | SHADER_DIR_SHADOWS | SHADER_POINT_LIGHTS | SHADER_POINT_SHADOWS | SHADER_SPOT_LIGHTS | SHADER_SPOT_SHADOWS;
+
+const char* shaderFeatureName(unsigned int index)
+{
+	const char* names[] = { "DIR_LIGHT", "DIR_SHADOWS", "POINT_LIGHTS", "POINT_SHADOWS", "SPOT_LIGHTS", "SPOT_SHADOWS",
+		"INSTANCED", "ALPHA_TEST", "NOISE_OFFSETS" };
+	return names[index];
+}
+
+// 64 bit FNV-1a
+unsigned long long hashString(const std::string& string, unsigned long long hash = 14695981039346656037ull)
+{
+	for (unsigned int i = 0; i < string.size(); ++i)
+	{
+		hash ^= (unsigned char)string[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+class ShaderCache;
+
+/**
+a vertex, optional geometry and fragment program made from source in memory, with the same uniform
+setters as Shader. programs from ShaderCache may still be compiling when they're handed out, ready
+says when they can be drawn with and use waits for them
+*/
+class ShaderProgram
+{
+public:
+	unsigned int m_ID = 0;
+
+	~ShaderProgram()
+	{
+		deleteShaders();
+		glDeleteProgram(m_ID);
+	}
+
+	// whether it's done, which also finishes it if it has just become so
+	bool ready();
+	// blocks until it's done
+	void wait();
+
+	void use()
+	{
+		wait();
+		gl_state.useProgram(m_ID);
+	}
+
+	unsigned int uniformLoc(const std::string& name)
+	{
+		return glGetUniformLocation(m_ID, name.c_str());
+	}
+	void setBool(const std::string& name, bool value)
+	{
+		glUniform1i(uniformLoc(name), (int)value);
+	}
+	void setInt(const std::string& name, int value)
+	{
+		glUniform1i(uniformLoc(name), value);
+	}
+	void setFloat(const std::string& name, float value)
+	{
+		glUniform1f(uniformLoc(name), value);
+	}
+	void setVec2(const std::string& name, const glm::vec2& value)
+	{
+		glUniform2f(uniformLoc(name), value.x, value.y);
+	}
+	void setVec3(const std::string& name, const glm::vec3& value)
+	{
+		glUniform3f(uniformLoc(name), value.x, value.y, value.z);
+	}
+	void setMat4(const std::string& name, const glm::mat4& value)
+	{
+		glUniformMatrix4fv(uniformLoc(name), 1, GL_FALSE, glm::value_ptr(value));
+	}
+
+private:
+	friend class ShaderCache;
+
+	ShaderCache* m_cache = nullptr;		// while it's still being made
+	std::vector<unsigned int> m_shaders;	// kept until the link is done for their errors
+
+	ShaderProgram()
+	{
+	}
+
+	// starts compiling and linking, with parallel compiles nothing here waits for the driver
+	void compile(const std::string& vertex_code, const std::string& fragment_code, const std::string& geometry_code)
+	{
+		deleteShaders();
+		glDeleteProgram(m_ID);
+
+		m_ID = glCreateProgram();
+		m_shaders.push_back(compileShader(GL_VERTEX_SHADER, vertex_code));
+		m_shaders.push_back(compileShader(GL_FRAGMENT_SHADER, fragment_code));
+		if (!geometry_code.empty())
+			m_shaders.push_back(compileShader(GL_GEOMETRY_SHADER, geometry_code));
+		for (unsigned int shader : m_shaders)
+			glAttachShader(m_ID, shader);
+		// has to be set before linking for getBinary to work everywhere
+		if (gl_caps.program_binary)
+			glProgramParameteri(m_ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		glLinkProgram(m_ID);
+	}
+	void loadBinary(unsigned int binary_format, const std::vector<char>& binary)
+	{
+		m_ID = glCreateProgram();
+		glProgramBinary(m_ID, binary_format, binary.data(), (int)binary.size());
+	}
+
+	// without blocking, only with parallel compiles
+	bool completed()
+	{
+		int completed;
+		glGetProgramiv(m_ID, GL_COMPLETION_STATUS_KHR, &completed);
+		return completed;
+	}
+
+	// waits for the link, the errors of programs from source are printed
+	bool linked()
+	{
+		int success;
+		glGetProgramiv(m_ID, GL_LINK_STATUS, &success);
+		if (!success && !m_shaders.empty())
+		{
+			char info_log[1024];
+			const char* names[] = { "VERTEX", "FRAGMENT", "GEOMETRY" };
+			for (unsigned int i = 0; i < m_shaders.size(); ++i)
+			{
+				int compiled;
+				glGetShaderiv(m_shaders[i], GL_COMPILE_STATUS, &compiled);
+				if (!compiled)
+				{
+					glGetShaderInfoLog(m_shaders[i], 1024, NULL, info_log);
+					std::cout << "ERROR::SHADER::" << names[i] << "::COMPILATION_FAILED\n" << info_log << std::endl;
+				}
+			}
+			glGetProgramInfoLog(m_ID, 1024, NULL, info_log);
+			std::cout << "ERROR::PROGRAM::LINKING_FAILED\n" << info_log << std::endl;
+		}
+		deleteShaders();
+		return success;
+	}
+
+	bool getBinary(unsigned int& binary_format, std::vector<char>& binary)
+	{
+		int length = 0;
+		glGetProgramiv(m_ID, GL_PROGRAM_BINARY_LENGTH, &length);
+		if (length <= 0)
+			return false;
+		binary.resize(length);
+		glGetProgramBinary(m_ID, length, &length, &binary_format, binary.data());
+		binary.resize(length);
+		return length > 0;
+	}
+
+	unsigned int compileShader(unsigned int type, const std::string& code)
+	{
+		const char* source = code.c_str();
+		unsigned int shader = glCreateShader(type);
+		glShaderSource(shader, 1, &source, NULL);
+		glCompileShader(shader);
+		return shader;
+	}
+	void deleteShaders()
+	{
+		for (unsigned int shader : m_shaders)
+			glDeleteShader(shader);
+		m_shaders.clear();
+	}
+};
+
+struct ShaderCacheStats
+{
+	unsigned int variants = 0;		// programs made, compiled or loaded
+	unsigned int shared = 0;		// variants that got a program made for another one with the same source
+	unsigned int loaded = 0;		// programs linked from a binary on disk
+	unsigned int rejected = 0;		// binaries the driver refused, compiled from source again
+	unsigned int pending = 0;		// programs still being made
+	unsigned int stood_in = 0;		// passes drawn with another variant while theirs was compiling
+	unsigned int skipped = 0;		// passes skipped because no variant was ready
+	float compile_ms = 0.0f;		// spent compiling and linking, on whichever thread it was done, stalls included
+	float load_ms = 0.0f;			// the same for the binaries
+	float render_thread_ms = 0.0f;	// the render thread spent starting programs, finishing them or waiting for them
+};
+
+enum ShaderCompileMode
+{
+	SHADER_COMPILE_BLOCKING,	// every program is linked before it's handed out
+	SHADER_COMPILE_PARALLEL,	// the driver compiles in the background and is polled, KHR_parallel_shader_compile
+	SHADER_COMPILE_WORKER		// a thread with a context shared with the window's compiles them one after another
+};
+
+/**
+every program made from preprocessed sources, keyed by the hash of the sources, so the same
+defines on the same files are only ever compiled once. source files are read once too.
+
+programs are handed out right away and made in the background when the driver compiles in parallel
+or startWorker has a shared context. a program's setup is called on the render thread once it's
+linked, and update finishes the ones nobody asked about.
+
+when the driver can save programs, they're also kept in binary_dir, keyed by the sources and the
+driver's vendor, renderer and version, so the next run links them without compiling. a driver
+update makes new files, and a binary the driver refuses anyway is compiled and saved again
+*/
+class ShaderCache
+{
+public:
+	ShaderCacheStats stats;
+
+	ShaderCache(const std::string& binary_dir = "cache/shaders") : m_binary_dir(binary_dir)
+	{
+	}
+	~ShaderCache()
+	{
+		if (m_worker.joinable())
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_stop = true;
+			}
+			m_wake.notify_all();
+			m_worker.join();
+			glfwDestroyWindow(m_worker_window);
+		}
+
+		for (auto& job : m_jobs)
+			delete(job.second);
+		for (auto& program : m_programs)
+			delete(program.second);
+	}
+
+	ShaderCompileMode mode()
+	{
+		if (m_worker.joinable())
+			return SHADER_COMPILE_WORKER;
+		return gl_caps.parallel_compile ? SHADER_COMPILE_PARALLEL : SHADER_COMPILE_BLOCKING;
+	}
+
+	/**
+	compiles on a thread of its own with a hidden window sharing window's context, for drivers without
+	parallel compiles. must be called on the main thread before any program is asked for
+	*/
+	void startWorker(GLFWwindow* window)
+	{
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+		m_worker_window = glfwCreateWindow(1, 1, "shader compiler", NULL, window);
+		glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+		if (!m_worker_window)
+		{
+			std::cout << "ERROR::SHADER_CACHE::COULD_NOT_CREATE_SHARED_CONTEXT" << std::endl;
+			return;
+		}
+		m_worker = std::thread(&ShaderCache::work, this);
+	}
+
+	/**
+	the file, with each line #include "name" replaced by the file name from the same directory. #line
+	directives keep the line numbers of errors the files' own, the included ones are source string 1
+	*/
+	const std::string& source(const std::string& path)
+	{
+		auto found = m_sources.find(path);
+		if (found != m_sources.end())
+			return found->second;
+		return m_sources[path] = includeFiles(readFile(path), directory(path), 0, 0);
+	}
+
+	/**
+	the program of the sources, started if there isn't one yet, created says which. setup is called
+	once it's linked
+	*/
+	ShaderProgram* get(const std::string& vertex_code, const std::string& fragment_code, const std::string& geometry_code,
+		const std::function<void(ShaderProgram&)>& setup, bool& created)
+	{
+		unsigned long long hash = hashString(geometry_code, hashString(fragment_code, hashString(vertex_code)));
+		auto found = m_programs.find(hash);
+		created = found == m_programs.end();
+		if (!created)
+		{
+			++stats.shared;
+			return found->second;
+		}
+
+		auto start = std::chrono::high_resolution_clock::now();
+		ShaderProgram* program = new ShaderProgram();
+		program->m_cache = this;
+		m_programs[hash] = program;
+		++stats.variants;
+		++stats.pending;
+
+		Job* job = new Job();
+		job->program = program;
+		job->vertex_code = vertex_code;
+		job->fragment_code = fragment_code;
+		job->geometry_code = geometry_code;
+		job->setup = setup;
+		if (gl_caps.program_binary)
+			job->binary_path = binaryPath(hash);
+		m_jobs[program] = job;
+
+		if (mode() == SHADER_COMPILE_WORKER)
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_queue.push_back(job);
+			}
+			m_wake.notify_one();
+		}
+		else
+		{
+			advance(*job, mode() == SHADER_COMPILE_BLOCKING);
+		}
+		stats.render_thread_ms += std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+		if (mode() == SHADER_COMPILE_BLOCKING)
+			finish(*program, true);
+		return program;
+	}
+	ShaderProgram* get(const std::string& vertex_code, const std::string& fragment_code, const std::function<void(ShaderProgram&)>& setup, bool& created)
+	{
+		return get(vertex_code, fragment_code, "", setup, created);
+	}
+
+	// a program of whole files, without defines
+	ShaderProgram* load(const std::string& vertex_path, const std::string& fragment_path, const std::string& geometry_path = "",
+		const std::function<void(ShaderProgram&)>& setup = nullptr)
+	{
+		bool created;
+		return get(source(vertex_path), source(fragment_path), geometry_path.empty() ? "" : source(geometry_path), setup, created);
+	}
+
+	// finishes every program that's done without waiting for the others, once a frame
+	void update()
+	{
+		CPU_ZONE("ShaderCache::update");
+		std::vector<ShaderProgram*> programs;
+		for (auto& job : m_jobs)
+			programs.push_back(job.first);
+		for (ShaderProgram* program : programs)
+			finish(*program, false);
+	}
+
+	bool finish(ShaderProgram& program, bool block)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		Job* job = m_jobs[&program];
+		bool done;
+		if (mode() == SHADER_COMPILE_WORKER)
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			if (block)
+				m_done.wait(lock, [job]() { return job->state == Job::DONE; });
+			done = job->state == Job::DONE;
+		}
+		else
+		{
+			done = advance(*job, block);
+		}
+
+		if (done)
+		{
+			if (job->loaded)
+			{
+				++stats.loaded;
+				stats.load_ms += job->ms;
+			}
+			else
+			{
+				stats.compile_ms += job->ms;
+			}
+			stats.rejected += job->rejected;
+			--stats.pending;
+
+			std::function<void(ShaderProgram&)> setup = job->setup;
+			m_jobs.erase(&program);
+			delete(job);
+			program.m_cache = nullptr;
+			if (setup)
+				setup(program);
+		}
+		stats.render_thread_ms += std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		return done;
+	}
+
+private:
+	struct Job
+	{
+		enum State { QUEUED, BINARY, SOURCE, DONE };
+
+		ShaderProgram* program;
+		std::string vertex_code;
+		std::string fragment_code;
+		std::string geometry_code;
+		std::string binary_path;
+		std::function<void(ShaderProgram&)> setup;
+
+		State state = QUEUED;	// guarded by m_mutex with the worker
+		bool loaded = false;
+		unsigned int rejected = 0;
+		float ms = 0.0f;		// in advance, with parallel compiles the driver's own threads aren't counted
+	};
+
+	std::unordered_map<unsigned long long, ShaderProgram*> m_programs;
+	std::unordered_map<std::string, std::string> m_sources;
+
+	static std::string readFile(const std::string& path)
+	{
+		std::string code;
+		std::ifstream file;
+		file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+		try
+		{
+			file.open(path);
+			std::stringstream stream;
+			stream << file.rdbuf();
+			file.close();
+			code = stream.str();
+		}
+		catch (std::ifstream::failure& e)
+		{
+			std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ: " << path << std::endl;
+		}
+		return code;
+	}
+
+	static std::string directory(const std::string& path)
+	{
+		size_t slash = path.find_last_of("/\\");
+		return slash == std::string::npos ? "" : path.substr(0, slash + 1);
+	}
+
+	// number is the source string of code, 0 for the file a program is made from. depth stops include cycles
+	static std::string includeFiles(const std::string& code, const std::string& dir, unsigned int number, unsigned int depth)
+	{
+		std::string result;
+		std::istringstream lines(code);
+		std::string line;
+		unsigned int line_number = 0;
+		bool first = true;
+		while (std::getline(lines, line))
+		{
+			++line_number;
+			result += first ? "" : "\n";
+			first = false;
+
+			size_t begin = line.find("#include \"");
+			size_t end = begin == std::string::npos ? std::string::npos : line.find('"', begin + 10);
+			if (end == std::string::npos || line.find_first_not_of(" \t") != begin)
+			{
+				result += line;
+				continue;
+			}
+			if (depth >= 8)
+			{
+				std::cout << "ERROR::SHADER::INCLUDES_TOO_DEEP: " << line << std::endl;
+				continue;
+			}
+
+			std::string name = line.substr(begin + 10, end - begin - 10);
+			result += "#line 1 1\n" + includeFiles(readFile(dir + name), directory(dir + name), 1, depth + 1)
+				+ "\n#line " + std::to_string(line_number + 1) + " " + std::to_string(number);
+		}
+		return result;
+	}
+	std::unordered_map<ShaderProgram*, Job*> m_jobs;
+
+	std::string m_binary_dir;
+	unsigned long long m_driver_hash = 0;
+
+	GLFWwindow* m_worker_window = nullptr;
+	std::thread m_worker;
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::condition_variable m_done;
+	std::deque<Job*> m_queue;
+	bool m_stop = false;
+
+	/**
+	loads the binary or compiles the sources, then finishes the link once the driver is done with it.
+	returns whether the program is done, which without block is only when it didn't have to wait
+	*/
+	bool advance(Job& job, bool block)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		bool done = advanceStates(job, block);
+		job.ms += std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		return done;
+	}
+	bool advanceStates(Job& job, bool block)
+	{
+		ShaderProgram& program = *job.program;
+		while (true)
+		{
+			switch (job.state)
+			{
+			case Job::QUEUED:
+				if (!job.binary_path.empty() && loadBinary(job.binary_path, program))
+				{
+					job.state = Job::BINARY;
+				}
+				else
+				{
+					program.compile(job.vertex_code, job.fragment_code, job.geometry_code);
+					job.state = Job::SOURCE;
+				}
+				break;
+			case Job::BINARY:
+				if (!block && !program.completed())
+					return false;
+				if (program.linked())
+				{
+					job.loaded = true;
+					job.state = Job::DONE;
+				}
+				else
+				{
+					++job.rejected;
+					program.compile(job.vertex_code, job.fragment_code, job.geometry_code);
+					job.state = Job::SOURCE;
+				}
+				break;
+			case Job::SOURCE:
+				if (!block && !program.completed())
+					return false;
+				if (program.linked() && !job.binary_path.empty())
+					saveBinary(job.binary_path, program);
+				job.state = Job::DONE;
+				break;
+			case Job::DONE:
+				return true;
+			}
+		}
+	}
+
+	// the worker's loop, programs are made in the order they're asked for
+	void work()
+	{
+		CPU_THREAD("shader compiler");
+		glfwMakeContextCurrent(m_worker_window);
+		while (true)
+		{
+			Job* job;
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_wake.wait(lock, [this]() { return m_stop || !m_queue.empty(); });
+				if (m_stop)
+					break;
+				job = m_queue.front();
+				m_queue.pop_front();
+			}
+
+			// the state is only read by the render thread once it's DONE
+			CPU_ZONE("ShaderCache::compile");
+			Job made = *job;
+			advance(made, true);
+			// the program is complete before the render thread's context uses it
+			glFinish();
+
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				*job = made;
+			}
+			m_done.notify_all();
+		}
+		glfwMakeContextCurrent(NULL);
+	}
+
+	std::string binaryPath(unsigned long long hash)
+	{
+		if (!m_driver_hash)
+		{
+			std::string driver;
+			for (unsigned int name : { GL_VENDOR, GL_RENDERER, GL_VERSION })
+			{
+				const char* string = (const char*)glGetString(name);
+				driver += std::string(string ? string : "") + "\n";
+			}
+			m_driver_hash = hashString(driver);
+		}
+
+		std::stringstream name;
+		name << std::hex << std::setfill('0') << std::setw(16) << hashString(std::to_string(hash), m_driver_hash) << ".bin";
+		return m_binary_dir + "/" + name.str();
+	}
+
+	// the file is the binary format followed by the binary
+	bool loadBinary(const std::string& path, ShaderProgram& program)
+	{
+		std::ifstream file(path, std::ios::binary | std::ios::ate);
+		if (!file)
+			return false;
+
+		size_t size = (size_t)file.tellg();
+		unsigned int binary_format;
+		if (size <= sizeof(binary_format))
+			return false;
+		std::vector<char> binary(size - sizeof(binary_format));
+		file.seekg(0);
+		if (!file.read((char*)&binary_format, sizeof(binary_format)) || !file.read(binary.data(), binary.size()))
+			return false;
+
+		program.loadBinary(binary_format, binary);
+		return true;
+	}
+
+	void saveBinary(const std::string& path, ShaderProgram& program)
+	{
+		unsigned int binary_format;
+		std::vector<char> binary;
+		if (!program.getBinary(binary_format, binary))
+			return;
+
+		std::error_code error;
+		std::filesystem::create_directories(m_binary_dir, error);
+		std::ofstream file(path, std::ios::binary);
+		if (!error && file.write((const char*)&binary_format, sizeof(binary_format)) && file.write(binary.data(), binary.size()))
+			return;
+		std::cout << "ERROR::SHADER_CACHE::COULD_NOT_WRITE_BINARY " << path << std::endl;
+	}
+};
+
+bool ShaderProgram::ready()
+{
+	return !m_cache || m_cache->finish(*this, false);
+}
+
+void ShaderProgram::wait()
+{
+	if (m_cache)
+		m_cache->finish(*this, true);
+}
+
+
+/**
+the variants of one vertex and fragment shader, compiled the first time they're asked for.
+features the sources don't read are dropped before the lookup so they don't make copies of the
+same program, and setup is called once on every new program, when it has linked, to bind its blocks and samplers
+*/
+class ShaderVariants
+{
+public:
+	ShaderVariants(ShaderCache& cache, const char* vertex_path, const char* fragment_path, unsigned int supported, const std::function<void(ShaderProgram&)>& setup)
+		: m_cache(cache), m_vertex_path(vertex_path), m_fragment_path(fragment_path), m_supported(supported), m_setup(setup)
+	{
+	}
+
+	ShaderProgram* get(unsigned int features)
+	{
+		features &= m_supported;
+		auto found = m_variants.find(features);
+		if (found != m_variants.end())
+			return found->second;
+
+		std::string defines = defineFeatures(features);
+		bool created;
+		ShaderProgram* program = m_cache.get(injectDefines(m_cache.source(m_vertex_path), defines),
+			injectDefines(m_cache.source(m_fragment_path), defines), m_setup, created);
+
+		m_variants[features] = program;
+		return program;
+	}
+
+	/**
+	the program of features if it's ready, otherwise the one of fallback features, which should have been
+	asked for earlier so it has had time to compile. nullptr if neither is ready
+	*/
+	ShaderProgram* getReady(unsigned int features, unsigned int fallback)
+	{
+		ShaderProgram* program = get(features);
+		if (program->ready())
+			return program;
+		program = get(fallback);
+		if (program->ready() && fallback != features)
+		{
+			++m_cache.stats.stood_in;
+			return program;
+		}
+		++m_cache.stats.skipped;
+		return nullptr;
+	}
+
+	// the programs still compiling get their setup once they're done instead
+	void forEach(const std::function<void(ShaderProgram&)>& func)
+	{
+		for (auto& variant : m_variants)
+		{
+			if (variant.second->ready())
+				func(*variant.second);
+		}
+	}
+
+private:
+	ShaderCache& m_cache;
+	std::string m_vertex_path;
+	std::string m_fragment_path;
+	unsigned int m_supported;
+	std::function<void(ShaderProgram&)> m_setup;
+
+	std::unordered_map<unsigned int, ShaderProgram*> m_variants;
+
+	std::string defineFeatures(unsigned int features)
+	{
+		std::string defines;
+		for (unsigned int i = 0; i < num_shader_features; ++i)
+		{
+			if (m_supported & (1 << i))
+				defines += std::string("#define ") + shaderFeatureName(i) + ((features & (1 << i)) ? " 1\n" : " 0\n");
+		}
+		return defines;
+	}
+
+	// after the #version line, which must come first, with the line numbers of errors kept the same as the file's
+	static std::string injectDefines(const std::string& code, const std::string& defines)
+	{
+		size_t line_end = code.find('\n');
+		if (line_end == std::string::npos)
+			return code;
+		return code.substr(0, line_end + 1) + defines + "#line 2\n" + code.substr(line_end + 1);
+	}
+};
\ No newline at end of file
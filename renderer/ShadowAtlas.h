@@ -0,0 +1,731 @@
+#pragma once
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Light.h"
+#include "Bounds.h"
+#include "GLState.h"
+#include "GLExtensions.h"
+#include "GpuTimer.h"
+#include "ShadowFilter.h"
+
+#include <vector>
+#include <functional>
+#include <algorithm>
+#include <iostream>
+
+// one shadow map in the atlas, laid out like ShadowView in the Shadows block of Fragment.shader (std140)
+struct ShadowViewData
+{
+	glm::mat4 view_projection;
+	glm::vec4 rect;		// offset and scale from the view's uv to the atlas' uv
+	glm::vec4 params;	// layer, texel size in atlas uv, depth bias
+};
+
+struct ShadowAtlasStats
+{
+	unsigned int views = 0;
+	unsigned int updated = 0;			// views drawn this frame
+	unsigned int static_rebuilt = 0;	// of those, the ones whose static casters were drawn again
+	unsigned int waiting = 0;			// out of date views the budget left for a later frame
+	unsigned int casters_drawn = 0;		// a caster drawn into several views counts once for each
+	unsigned int draw_calls = 0;
+	unsigned int dynamic_casters = 0;
+	float gpu_ms = 0.0f;
+};
+
+/**
+the shadow maps of point and spot lights live in one layered depth atlas: a spot light
+takes a quarter of a layer and a point light six quarters, one for each cube face.
+the directional light has cascades instead, see CascadedShadows.h.
+
+each view keeps the depth of its static casters in a second atlas with the same layout.
+a view is only drawn again when its light changes, when a caster near it moves, or while
+it has moving casters in it, and then the cached static depth is copied back and only the
+moving casters are drawn over it. casters count as moving until they have been still for
+settle_frames, after which they go back into the static cache.
+views that are out of date are drawn oldest first until the frame's texel budget is spent,
+so a static scene draws nothing at all.
+
+with a draw_faces function the faces of a point light are drawn together: each caster is
+culled against the six faces on the cpu and drawn once, instanced for the faces it touches,
+into the whole atlas with the layer and viewport picked in the vertex shader
+*/
+class ShadowAtlas
+{
+public:
+	typedef std::function<void(const glm::mat4&, const std::vector<unsigned int>&)> DrawCasters;
+	typedef std::function<void(unsigned int, const std::vector<unsigned int>&, const std::vector<unsigned int>&)> DrawFaces;
+
+	static const unsigned int binding = 3;
+	static const unsigned int texture_unit = 4;
+	static const unsigned int compare_unit = 6;
+	static const unsigned int max_views = 64;
+	static const unsigned int settle_frames = 30;
+
+	// point and spot shadows end at the light's radius or here, whichever is closer
+	float max_distance = 50.0f;
+
+	ShadowAtlasStats stats;
+
+	ShadowAtlas(unsigned int size, unsigned int layers) : m_size(size), m_layers(layers)
+	{
+		m_live = createAtlas();
+		m_static = createAtlas();
+
+		m_live_fbos.resize(layers);
+		m_static_fbos.resize(layers);
+		glGenFramebuffers(layers, m_live_fbos.data());
+		glGenFramebuffers(layers, m_static_fbos.data());
+		for (unsigned int i = 0; i < layers; ++i)
+		{
+			attachLayer(m_live_fbos[i], m_live, i);
+			attachLayer(m_static_fbos[i], m_static, i);
+
+			m_free.push_back({ 0, 0, size, i });
+		}
+
+		// every layer at once for the point light faces
+		glGenFramebuffers(1, &m_live_layered_fbo);
+		glGenFramebuffers(1, &m_static_layered_fbo);
+		attachLayer(m_live_layered_fbo, m_live, -1);
+		attachLayer(m_static_layered_fbo, m_static, -1);
+
+		glGenBuffers(1, &m_ubo);
+		glBindBuffer(GL_UNIFORM_BUFFER, m_ubo);
+		glBufferData(GL_UNIFORM_BUFFER, max_views * sizeof(ShadowViewData), NULL, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+		glBindBufferBase(GL_UNIFORM_BUFFER, binding, m_ubo);
+
+		m_compare_sampler = createCompareSampler();
+		m_timer = new GpuTimer();
+	}
+	~ShadowAtlas()
+	{
+		glDeleteFramebuffers(m_layers, m_live_fbos.data());
+		glDeleteFramebuffers(m_layers, m_static_fbos.data());
+		glDeleteFramebuffers(1, &m_live_layered_fbo);
+		glDeleteFramebuffers(1, &m_static_layered_fbo);
+		glDeleteTextures(1, &m_live);
+		glDeleteTextures(1, &m_static);
+		gl_state.forgetTexture(m_live);
+		gl_state.forgetTexture(m_static);
+		glDeleteBuffers(1, &m_ubo);
+		glDeleteSamplers(1, &m_compare_sampler);
+
+		delete(m_timer);
+	}
+
+	/**
+	points the program's Shadows block and atlas samplers at the atlas
+	*/
+	void bindToProgram(unsigned int program)
+	{
+		unsigned int index = glGetUniformBlockIndex(program, "Shadows");
+		if (index != GL_INVALID_INDEX)
+			glUniformBlockBinding(program, index, binding);
+
+		gl_state.useProgram(program);
+		glUniform1i(glGetUniformLocation(program, "shadow_atlas"), texture_unit);
+		glUniform1i(glGetUniformLocation(program, "shadow_atlas_compare"), compare_unit);
+	}
+
+	/**
+	gives the light its views in the atlas and sets its shadow_view to the first one.
+	returns false and leaves the light without a shadow if the atlas is full
+	*/
+	bool addLight(Light* light)
+	{
+		if (light->type == DIRECTIONAL_LIGHT)
+		{
+			std::cout << "ERROR::SHADOW_ATLAS:: directional lights use cascaded shadows" << std::endl;
+			return false;
+		}
+
+		unsigned int size = m_size / 2;
+		unsigned int num_views = light->type == POINT_LIGHT ? 6 : 1;
+
+		if (m_views.size() + num_views > max_views)
+		{
+			std::cout << "ERROR::SHADOW_ATLAS:: too many shadow views" << std::endl;
+			return false;
+		}
+
+		std::vector<Tile> tiles;
+		for (unsigned int i = 0; i < num_views; ++i)
+		{
+			Tile tile;
+			if (!allocate(size, tile))
+			{
+				std::cout << "ERROR::SHADOW_ATLAS:: no room for a " << size << " shadow map" << std::endl;
+				m_free.insert(m_free.end(), tiles.begin(), tiles.end());
+				return false;
+			}
+			tiles.push_back(tile);
+		}
+
+		light->shadow_view = m_views.size();
+		light->dirty = true;
+		for (unsigned int i = 0; i < num_views; ++i)
+		{
+			View view;
+			view.light = light;
+			view.face = i;
+			view.tile = tiles[i];
+			m_views.push_back(view);
+		}
+		return true;
+	}
+
+	unsigned int addCaster()
+	{
+		m_casters.emplace_back();
+		return m_casters.size() - 1;
+	}
+
+	/**
+	world bounds of the caster this frame, a caster moves when they change
+	*/
+	void setCasterBounds(unsigned int caster, const AABB& bounds)
+	{
+		Caster& c = m_casters[caster];
+		if (!c.placed || bounds.min != c.bounds.min || bounds.max != c.bounds.max)
+			c.moved = true;
+		c.bounds = bounds;
+	}
+
+	/**
+	texels drawn each frame before the remaining views wait for the next one, at least one view
+	is always drawn, and views that were never drawn aren't held back
+	*/
+	void setBudget(unsigned int texels)
+	{
+		m_budget = texels;
+	}
+
+	/**
+	true if a caster was added, moved, or came to rest in the last update, or if some are still moving
+	*/
+	bool castersChanged()
+	{
+		return m_casters_changed || !m_dynamic.empty();
+	}
+
+	// draws every view again, keeping nothing cached
+	void invalidate()
+	{
+		for (unsigned int i = 0; i < m_views.size(); ++i)
+			m_views[i].static_valid = false;
+	}
+
+	/**
+	brings the views up to date. draw_casters draws the given casters with the given view projection
+	into whatever framebuffer and viewport is bound, the shadow program must already be in use.
+	draw_faces, if given, draws the point light casters instead: each caster once for every face set
+	in its mask, with the faces' viewports bound in face order. it has to use its own program
+	*/
+	void update(const glm::vec3& camera_pos, const DrawCasters& draw_casters, const DrawFaces& draw_faces = nullptr)
+	{
+		stats.views = m_views.size();
+		stats.updated = 0;
+		stats.static_rebuilt = 0;
+		stats.waiting = 0;
+		stats.casters_drawn = 0;
+		stats.draw_calls = 0;
+		stats.gpu_ms = m_timer->ms();
+
+		updateCasters();
+
+		if (m_views.empty())
+			return;
+
+		// what each view should be drawn with now, and whether it's out of date
+		std::vector<unsigned int> pending;
+		for (unsigned int i = 0; i < m_views.size(); ++i)
+		{
+			View& view = m_views[i];
+			view.target = viewProjection(view);
+			if (view.target != view.view_projection)
+				view.static_valid = false;
+
+			view.frustum = Frustum(view.target);
+			bool has_dynamic = false;
+			for (unsigned int j = 0; j < m_dynamic.size() && !has_dynamic; ++j)
+				has_dynamic = view.frustum.intersectsAABB(m_casters[m_dynamic[j]].bounds);
+
+			// a view that had moving casters is drawn once more after they leave to clear them
+			if (!view.static_valid || has_dynamic || view.has_dynamic)
+			{
+				++view.waiting;
+				pending.push_back(i);
+			}
+		}
+
+		if (pending.empty())
+			return;
+
+		// oldest first, then closest to the camera
+		std::vector<float> distance(m_views.size(), 0.0f);
+		for (unsigned int i = 0; i < pending.size(); ++i)
+			distance[pending[i]] = glm::length(m_views[pending[i]].light->position - camera_pos);
+		std::sort(pending.begin(), pending.end(), [&](unsigned int a, unsigned int b)
+		{
+			if (m_views[a].waiting != m_views[b].waiting)
+				return m_views[a].waiting > m_views[b].waiting;
+			return distance[a] < distance[b];
+		});
+
+		m_timer->begin();
+		gl_state.enable(GL_SCISSOR_TEST);
+
+		unsigned int spent = 0;
+		std::vector<unsigned int> face_masks(m_views.size(), 0);
+		for (unsigned int i = 0; i < pending.size(); ++i)
+		{
+			View& view = m_views[pending[i]];
+			unsigned int texels = view.tile.size * view.tile.size;
+			if (spent > 0 && spent + texels > m_budget && view.drawn)
+			{
+				++stats.waiting;
+				continue;
+			}
+			spent += texels;
+
+			if (draw_faces && view.light->type == POINT_LIGHT)
+				face_masks[view.light->shadow_view] |= 1 << view.face;
+			else
+				drawView(pending[i], draw_casters);
+		}
+
+		for (unsigned int i = 0; i < face_masks.size(); ++i)
+		{
+			if (face_masks[i])
+				drawFaces(i, face_masks[i], draw_faces);
+		}
+
+		gl_state.disable(GL_SCISSOR_TEST);
+		m_timer->end();
+	}
+
+	void bind()
+	{
+		gl_state.bindTexture(texture_unit, GL_TEXTURE_2D_ARRAY, m_live);
+		gl_state.bindTexture(compare_unit, GL_TEXTURE_2D_ARRAY, m_live);
+		glBindSampler(compare_unit, m_compare_sampler);
+	}
+
+private:
+	struct Tile
+	{
+		unsigned int x, y, size, layer;
+	};
+	struct View
+	{
+		Light* light;
+		unsigned int face;
+		Tile tile;
+
+		glm::mat4 view_projection = glm::mat4(0.0f);	// what the tile was drawn with
+		glm::mat4 target;								// what it should be drawn with this frame
+		Frustum frustum;
+
+		bool drawn = false;
+		bool static_valid = false;
+		bool has_dynamic = false;
+		unsigned int waiting = 0;
+	};
+	struct Caster
+	{
+		AABB bounds;
+		AABB static_bounds;		// where it was when it was drawn into the static cache
+		bool placed = false;
+		bool moved = false;
+		bool is_static = false;
+		unsigned int still_frames = 0;
+	};
+
+	unsigned int m_size;
+	unsigned int m_layers;
+	unsigned int m_budget = 4 * 1024 * 1024;
+
+	unsigned int m_live;
+	unsigned int m_static;
+	std::vector<unsigned int> m_live_fbos;
+	std::vector<unsigned int> m_static_fbos;
+	unsigned int m_live_layered_fbo;
+	unsigned int m_static_layered_fbo;
+	unsigned int m_ubo;
+	unsigned int m_compare_sampler;
+
+	GpuTimer* m_timer;
+
+	std::vector<Tile> m_free;
+	std::vector<View> m_views;
+	std::vector<Caster> m_casters;
+	std::vector<unsigned int> m_dynamic;
+	bool m_casters_changed = false;
+	std::vector<unsigned int> m_draw_list;
+	std::vector<unsigned int> m_draw_masks;
+
+	unsigned int createAtlas()
+	{
+		unsigned int texture;
+		glGenTextures(1, &texture);
+		gl_state.bindTexture(texture_unit, GL_TEXTURE_2D_ARRAY, texture);
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, m_size, m_size, m_layers, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		return texture;
+	}
+
+	// a layer below 0 attaches all of them
+	void attachLayer(unsigned int fbo, unsigned int texture, int layer)
+	{
+		gl_state.bindFramebuffer(GL_FRAMEBUFFER, fbo);
+		if (layer < 0)
+			glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texture, 0);
+		else
+			glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texture, 0, layer);
+		glDrawBuffer(GL_NONE);
+		glReadBuffer(GL_NONE);
+
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		{
+			std::cout << "ERROR::FRAMEBUFFER:: Shadow atlas framebuffer is not complete!" << std::endl;
+		}
+		gl_state.bindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+
+	// takes the smallest free tile that fits and splits it down to size
+	bool allocate(unsigned int size, Tile& tile)
+	{
+		int best = -1;
+		for (unsigned int i = 0; i < m_free.size(); ++i)
+		{
+			if (m_free[i].size >= size && (best < 0 || m_free[i].size < m_free[best].size))
+				best = i;
+		}
+		if (best < 0)
+			return false;
+
+		tile = m_free[best];
+		m_free.erase(m_free.begin() + best);
+		while (tile.size > size)
+		{
+			tile.size /= 2;
+			m_free.push_back({ tile.x + tile.size, tile.y, tile.size, tile.layer });
+			m_free.push_back({ tile.x, tile.y + tile.size, tile.size, tile.layer });
+			m_free.push_back({ tile.x + tile.size, tile.y + tile.size, tile.size, tile.layer });
+		}
+		return true;
+	}
+
+	/**
+	moves casters between the static cache and the list drawn every frame, and marks the
+	static depth of the views they were or will be cached in as out of date
+	*/
+	void updateCasters()
+	{
+		m_dynamic.clear();
+		m_casters_changed = false;
+		for (unsigned int i = 0; i < m_casters.size(); ++i)
+		{
+			Caster& caster = m_casters[i];
+			if (!caster.placed)
+			{
+				// new casters start out static
+				caster.placed = true;
+				caster.moved = false;
+				caster.is_static = true;
+				caster.static_bounds = caster.bounds;
+				invalidateStatic(caster.bounds);
+				m_casters_changed = true;
+				continue;
+			}
+
+			if (caster.moved)
+			{
+				if (caster.is_static)
+					invalidateStatic(caster.static_bounds);
+				caster.is_static = false;
+				caster.still_frames = 0;
+				caster.moved = false;
+				m_casters_changed = true;
+			}
+			else if (!caster.is_static && ++caster.still_frames >= settle_frames)
+			{
+				caster.is_static = true;
+				caster.static_bounds = caster.bounds;
+				invalidateStatic(caster.bounds);
+				m_casters_changed = true;
+			}
+
+			if (!caster.is_static)
+				m_dynamic.push_back(i);
+		}
+		stats.dynamic_casters = m_dynamic.size();
+	}
+
+	void invalidateStatic(const AABB& bounds)
+	{
+		for (unsigned int i = 0; i < m_views.size(); ++i)
+		{
+			if (m_views[i].static_valid && Frustum(m_views[i].view_projection).intersectsAABB(bounds))
+				m_views[i].static_valid = false;
+		}
+	}
+
+	glm::mat4 viewProjection(const View& view)
+	{
+		Light* light = view.light;
+		float far = max_distance;
+		if (light->type == POINT_LIGHT)
+		{
+			far = glm::min(far, ((PointLight*)light)->radius);
+
+			// a couple of texels wider than 90 degrees so filtering near the edges stays inside the face
+			float fov = 2.0f * glm::atan(1.0f + 2.0f / view.tile.size);
+			glm::mat4 proj = glm::perspective(fov, 1.0f, 0.1f, far);
+
+			const glm::vec3 directions[6] = {
+				glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f),
+				glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+				glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f)
+			};
+			const glm::vec3 ups[6] = {
+				glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+				glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f),
+				glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)
+			};
+			return proj * glm::lookAt(light->position, light->position + directions[view.face], ups[view.face]);
+		}
+
+		SpotLight* spot = (SpotLight*)light;
+		far = glm::min(far, spot->radius);
+		float fov = glm::min(2.0f * glm::acos(spot->outer_cutoff) + 0.05f, glm::radians(170.0f));
+		glm::mat4 proj = glm::perspective(fov, 1.0f, 0.1f, far);
+		return proj * lookAt(light->position, light->direction);
+	}
+
+	glm::mat4 lookAt(const glm::vec3& eye, const glm::vec3& direction)
+	{
+		glm::vec3 dir = glm::normalize(direction);
+		glm::vec3 up = glm::abs(dir.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+		return glm::lookAt(eye, eye + dir, up);
+	}
+
+	/**
+	draws the static casters into the cache if it's out of date, copies the cached depth
+	into the atlas and draws the moving casters over it
+	*/
+	void drawView(unsigned int index, const DrawCasters& draw_casters)
+	{
+		View& view = m_views[index];
+		const Tile& tile = view.tile;
+
+		gl_state.viewport(tile.x, tile.y, tile.size, tile.size);
+		glScissor(tile.x, tile.y, tile.size, tile.size);
+
+		if (!view.static_valid)
+		{
+			m_draw_list.clear();
+			for (unsigned int i = 0; i < m_casters.size(); ++i)
+			{
+				if (m_casters[i].is_static && view.frustum.intersectsAABB(m_casters[i].bounds))
+					m_draw_list.push_back(i);
+			}
+
+			gl_state.bindFramebuffer(GL_FRAMEBUFFER, m_static_fbos[tile.layer]);
+			glClear(GL_DEPTH_BUFFER_BIT);
+			if (!m_draw_list.empty())
+				draw_casters(view.target, m_draw_list);
+
+			stats.casters_drawn += m_draw_list.size();
+			stats.draw_calls += m_draw_list.size();
+			++stats.static_rebuilt;
+			view.static_valid = true;
+		}
+
+		copyStatic(tile);
+
+		m_draw_list.clear();
+		for (unsigned int i = 0; i < m_dynamic.size(); ++i)
+		{
+			if (view.frustum.intersectsAABB(m_casters[m_dynamic[i]].bounds))
+				m_draw_list.push_back(m_dynamic[i]);
+		}
+		if (!m_draw_list.empty())
+		{
+			gl_state.bindFramebuffer(GL_FRAMEBUFFER, m_live_fbos[tile.layer]);
+			draw_casters(view.target, m_draw_list);
+		}
+		stats.casters_drawn += m_draw_list.size();
+		stats.draw_calls += m_draw_list.size();
+
+		view.has_dynamic = !m_draw_list.empty();
+		finishView(index);
+		upload(index);
+	}
+
+	/**
+	drawView for the faces in face_mask of the point light whose first view is first_view,
+	with one instanced draw for each caster instead of one draw per face
+	*/
+	void drawFaces(unsigned int first_view, unsigned int face_mask, const DrawFaces& draw_faces)
+	{
+		// the faces' matrices are read from the uniform buffer while they're drawn
+		unsigned int rebuild_mask = 0;
+		for (unsigned int i = 0; i < 6; ++i)
+		{
+			if (!(face_mask & (1 << i)))
+				continue;
+
+			View& view = m_views[first_view + i];
+			view.view_projection = view.target;
+			upload(first_view + i);
+
+			if (!view.static_valid)
+			{
+				rebuild_mask |= 1 << i;
+				gl_state.bindFramebuffer(GL_FRAMEBUFFER, m_static_fbos[view.tile.layer]);
+				glScissor(view.tile.x, view.tile.y, view.tile.size, view.tile.size);
+				glClear(GL_DEPTH_BUFFER_BIT);
+			}
+		}
+
+		if (rebuild_mask)
+		{
+			cullFaces(first_view, rebuild_mask, true);
+			if (!m_draw_list.empty())
+			{
+				gl_state.bindFramebuffer(GL_FRAMEBUFFER, m_static_layered_fbo);
+				drawFaceCasters(first_view, draw_faces);
+			}
+		}
+
+		for (unsigned int i = 0; i < 6; ++i)
+		{
+			if (face_mask & (1 << i))
+			{
+				const Tile& tile = m_views[first_view + i].tile;
+				glScissor(tile.x, tile.y, tile.size, tile.size);
+				copyStatic(tile);
+			}
+		}
+
+		unsigned int dynamic_mask = cullFaces(first_view, face_mask, false);
+		if (!m_draw_list.empty())
+		{
+			gl_state.bindFramebuffer(GL_FRAMEBUFFER, m_live_layered_fbo);
+			drawFaceCasters(first_view, draw_faces);
+		}
+
+		for (unsigned int i = 0; i < 6; ++i)
+		{
+			if (!(face_mask & (1 << i)))
+				continue;
+
+			View& view = m_views[first_view + i];
+			if (!view.static_valid)
+			{
+				view.static_valid = true;
+				++stats.static_rebuilt;
+			}
+			view.has_dynamic = (dynamic_mask & (1 << i)) != 0;
+			finishView(first_view + i);
+		}
+	}
+
+	/**
+	fills the draw list with the static or the moving casters that touch any of the faces in
+	face_mask, and the draw masks with the faces each one touches. returns the faces touched
+	*/
+	unsigned int cullFaces(unsigned int first_view, unsigned int face_mask, bool is_static)
+	{
+		m_draw_list.clear();
+		m_draw_masks.clear();
+
+		unsigned int touched = 0;
+		for (unsigned int i = 0; i < m_casters.size(); ++i)
+		{
+			if (m_casters[i].is_static != is_static)
+				continue;
+
+			unsigned int mask = 0;
+			for (unsigned int j = 0; j < 6; ++j)
+			{
+				if ((face_mask & (1 << j)) && m_views[first_view + j].frustum.intersectsAABB(m_casters[i].bounds))
+					mask |= 1 << j;
+			}
+			if (!mask)
+				continue;
+
+			m_draw_list.push_back(i);
+			m_draw_masks.push_back(mask);
+			touched |= mask;
+		}
+		return touched;
+	}
+
+	void drawFaceCasters(unsigned int first_view, const DrawFaces& draw_faces)
+	{
+		// the clip space of each face only covers its tile, so the scissor isn't needed
+		gl_state.disable(GL_SCISSOR_TEST);
+		const Tile& first = m_views[first_view].tile;
+		gl_state.viewport(first.x, first.y, first.size, first.size);
+		for (unsigned int i = 1; i < 6; ++i)
+		{
+			const Tile& tile = m_views[first_view + i].tile;
+			glViewportIndexedf(i, (float)tile.x, (float)tile.y, (float)tile.size, (float)tile.size);
+		}
+
+		draw_faces(first_view, m_draw_list, m_draw_masks);
+		gl_state.enable(GL_SCISSOR_TEST);
+
+		stats.draw_calls += m_draw_list.size();
+		for (unsigned int i = 0; i < m_draw_masks.size(); ++i)
+		{
+			for (unsigned int j = 0; j < 6; ++j)
+				stats.casters_drawn += (m_draw_masks[i] >> j) & 1;
+		}
+	}
+
+	// copies the cached static depth of the tile into the atlas, the scissor has to be set to the tile
+	void copyStatic(const Tile& tile)
+	{
+		gl_state.bindFramebuffer(GL_READ_FRAMEBUFFER, m_static_fbos[tile.layer]);
+		gl_state.bindFramebuffer(GL_DRAW_FRAMEBUFFER, m_live_fbos[tile.layer]);
+		glBlitFramebuffer(tile.x, tile.y, tile.x + tile.size, tile.y + tile.size,
+						  tile.x, tile.y, tile.x + tile.size, tile.y + tile.size, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+	}
+
+	void finishView(unsigned int index)
+	{
+		View& view = m_views[index];
+		view.view_projection = view.target;
+		view.drawn = true;
+		view.waiting = 0;
+		++stats.updated;
+	}
+
+	// the shader reads the matrix the tile was drawn with, not the newest one
+	void upload(unsigned int index)
+	{
+		const View& view = m_views[index];
+		const Tile& tile = view.tile;
+
+		ShadowViewData data;
+		data.view_projection = view.view_projection;
+		data.rect = glm::vec4((float)tile.x / m_size, (float)tile.y / m_size, (float)tile.size / m_size, (float)tile.size / m_size);
+		data.params = glm::vec4((float)tile.layer, 1.0f / m_size, 0.0005f, 0.0f);
+
+		glBindBuffer(GL_UNIFORM_BUFFER, m_ubo);
+		glBufferSubData(GL_UNIFORM_BUFFER, index * sizeof(ShadowViewData), sizeof(ShadowViewData), &data);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	}
+};
\ No newline at end of file
@@ -0,0 +1,136 @@
+#pragma once
+#include <glad/glad.h>
+
+#include "GLExtensions.h"
+#include "GLState.h"
+#include "GpuTimer.h"
+#include "ComputeShader.h"
+
+#include <iostream>
+
+// how the lighting shaders filter shadows, the shadow_filter uniform of Fragment.shader
+enum ShadowFilterMode
+{
+	SHADOW_FILTER_PCF,		// 9 manual depth comparisons
+	SHADOW_FILTER_HARDWARE,	// 4 comparisons through a comparison sampler, each one filtered over 2x2 texels
+	SHADOW_FILTER_POISSON,	// 8 hardware comparisons spread over a poisson disk
+	SHADOW_FILTER_VSM,		// variance shadow maps, cascades only, the atlas uses SHADOW_FILTER_HARDWARE
+	SHADOW_FILTER_ESM		// exponential shadow maps, cascades only, the atlas uses SHADOW_FILTER_HARDWARE
+};
+
+const char* shadowFilterName(ShadowFilterMode mode)
+{
+	const char* names[] = { "pcf", "hardware pcf", "poisson", "vsm", "esm" };
+	return names[mode];
+}
+
+/**
+a sampler object that compares against the depth it reads and filters the results bilinearly,
+bound to its own texture unit next to the plain sampler of the same depth texture
+*/
+unsigned int createCompareSampler()
+{
+	unsigned int sampler;
+	glGenSamplers(1, &sampler);
+	glSamplerParameteri(sampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glSamplerParameteri(sampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glSamplerParameteri(sampler, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glSamplerParameteri(sampler, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glSamplerParameteri(sampler, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	glSamplerParameteri(sampler, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+	return sampler;
+}
+
+/**
+the moments of a layered depth texture at half its resolution, for variance and exponential
+shadow maps. each 2x2 block of depth becomes one texel of moments, which are then blurred
+with a separable 5 tap gaussian in two compute passes, so the lighting shader only needs a
+single linearly filtered fetch. needs gl_caps.compute
+*/
+class ShadowMoments
+{
+public:
+	static const unsigned int texture_unit = 15;
+	// must match esm_exponent in Fragment.shader
+	static constexpr float esm_exponent = 80.0f;
+
+	ShadowMoments(unsigned int depth_size, unsigned int layers) : m_size(depth_size / 2), m_layers(layers)
+	{
+		m_moments = createTexture();
+		m_blurred = createTexture();
+		m_shader = new ComputeShader("shaders/ShadowMomentsCompute.shader");
+		m_timer = new GpuTimer();
+	}
+	~ShadowMoments()
+	{
+		glDeleteTextures(1, &m_moments);
+		glDeleteTextures(1, &m_blurred);
+		gl_state.forgetTexture(m_moments);
+		gl_state.forgetTexture(m_blurred);
+
+		delete(m_shader);
+		delete(m_timer);
+	}
+
+	/**
+	builds the moments of the first num_layers layers of depth_texture, which must
+	be bound to depth_unit, for the given mode
+	*/
+	void update(unsigned int depth_unit, unsigned int num_layers, ShadowFilterMode mode)
+	{
+		m_timer->begin();
+		m_shader->use();
+		m_shader->setInt("depth_texture", depth_unit);
+		m_shader->setBool("exponential", mode == SHADOW_FILTER_ESM);
+		m_shader->setFloat("esm_exponent", esm_exponent);
+		m_shader->setInt("size", m_size);
+
+		// horizontally from the depth into the moments, then vertically into the blurred moments
+		m_shader->setBool("from_depth", true);
+		glUniform2i(m_shader->uniformLoc("direction"), 1, 0);
+		glBindImageTexture(1, m_moments, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RG32F);
+		m_shader->dispatch(m_size, m_size, num_layers, 8, 8);
+		glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+		m_shader->setBool("from_depth", false);
+		glUniform2i(m_shader->uniformLoc("direction"), 0, 1);
+		glBindImageTexture(0, m_moments, 0, GL_TRUE, 0, GL_READ_ONLY, GL_RG32F);
+		glBindImageTexture(1, m_blurred, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RG32F);
+		m_shader->dispatch(m_size, m_size, num_layers, 8, 8);
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+		m_timer->end();
+	}
+
+	void bind()
+	{
+		gl_state.bindTexture(texture_unit, GL_TEXTURE_2D_ARRAY, m_blurred);
+	}
+
+	float ms()
+	{
+		return m_timer->ms();
+	}
+
+private:
+	unsigned int m_size;
+	unsigned int m_layers;
+
+	unsigned int m_moments;
+	unsigned int m_blurred;
+
+	ComputeShader* m_shader;
+	GpuTimer* m_timer;
+
+	unsigned int createTexture()
+	{
+		unsigned int texture;
+		glGenTextures(1, &texture);
+		gl_state.bindTexture(texture_unit, GL_TEXTURE_2D_ARRAY, texture);
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RG32F, m_size, m_size, m_layers, 0, GL_RG, GL_FLOAT, NULL);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		return texture;
+	}
+};
\ No newline at end of file
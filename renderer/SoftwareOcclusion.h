@@ -0,0 +1,393 @@
+#pragma once
+#include <glm/glm.hpp>
+
+#include "Bounds.h"
+#include "ThreadPool.h"
+
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SOFTWARE_OCCLUSION_SSE
+#endif
+
+struct OccluderMesh
+{
+	std::vector<glm::vec3> positions;
+	std::vector<unsigned int> indices;
+};
+
+struct SoftwareOcclusionStats
+{
+	unsigned int occluder_triangles = 0;	// triangles submitted
+	unsigned int rasterized_triangles = 0;	// triangles left after clipping and backface culling
+	unsigned int tested = 0;
+	unsigned int culled = 0;
+
+	float raster_ms = 0.0f;
+	float test_ms = 0.0f;
+
+	// millions of submitted triangles per second, including setup
+	float throughput() const
+	{
+		return raster_ms > 0.0f ? occluder_triangles / (raster_ms * 1000.0f) : 0.0f;
+	}
+	float cullRate() const
+	{
+		return tested > 0 ? (float)culled / (float)tested : 0.0f;
+	}
+};
+
+/**
+depth only rasterizer for occlusion culling without reading anything back from the GPU.
+occluders are drawn into a small depth buffer split into tiles that are rasterized in
+parallel, 4 pixels at a time with SSE2. pixels are covered by their center so triangles sharing
+an edge leave no cracks, but store the farthest depth the triangle reaches inside them, and each
+tile keeps the farthest depth of its pixels. an occludee is culled when the nearest point of its
+bounds is behind every pixel around it, one pixel wider than its screen rectangle to make up
+for the coverage rule. the result only depends on the input, not on thread timing.
+*/
+class SoftwareOcclusion
+{
+public:
+	static const int width = 320;
+	static const int height = 180;
+	static const int tile_width = 32;
+	static const int tile_height = 16;
+	static const int tiles_x = (width + tile_width - 1) / tile_width;
+	static const int tiles_y = (height + tile_height - 1) / tile_height;
+
+	// meshes with at most this many triangles may be picked as occluders automatically
+	unsigned int auto_max_triangles = 512;
+	// and their bounds need a diagonal of at least this many world units
+	float auto_min_size = 4.0f;
+
+	SoftwareOcclusionStats stats;
+
+	SoftwareOcclusion()
+	{
+		m_depth.resize(width * height, 1.0f);
+		m_tile_max.resize(tiles_x * tiles_y, 1.0f);
+		m_bins.resize(tiles_x * tiles_y);
+	}
+
+	// alpha tested meshes have holes the rasterizer would fill, they're never picked
+	bool isGoodOccluder(unsigned int num_triangles, const AABB& bounds, bool alpha_tested)
+	{
+		return !alpha_tested && num_triangles > 0 && num_triangles <= auto_max_triangles && glm::length(bounds.max - bounds.min) >= auto_min_size;
+	}
+
+	/**
+	clears the depth buffer, occluders are submitted after this and drawn by rasterize
+	*/
+	void begin(const glm::mat4& view_proj)
+	{
+		m_start = std::chrono::high_resolution_clock::now();
+		m_view_proj = view_proj;
+
+		std::fill(m_depth.begin(), m_depth.end(), 1.0f);
+		std::fill(m_tile_max.begin(), m_tile_max.end(), 1.0f);
+		for (unsigned int i = 0; i < m_bins.size(); ++i)
+			m_bins[i].clear();
+		m_triangles.clear();
+
+		stats.occluder_triangles = 0;
+		stats.tested = 0;
+		stats.culled = 0;
+		stats.test_ms = 0.0f;
+	}
+
+	/**
+	transforms, clips and bins the triangles of one occluder
+	*/
+	void submit(const OccluderMesh& mesh, const glm::mat4& model)
+	{
+		glm::mat4 mvp = m_view_proj * model;
+
+		m_clip.resize(mesh.positions.size());
+		for (unsigned int i = 0; i < mesh.positions.size(); ++i)
+			m_clip[i] = mvp * glm::vec4(mesh.positions[i], 1.0f);
+
+		for (unsigned int i = 0; i + 2 < mesh.indices.size(); i += 3)
+			clipAndSetup(m_clip[mesh.indices[i]], m_clip[mesh.indices[i + 1]], m_clip[mesh.indices[i + 2]]);
+
+		stats.occluder_triangles += mesh.indices.size() / 3;
+	}
+
+	/**
+	rasterizes the binned triangles, one tile per job so no two threads write the same pixel
+	*/
+	void rasterize()
+	{
+		stats.rasterized_triangles = m_triangles.size();
+
+		m_pool.parallelFor(tiles_x * tiles_y, [this](unsigned int tile) { rasterizeTile(tile); });
+
+		auto end = std::chrono::high_resolution_clock::now();
+		stats.raster_ms = std::chrono::duration<float, std::milli>(end - m_start).count();
+	}
+
+	/**
+	tests world space bounds against the depth from the last rasterize call
+	*/
+	bool isVisible(const AABB& world_bounds)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+
+		bool visible = testBounds(world_bounds);
+
+		++stats.tested;
+		if (!visible)
+			++stats.culled;
+
+		auto end = std::chrono::high_resolution_clock::now();
+		stats.test_ms += std::chrono::duration<float, std::milli>(end - start).count();
+
+		return visible;
+	}
+
+	const std::vector<float>& depthBuffer()
+	{
+		return m_depth;
+	}
+
+private:
+	// edge functions and depth plane of a screen space triangle
+	struct Triangle
+	{
+		float edge_a[3];
+		float edge_b[3];
+		float edge_c[3];
+		float z_a, z_b, z_c;
+		float z_max;
+		int min_x, min_y, max_x, max_y;
+	};
+
+	std::vector<glm::vec4> m_clip;
+
+	std::vector<Triangle> m_triangles;
+	std::vector<std::vector<unsigned int>> m_bins;
+
+	std::vector<float> m_depth;
+	std::vector<float> m_tile_max;
+
+	glm::mat4 m_view_proj = glm::mat4(1.0f);
+	std::chrono::high_resolution_clock::time_point m_start;
+
+	ThreadPool m_pool;
+
+	void clipAndSetup(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c)
+	{
+		// clips against the near plane z >= -w, everything else is handled by the screen bounds
+		glm::vec4 in[3] = { a, b, c };
+		glm::vec4 out[4];
+		int count = 0;
+		for (int i = 0; i < 3; ++i)
+		{
+			const glm::vec4& p = in[i];
+			const glm::vec4& q = in[(i + 1) % 3];
+			float dp = p.z + p.w;
+			float dq = q.z + q.w;
+			if (dp >= 0.0f)
+				out[count++] = p;
+			if ((dp >= 0.0f) != (dq >= 0.0f))
+			{
+				float t = dp / (dp - dq);
+				out[count++] = p + (q - p) * t;
+			}
+		}
+		if (count < 3)
+			return;
+
+		glm::vec3 screen[4];
+		for (int i = 0; i < count; ++i)
+		{
+			float w = glm::max(out[i].w, 1e-6f);
+			screen[i] = glm::vec3((out[i].x / w * 0.5f + 0.5f) * width, (out[i].y / w * 0.5f + 0.5f) * height, out[i].z / w * 0.5f + 0.5f);
+		}
+
+		setupTriangle(screen[0], screen[1], screen[2]);
+		if (count == 4)
+			setupTriangle(screen[0], screen[2], screen[3]);
+	}
+
+	void setupTriangle(const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2)
+	{
+		float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+
+		// backfaces and degenerate triangles
+		if (area <= 1e-6f)
+			return;
+
+		Triangle tri;
+		const glm::vec3* v[3] = { &v0, &v1, &v2 };
+		for (int i = 0; i < 3; ++i)
+		{
+			const glm::vec3& p = *v[i];
+			const glm::vec3& q = *v[(i + 1) % 3];
+			float a = -(q.y - p.y);
+			float b = q.x - p.x;
+
+			tri.edge_a[i] = a;
+			tri.edge_b[i] = b;
+			tri.edge_c[i] = -(a * p.x + b * p.y);
+		}
+
+		// depth plane z = z_a * x + z_b * y + z_c, moved to the farthest depth inside each pixel
+		float inv_area = 1.0f / area;
+		float dz1 = v1.z - v0.z;
+		float dz2 = v2.z - v0.z;
+		tri.z_a = (dz1 * (v2.y - v0.y) - dz2 * (v1.y - v0.y)) * inv_area;
+		tri.z_b = (dz2 * (v1.x - v0.x) - dz1 * (v2.x - v0.x)) * inv_area;
+		tri.z_c = v0.z - tri.z_a * v0.x - tri.z_b * v0.y + 0.5f * (std::abs(tri.z_a) + std::abs(tri.z_b));
+		tri.z_max = glm::max(v0.z, glm::max(v1.z, v2.z));
+
+		tri.min_x = glm::max((int)std::floor(glm::min(v0.x, glm::min(v1.x, v2.x))), 0);
+		tri.min_y = glm::max((int)std::floor(glm::min(v0.y, glm::min(v1.y, v2.y))), 0);
+		tri.max_x = glm::min((int)std::ceil(glm::max(v0.x, glm::max(v1.x, v2.x))), width - 1);
+		tri.max_y = glm::min((int)std::ceil(glm::max(v0.y, glm::max(v1.y, v2.y))), height - 1);
+		if (tri.min_x > tri.max_x || tri.min_y > tri.max_y)
+			return;
+
+		unsigned int index = m_triangles.size();
+		m_triangles.push_back(tri);
+
+		for (int ty = tri.min_y / tile_height; ty <= tri.max_y / tile_height; ++ty)
+		{
+			for (int tx = tri.min_x / tile_width; tx <= tri.max_x / tile_width; ++tx)
+				m_bins[ty * tiles_x + tx].push_back(index);
+		}
+	}
+
+	void rasterizeTile(unsigned int tile)
+	{
+		int tile_x = (tile % tiles_x) * tile_width;
+		int tile_y = (tile / tiles_x) * tile_height;
+		int tile_max_x = glm::min(tile_x + tile_width, width) - 1;
+		int tile_max_y = glm::min(tile_y + tile_height, height) - 1;
+
+		const std::vector<unsigned int>& bin = m_bins[tile];
+		for (unsigned int i = 0; i < bin.size(); ++i)
+		{
+			const Triangle& tri = m_triangles[bin[i]];
+
+			// rows start on a multiple of 4 so they line up with the SIMD groups
+			int min_x = glm::max(tri.min_x, tile_x) & ~3;
+			int max_x = glm::min(tri.max_x, tile_max_x);
+			int min_y = glm::max(tri.min_y, tile_y);
+			int max_y = glm::min(tri.max_y, tile_max_y);
+
+			for (int y = min_y; y <= max_y; ++y)
+			{
+				float py = y + 0.5f;
+				float* row = &m_depth[y * width];
+				for (int x = min_x; x <= max_x; x += 4)
+					shadeQuad(tri, row, x, py);
+			}
+		}
+
+		float tile_max = 0.0f;
+		for (int y = tile_y; y <= tile_max_y; ++y)
+		{
+			for (int x = tile_x; x <= tile_max_x; ++x)
+				tile_max = glm::max(tile_max, m_depth[y * width + x]);
+		}
+		m_tile_max[tile] = tile_max;
+	}
+
+	// width is a multiple of 4, so a group of 4 never runs past the end of a row
+	void shadeQuad(const Triangle& tri, float* row, int x, float py)
+	{
+#ifdef SOFTWARE_OCCLUSION_SSE
+		__m128 px = _mm_add_ps(_mm_set1_ps((float)x + 0.5f), _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f));
+		__m128 zero = _mm_setzero_ps();
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (int e = 0; e < 3; ++e)
+		{
+			__m128 value = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(tri.edge_a[e]), px), _mm_set1_ps(tri.edge_b[e] * py + tri.edge_c[e]));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(value, zero));
+		}
+		if (_mm_movemask_ps(inside) == 0)
+			return;
+
+		__m128 z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(tri.z_a), px), _mm_set1_ps(tri.z_b * py + tri.z_c));
+		z = _mm_min_ps(z, _mm_set1_ps(tri.z_max));
+
+		__m128 depth = _mm_loadu_ps(row + x);
+		__m128 closer = _mm_min_ps(depth, z);
+		_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, closer), _mm_andnot_ps(inside, depth)));
+#else
+		for (int i = 0; i < 4; ++i)
+		{
+			float px = x + i + 0.5f;
+			bool inside = true;
+			for (int e = 0; e < 3; ++e)
+				inside = inside && tri.edge_a[e] * px + tri.edge_b[e] * py + tri.edge_c[e] >= 0.0f;
+			if (!inside)
+				continue;
+
+			float z = glm::min(tri.z_a * px + tri.z_b * py + tri.z_c, tri.z_max);
+			row[x + i] = glm::min(row[x + i], z);
+		}
+#endif
+	}
+
+	bool testBounds(const AABB& box)
+	{
+		glm::vec2 screen_min = glm::vec2(1e30f);
+		glm::vec2 screen_max = glm::vec2(-1e30f);
+		float closest = 1.0f;
+		for (int i = 0; i < 8; ++i)
+		{
+			glm::vec3 corner = glm::vec3((i & 1) ? box.max.x : box.min.x, (i & 2) ? box.max.y : box.min.y, (i & 4) ? box.max.z : box.min.z);
+			glm::vec4 clip = m_view_proj * glm::vec4(corner, 1.0f);
+
+			// reaches past the near plane
+			if (clip.z < -clip.w)
+				return true;
+
+			glm::vec3 ndc = glm::vec3(clip) / clip.w;
+			glm::vec2 screen = glm::vec2((ndc.x * 0.5f + 0.5f) * width, (ndc.y * 0.5f + 0.5f) * height);
+			screen_min = glm::min(screen_min, screen);
+			screen_max = glm::max(screen_max, screen);
+			closest = glm::min(closest, ndc.z * 0.5f + 0.5f);
+		}
+
+		int min_x = glm::max((int)std::floor(screen_min.x) - 1, 0);
+		int min_y = glm::max((int)std::floor(screen_min.y) - 1, 0);
+		int max_x = glm::min((int)std::ceil(screen_max.x) + 1, width - 1);
+		int max_y = glm::min((int)std::ceil(screen_max.y) + 1, height - 1);
+
+		// entirely off screen, frustum culling is left to the caller
+		if (min_x > max_x || min_y > max_y)
+			return true;
+
+		for (int ty = min_y / tile_height; ty <= max_y / tile_height; ++ty)
+		{
+			for (int tx = min_x / tile_width; tx <= max_x / tile_width; ++tx)
+			{
+				// the whole tile is in front of the box
+				if (closest > m_tile_max[ty * tiles_x + tx])
+					continue;
+
+				int x0 = glm::max(min_x, tx * tile_width);
+				int x1 = glm::min(max_x, tx * tile_width + tile_width - 1);
+				int y0 = glm::max(min_y, ty * tile_height);
+				int y1 = glm::min(max_y, ty * tile_height + tile_height - 1);
+				for (int y = y0; y <= y1; ++y)
+				{
+					const float* row = &m_depth[y * width];
+					for (int x = x0; x <= x1; ++x)
+					{
+						if (closest <= row[x])
+							return true;
+					}
+				}
+			}
+		}
+		return false;
+	}
+};
\ No newline at end of file
@@ -0,0 +1,195 @@
+#pragma once
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "GLExtensions.h"
+#include "GLState.h"
+#include "GpuTimer.h"
+#include "ComputeShader.h"
+
+#include <algorithm>
+
+/**
+how the frame is antialiased. MSAA draws the scene with 4 samples a pixel and resolves them, TAA draws
+it with one and a jitter that changes every frame, then blends it into the history of the last ones.
+upsampling is TAA drawing fewer pixels than it outputs
+*/
+enum AntiAliasing
+{
+	ANTI_ALIASING_MSAA,
+	ANTI_ALIASING_TAA,
+	ANTI_ALIASING_TAA_UPSAMPLING
+};
+
+const char* antiAliasingName(AntiAliasing mode)
+{
+	const char* names[] = { "4x MSAA", "TAA", "TAA upsampling" };
+	return names[mode];
+}
+
+struct TemporalAAStats
+{
+	unsigned int input_width = 0;	// of the frame that was resolved
+	unsigned int input_height = 0;
+	unsigned int output_width = 0;
+	unsigned int output_height = 0;
+	glm::vec2 jitter = glm::vec2(0.0f);	// of the frame, in its pixels
+	float ms = 0.0f;
+};
+
+/**
+temporal antialiasing and upsampling in one compute pass. the projection is jittered by a sub pixel
+offset from a Halton sequence, and each frame the jittered pixels are filtered into the output's pixel
+centers and blended with the output of the last frame, reprojected with the depth and the motion vectors
+of Renderer::drawVelocity. the history is clipped to the colors around the pixel so what was disoccluded
+or changed doesn't leave trails. the output can be larger than the frame, the jitter then fills in the
+pixels between the frame's over a few frames. needs gl_caps.compute
+*/
+class TemporalAA
+{
+public:
+	static const unsigned int texture_unit = 20;	// the frame's color, its depth, motion vectors and the history at the ones after it
+	static const unsigned int jitter_phases = 8;
+
+	// of the output
+	TemporalAA(unsigned int width, unsigned int height)
+	{
+		m_resolve = new ComputeShader("shaders/TemporalResolveCompute.shader");
+		m_resolve->use();
+		m_resolve->setInt("color", texture_unit);
+		m_resolve->setInt("depth", texture_unit + 1);
+		m_resolve->setInt("velocity", texture_unit + 2);
+		m_resolve->setInt("history", texture_unit + 3);
+		m_resolve->setFloat("blend", blend);
+		m_timer = new GpuTimer();
+
+		resize(width, height);
+	}
+	~TemporalAA()
+	{
+		deleteHistory();
+		delete(m_resolve);
+		delete(m_timer);
+	}
+
+	void resize(unsigned int width, unsigned int height)
+	{
+		deleteHistory();
+		stats.output_width = width;
+		stats.output_height = height;
+
+		glGenTextures(2, m_history);
+		for (unsigned int i = 0; i < 2; ++i)
+		{
+			gl_state.bindTexture(texture_unit + 3, GL_TEXTURE_2D, m_history[i]);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_FLOAT, NULL);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		}
+		reset();
+	}
+
+	// the next frame starts the history again, for when the last ones have nothing to do with it
+	void reset()
+	{
+		m_history_valid = false;
+	}
+
+	/**
+	the projection of the next frame, moved by its jitter. width and height are the frame's, which is what
+	the jitter is a fraction of a pixel of. the unjittered projection is what resolve wants
+	*/
+	glm::mat4 jitter(const glm::mat4& projection, unsigned int width, unsigned int height)
+	{
+		m_phase = (m_phase + 1) % jitter_phases;
+		stats.jitter = glm::vec2(halton(m_phase + 1, 2), halton(m_phase + 1, 3)) - 0.5f;
+
+		glm::vec2 offset = stats.jitter * 2.0f / glm::vec2(width, height);
+		return glm::translate(glm::mat4(1.0f), glm::vec3(offset, 0.0f)) * projection;
+	}
+
+	/**
+	blends the frame into the history. color, depth and velocity are the frame's, single sampled, width by
+	height from the origin of textures that can be larger. view_proj is this frame's without the jitter
+	*/
+	void resolve(unsigned int color, unsigned int depth, unsigned int velocity, unsigned int width, unsigned int height, const glm::mat4& view_proj)
+	{
+		stats.input_width = width;
+		stats.input_height = height;
+
+		m_timer->begin();
+		m_resolve->use();
+		gl_state.bindTexture(texture_unit, GL_TEXTURE_2D, color);
+		gl_state.bindTexture(texture_unit + 1, GL_TEXTURE_2D, depth);
+		gl_state.bindTexture(texture_unit + 2, GL_TEXTURE_2D, velocity);
+		gl_state.bindTexture(texture_unit + 3, GL_TEXTURE_2D, m_history[m_current]);
+
+		// from this frame's clip space to the last one's, for what only the camera moved
+		glm::mat4 reprojection = m_prev_view_proj * glm::inverse(view_proj);
+		m_resolve->setMat4("reprojection", reprojection);
+		glUniform2i(m_resolve->uniformLoc("input_size"), width, height);
+		glUniform2i(m_resolve->uniformLoc("output_size"), stats.output_width, stats.output_height);
+		m_resolve->setVec2("jitter", stats.jitter);
+		m_resolve->setBool("history_valid", m_history_valid);
+
+		m_current = 1 - m_current;
+		glBindImageTexture(0, m_history[m_current], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+		m_resolve->dispatch(stats.output_width, stats.output_height, 1, 8, 8);
+		// what reads the output samples it
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+		m_timer->end();
+
+		m_prev_view_proj = view_proj;
+		m_history_valid = true;
+		stats.ms = m_timer->ms();
+	}
+
+	// the last resolve's, it's next frame's history
+	unsigned int output()
+	{
+		return m_history[m_current];
+	}
+
+	TemporalAAStats stats;
+
+private:
+	// of the frame in the output, the rest is the history
+	static constexpr float blend = 0.1f;
+
+	ComputeShader* m_resolve;
+	GpuTimer* m_timer;
+
+	unsigned int m_history[2] = { 0, 0 };
+	unsigned int m_current = 0;
+	bool m_history_valid = false;
+	glm::mat4 m_prev_view_proj = glm::mat4(1.0f);
+	unsigned int m_phase = 0;
+
+	static float halton(unsigned int index, unsigned int base)
+	{
+		float result = 0.0f;
+		float fraction = 1.0f;
+		while (index > 0)
+		{
+			fraction /= base;
+			result += fraction * (index % base);
+			index /= base;
+		}
+		return result;
+	}
+
+	void deleteHistory()
+	{
+		if (!m_history[0])
+			return;
+		glDeleteTextures(2, m_history);
+		gl_state.forgetTexture(m_history[0]);
+		gl_state.forgetTexture(m_history[1]);
+		m_history[0] = 0;
+		m_history[1] = 0;
+	}
+};
\ No newline at end of file
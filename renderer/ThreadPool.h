@@ -0,0 +1,128 @@
+#pragma once
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <vector>
+
+#include "CpuProfiler.h"
+
+/**
+a fixed set of worker threads for splitting a loop into independent jobs.
+the calling thread works on the jobs too and parallelFor returns once all of them are done
+*/
+class ThreadPool
+{
+public:
+	ThreadPool(unsigned int num_threads = 0)
+	{
+		if (num_threads == 0)
+		{
+			unsigned int hardware = std::thread::hardware_concurrency();
+			num_threads = hardware > 1 ? hardware - 1 : 0;
+		}
+
+		m_threads.reserve(num_threads);
+		for (unsigned int i = 0; i < num_threads; ++i)
+			m_threads.emplace_back([this]() { workerLoop(); });
+	}
+	~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_quit = true;
+		}
+		m_wake.notify_all();
+		for (unsigned int i = 0; i < m_threads.size(); ++i)
+			m_threads[i].join();
+	}
+
+	unsigned int numThreads()
+	{
+		return m_threads.size() + 1;
+	}
+
+	/**
+	calls job(i) for every i in [0, count), spread across the workers and the calling thread
+	*/
+	void parallelFor(unsigned int count, const std::function<void(unsigned int)>& job)
+	{
+		if (count == 0)
+			return;
+
+		if (m_threads.empty() || count == 1)
+		{
+			for (unsigned int i = 0; i < count; ++i)
+				job(i);
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_job = &job;
+			m_job_count = count;
+			m_next_job = 0;
+			m_active_workers = m_threads.size();
+			++m_generation;
+		}
+		m_wake.notify_all();
+
+		runJobs(job, count);
+
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_done.wait(lock, [this]() { return m_active_workers == 0; });
+		m_job = nullptr;
+	}
+
+private:
+	std::vector<std::thread> m_threads;
+
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::condition_variable m_done;
+
+	const std::function<void(unsigned int)>* m_job = nullptr;
+	unsigned int m_job_count = 0;
+	std::atomic<unsigned int> m_next_job{ 0 };
+	unsigned int m_active_workers = 0;
+	unsigned int m_generation = 0;
+	bool m_quit = false;
+
+	void runJobs(const std::function<void(unsigned int)>& job, unsigned int count)
+	{
+		CPU_ZONE("ThreadPool::runJobs");
+		unsigned int i;
+		while ((i = m_next_job.fetch_add(1)) < count)
+			job(i);
+	}
+
+	void workerLoop()
+	{
+		CPU_THREAD("thread pool worker");
+		unsigned int seen_generation = 0;
+		while (true)
+		{
+			const std::function<void(unsigned int)>* job;
+			unsigned int count;
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_wake.wait(lock, [&]() { return m_quit || m_generation != seen_generation; });
+				if (m_quit)
+					return;
+
+				seen_generation = m_generation;
+				job = m_job;
+				count = m_job_count;
+			}
+
+			runJobs(*job, count);
+
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				--m_active_workers;
+			}
+			m_done.notify_one();
+		}
+	}
+};
\ No newline at end of file
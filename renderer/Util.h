@@ -9,10 +9,17 @@
 
 #include "stb_image.h"
 
+#include "GLState.h"
+#include "CpuProfiler.h"
+
 #define print(x) std::cout << x << std::endl
 
-unsigned int TextureFromFile(const char* path, const std::string& directory, bool linearize, unsigned int texture_type = GL_TEXTURE_2D)
+/**
+has_cutout, if given, is set to whether any texel's alpha is below the 0.1 the shaders discard at
+*/
+unsigned int TextureFromFile(const char* path, const std::string& directory, bool linearize, unsigned int texture_type = GL_TEXTURE_2D, bool* has_cutout = nullptr)
 {
+	CPU_ZONE("TextureFromFile");
 	stbi_set_flip_vertically_on_load(true);
 
 	std::string filename = std::string(path);
@@ -53,18 +60,22 @@ unsigned int TextureFromFile(const char* path, const std::string& directory, boo
 			format = GL_RGBA;
 		}
 
-		glBindTexture(texture_type, textureID);
+		gl_state.bindTexture(0, texture_type, textureID);
 		glTexImage2D(texture_type, 0, source_format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
 		glGenerateMipmap(texture_type);
 
-		glEnable(GL_BLEND);
-		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
 		glTexParameteri(texture_type, GL_TEXTURE_WRAP_S, GL_REPEAT);
 		glTexParameteri(texture_type, GL_TEXTURE_WRAP_T, GL_REPEAT);
 		glTexParameteri(texture_type, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 		glTexParameteri(texture_type, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
+		if (has_cutout)
+		{
+			*has_cutout = false;
+			for (int i = 0; num_components == 4 && i < width * height && !*has_cutout; ++i)
+				*has_cutout = data[i * 4 + 3] < 26;
+		}
+
 		stbi_image_free(data);
 	}
 	else
@@ -80,7 +91,7 @@ unsigned int CubemapFromFile(std::vector<std::string>& faces, const std::string&
 
 	unsigned int textureID;
 	glGenTextures(1, &textureID);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+	gl_state.bindTexture(0, GL_TEXTURE_CUBE_MAP, textureID);
 
 	int width, height, num_channels;
 
@@ -210,50 +221,47 @@ float randFloat(float min, float max)
 	float r = (float)(rand()) / (float)(RAND_MAX);
 	return min + (max - min) * r;
 }
-unsigned int createFrameBuffer(bool multi_sample, unsigned int* frame_texture, unsigned int width, unsigned int height)
+// internal_format is of the color texture, GL_R11F_G11F_B10F keeps the range of an HDR frame at 32 bits a pixel
+unsigned int createFrameBuffer(bool multi_sample, unsigned int* frame_texture, unsigned int width, unsigned int height, unsigned int internal_format = GL_RGB)
 {
 	unsigned int fbo;
 	glGenFramebuffers(1, &fbo);
 
-	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	gl_state.bindFramebuffer(GL_FRAMEBUFFER, fbo);
 
 	glGenTextures(1, frame_texture);
 	if (multi_sample)
 	{
-		glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, *frame_texture);
+		gl_state.bindTexture(0, GL_TEXTURE_2D_MULTISAMPLE, *frame_texture);
 
-		glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, 4, GL_RGB, width, height, GL_TRUE);
+		// multisampled textures have no sampler state
+		glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, 4, internal_format, width, height, GL_TRUE);
 
-		glTexParameteri(GL_TEXTURE_2D_MULTISAMPLE, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D_MULTISAMPLE, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-		glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, 0);
+		gl_state.bindTexture(0, GL_TEXTURE_2D_MULTISAMPLE, 0);
 
 		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D_MULTISAMPLE, *frame_texture, 0);
 	}
 	else
 	{
-		glBindTexture(GL_TEXTURE_2D, *frame_texture);
+		gl_state.bindTexture(0, GL_TEXTURE_2D, *frame_texture);
 
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+		glTexImage2D(GL_TEXTURE_2D, 0, internal_format, width, height, 0, GL_RGB, GL_FLOAT, NULL);
 
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-		glBindTexture(GL_TEXTURE_2D, 0);
+		gl_state.bindTexture(0, GL_TEXTURE_2D, 0);
 
 		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, *frame_texture, 0);
 	}
 
 	if (multi_sample)
 	{
+		// deleted with the framebuffer by deleteFrameBuffer
 		unsigned int rbo;
 		glGenRenderbuffers(1, &rbo);
 		glBindRenderbuffer(GL_RENDERBUFFER, rbo);
-		if (multi_sample)
-			glRenderbufferStorageMultisample(GL_RENDERBUFFER, 4, GL_DEPTH24_STENCIL8, width, height);
-		else
-			glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+		glRenderbufferStorageMultisample(GL_RENDERBUFFER, 4, GL_DEPTH24_STENCIL8, width, height);
 		glBindRenderbuffer(GL_RENDERBUFFER, 0);
 
 		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, rbo);
@@ -263,68 +271,29 @@ unsigned int createFrameBuffer(bool multi_sample, unsigned int* frame_texture, u
 	{
 		std::cout << "ERROR::FRAMEBUFFER:: Framebuffer is not complete!" << std::endl;
 	}
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	gl_state.bindFramebuffer(GL_FRAMEBUFFER, 0);
 
 	return fbo;
 }
-unsigned int createDirectionalDepthMapBuffer(unsigned int* depth_map_texture, unsigned int width, unsigned int height)
+// deletes a framebuffer from createFrameBuffer with its color texture and depth renderbuffer
+void deleteFrameBuffer(unsigned int fbo)
 {
-	unsigned int fbo;
-	glGenFramebuffers(1, &fbo);
-
-	glGenTextures(1, depth_map_texture);
-	glBindTexture(GL_TEXTURE_2D, *depth_map_texture);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-	float border_color[] = { 1.0f, 1.0f, 1.0f, 1.0f };
-	glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, border_color);
-
-	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, *depth_map_texture, 0);
-	glDrawBuffer(GL_NONE);
-	glReadBuffer(GL_NONE);
-
-	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-	{
-		std::cout << "ERROR::FRAMEBUFFER:: Depth Framebuffer is not complete!" << std::endl;
-	}
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-	return fbo;
-}
-unsigned int createOmnidirectionalDepthMapBuffer(unsigned int* depth_cubemap_texture, unsigned int size)
-{
-	unsigned int fbo;
-	glGenFramebuffers(1, &fbo);
-
-	glGenTextures(1, depth_cubemap_texture);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, *depth_cubemap_texture);
-	for (unsigned int i = 0; i < 6; ++i)
-		glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_DEPTH_COMPONENT, size, size, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
-
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-
-	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-	glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, *depth_cubemap_texture, 0);
-	glDrawBuffer(GL_NONE);
-	glReadBuffer(GL_NONE);
-
-	print("framebuffer errors: " << glGetError());
-
-	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-	{
-		std::cout << "ERROR::FRAMEBUFFER:: Depth Framebuffer is not complete!" << std::endl;
-	}
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-	return fbo;
+	gl_state.bindFramebuffer(GL_FRAMEBUFFER, fbo);
+	int color_texture = 0;
+	int depth_type = GL_NONE;
+	int depth_renderbuffer = 0;
+	glGetFramebufferAttachmentParameteriv(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_FRAMEBUFFER_ATTACHMENT_OBJECT_NAME, &color_texture);
+	glGetFramebufferAttachmentParameteriv(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_FRAMEBUFFER_ATTACHMENT_OBJECT_TYPE, &depth_type);
+	if (depth_type == GL_RENDERBUFFER)
+		glGetFramebufferAttachmentParameteriv(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_FRAMEBUFFER_ATTACHMENT_OBJECT_NAME, &depth_renderbuffer);
+	gl_state.bindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	glDeleteFramebuffers(1, &fbo);
+	unsigned int texture = color_texture;
+	glDeleteTextures(1, &texture);
+	gl_state.forgetTexture(texture);
+	unsigned int rbo = depth_renderbuffer;
+	glDeleteRenderbuffers(1, &rbo);
 }
 int MAX(int a, int b)
 {
@@ -0,0 +1,112 @@
+#version 430 core
+layout(local_size_x = 8, local_size_y = 8) in;
+
+// one level of the bloom mip chain, see Bloom.h. BLOOM_DOWN filters the level above into dst,
+// BLOOM_PREFILTER when it's the full resolution frame, otherwise it's BLOOM_UP, which adds the
+// level below to what the downsample left in dst
+
+uniform sampler2D src;
+uniform float src_lod;
+
+#ifdef BLOOM_DOWN
+layout(r11f_g11f_b10f, binding = 0) writeonly uniform image2D dst;
+#else
+layout(r11f_g11f_b10f, binding = 0) uniform image2D dst;
+#endif
+
+uniform ivec2 dst_size;
+// luminance below which nothing blooms, 0 for all of it
+uniform float threshold;
+// of the upsampling tent, in texels of src
+uniform float radius;
+// of the result, to average the levels added up in the last upsample
+uniform float scale;
+// the part of each level the frame is in, from the origin, below 1 when it was drawn at a lower resolution
+uniform vec2 frame_scale;
+// the last texel center inside the frame in src
+vec2 src_uv_max;
+
+float luminance(vec3 color)
+{
+	return dot(color, vec3(0.2126, 0.7152, 0.0722));
+}
+
+vec3 tap(vec2 uv, vec2 texel, float x, float y)
+{
+	return textureLod(src, min(uv + vec2(x, y) * texel, src_uv_max), src_lod).rgb;
+}
+
+#ifdef BLOOM_PREFILTER
+// weights a group of taps by the inverse of its brightness, so single bright pixels don't flicker
+vec3 karisAverage(vec3 a, vec3 b, vec3 c, vec3 d)
+{
+	vec4 sum = vec4(0.0);
+	sum += vec4(a, 1.0) / (1.0 + luminance(a));
+	sum += vec4(b, 1.0) / (1.0 + luminance(b));
+	sum += vec4(c, 1.0) / (1.0 + luminance(c));
+	sum += vec4(d, 1.0) / (1.0 + luminance(d));
+	return sum.rgb / sum.a;
+}
+#endif
+
+#ifdef BLOOM_DOWN
+vec3 downsample(vec2 uv, vec2 texel)
+{
+	// 13 taps as five overlapping 2x2 boxes, each tap bilinear
+	vec3 a = tap(uv, texel, -2.0, 2.0);
+	vec3 b = tap(uv, texel, 0.0, 2.0);
+	vec3 c = tap(uv, texel, 2.0, 2.0);
+	vec3 d = tap(uv, texel, -2.0, 0.0);
+	vec3 e = tap(uv, texel, 0.0, 0.0);
+	vec3 f = tap(uv, texel, 2.0, 0.0);
+	vec3 g = tap(uv, texel, -2.0, -2.0);
+	vec3 h = tap(uv, texel, 0.0, -2.0);
+	vec3 i = tap(uv, texel, 2.0, -2.0);
+	vec3 j = tap(uv, texel, -1.0, 1.0);
+	vec3 k = tap(uv, texel, 1.0, 1.0);
+	vec3 l = tap(uv, texel, -1.0, -1.0);
+	vec3 m = tap(uv, texel, 1.0, -1.0);
+
+#ifdef BLOOM_PREFILTER
+	vec3 color = karisAverage(j, k, l, m) * 0.5;
+	color += karisAverage(a, b, d, e) * 0.125;
+	color += karisAverage(b, c, e, f) * 0.125;
+	color += karisAverage(d, e, g, h) * 0.125;
+	color += karisAverage(e, f, h, i) * 0.125;
+	float bright = luminance(color);
+	return color * max(bright - threshold, 0.0) / max(bright, 1e-4);
+#else
+	vec3 color = (j + k + l + m) * 0.125;
+	color += (b + d + f + h) * 0.0625;
+	color += (a + c + g + i) * 0.03125;
+	color += e * 0.125;
+	return color;
+#endif
+}
+#else
+vec3 upsample(vec2 uv, vec2 texel)
+{
+	// 3x3 tent
+	vec3 color = tap(uv, texel, 0.0, 0.0) * 4.0;
+	color += (tap(uv, texel, -1.0, 0.0) + tap(uv, texel, 1.0, 0.0) + tap(uv, texel, 0.0, -1.0) + tap(uv, texel, 0.0, 1.0)) * 2.0;
+	color += tap(uv, texel, -1.0, -1.0) + tap(uv, texel, 1.0, -1.0) + tap(uv, texel, -1.0, 1.0) + tap(uv, texel, 1.0, 1.0);
+	return color / 16.0;
+}
+#endif
+
+void main()
+{
+	ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+	if (texel.x >= dst_size.x || texel.y >= dst_size.y)
+		return;
+
+	vec2 uv = (vec2(texel) + 0.5) / vec2(dst_size);
+	vec2 src_texel = 1.0 / vec2(textureSize(src, int(src_lod)));
+	src_uv_max = frame_scale - 0.5 * src_texel;
+#ifdef BLOOM_DOWN
+	vec3 color = downsample(uv, src_texel);
+#else
+	vec3 color = imageLoad(dst, texel).rgb + upsample(uv, src_texel * radius);
+#endif
+	imageStore(dst, texel, vec4(color * scale, 1.0));
+}
\ No newline at end of file
@@ -0,0 +1,38 @@
+#version 420 core
+// draws every triangle into each cascade's layer, so the casters are only submitted once
+layout(triangles, invocations = 4) in;
+layout(triangle_strip, max_vertices = 3) out;
+
+layout(std140, binding = 4) uniform Cascades
+{
+	mat4 cascade_view_projection[4];
+	vec4 cascade_splits;
+	ivec4 cascade_params;
+};
+
+void main()
+{
+	if (gl_InvocationID >= cascade_params.x)
+		return;
+
+	vec4 positions[3];
+	for (int i = 0; i < 3; ++i)
+		positions[i] = cascade_view_projection[gl_InvocationID] * gl_in[i].gl_Position;
+
+	// skip the cascades the triangle is entirely outside of
+	for (int axis = 0; axis < 2; ++axis)
+	{
+		if (positions[0][axis] > 1.0 && positions[1][axis] > 1.0 && positions[2][axis] > 1.0)
+			return;
+		if (positions[0][axis] < -1.0 && positions[1][axis] < -1.0 && positions[2][axis] < -1.0)
+			return;
+	}
+
+	for (int i = 0; i < 3; ++i)
+	{
+		gl_Layer = gl_InvocationID;
+		gl_Position = positions[i];
+		EmitVertex();
+	}
+	EndPrimitive();
+}
\ No newline at end of file
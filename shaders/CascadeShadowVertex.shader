@@ -3,6 +3,7 @@ layout(location = 0) in vec3 aPos;
 
 uniform mat4 model;
 
+// world space, the geometry shader projects it into each cascade
 void main()
 {
 	gl_Position = model * vec4(aPos, 1.0);
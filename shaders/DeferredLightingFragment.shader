@@ -0,0 +1,77 @@
+#version 420 core
+// lights the G-buffer written by GBufferFragment.shader. the lighting is Fragment.shader's from
+// Lighting.shader, the surface is read back from the G-buffer instead of interpolated
+
+layout(std140, binding = 0) uniform Matrices
+{
+	mat4 view;
+	mat4 projection;
+};
+
+// the G-buffer, read with texelFetch so it must be the size of the target
+uniform sampler2D g_albedo_specular;
+uniform sampler2D g_normal_shininess;
+uniform sampler2D g_depth;
+
+uniform mat4 inv_view_projection;
+uniform vec3 viewPos;
+// the part of the G-buffer the frame is in, from its origin
+uniform vec2 viewport_size;
+
+out vec4 FragColor;
+
+// what Fragment.shader gets from its material, filled from the G-buffer
+struct Surface {
+	vec3 specular;
+	float shininess;
+};
+Surface material;
+
+vec3 decodeNormal(vec2 e)
+{
+	e = e * 2.0 - 1.0;
+	vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+	float t = clamp(-n.z, 0.0, 1.0);
+	n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+	return normalize(n);
+}
+
+#include "Lighting.shader"
+
+void main()
+{
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	float depth = texelFetch(g_depth, pixel, 0).x;
+
+	// nothing was drawn here, the skybox stays
+	if (depth == 1.0)
+		discard;
+
+	vec4 albedo_specular = texelFetch(g_albedo_specular, pixel, 0);
+	vec4 normal_shininess = texelFetch(g_normal_shininess, pixel, 0);
+
+	// position from depth
+	vec2 ndc = (vec2(pixel) + 0.5) / viewport_size * 2.0 - 1.0;
+	vec4 world = inv_view_projection * vec4(ndc, depth * 2.0 - 1.0, 1.0);
+	vec3 FragPos = world.xyz / world.w;
+
+	material.specular = vec3(albedo_specular.w);
+	material.shininess = normal_shininess.z * 256.0;
+
+	vec3 norm = decodeNormal(normal_shininess.xy);
+	vec3 viewDir = normalize(viewPos - FragPos);
+
+	vec3 result = vec3(0.0);
+#if DIR_LIGHT
+	result += calcDirLight(dirlight, norm, FragPos, viewDir);
+#endif
+#if POINT_LIGHTS || SPOT_LIGHTS
+	result += calcClusterLights(norm, FragPos, viewDir);
+#endif
+	result *= albedo_specular.xyz;
+
+	FragColor = vec4(result, 1.0);
+
+	// later forward passes depth test against the opaque geometry
+	gl_FragDepth = depth;
+}
\ No newline at end of file
@@ -0,0 +1,23 @@
+#version 420 core
+#ifndef ALPHA_TEST
+#define ALPHA_TEST 1
+#endif
+
+#if ALPHA_TEST
+struct Material {
+	sampler2D diffuse1;
+};
+
+in vec2 TexCoord;
+
+uniform Material material;
+#endif
+
+// writes depth only, cut outs are discarded the same way Fragment.shader does
+void main()
+{
+#if ALPHA_TEST
+	if (texture(material.diffuse1, TexCoord).w < 0.1)
+		discard;
+#endif
+}
\ No newline at end of file
@@ -0,0 +1,32 @@
+#version 420 core
+// see ShaderFeature in ShaderVariants.h, without ALPHA_TEST only the position stream is read
+#ifndef ALPHA_TEST
+#define ALPHA_TEST 1
+#endif
+
+layout(location = 0) in vec3 aPos;
+#if ALPHA_TEST
+layout(location = 2) in vec2 aTexCoord;
+
+out vec2 TexCoord;
+#endif
+
+uniform mat4 model;
+
+layout(std140, binding = 0) uniform Matrices
+{
+	mat4 view;
+	mat4 projection;
+};
+
+// must match Vertex.shader exactly so the main pass can test with GL_EQUAL
+invariant gl_Position;
+
+void main()
+{
+	vec4 pmodel = model * vec4(aPos, 1.0);
+	gl_Position = projection * view * pmodel;
+#if ALPHA_TEST
+	TexCoord = aTexCoord;
+#endif
+}
\ No newline at end of file
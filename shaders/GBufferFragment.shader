@@ -0,0 +1,47 @@
+#version 420 core
+#ifndef ALPHA_TEST
+#define ALPHA_TEST 1
+#endif
+
+struct Material {
+	sampler2D diffuse1;
+	sampler2D specular1;
+	sampler2D normal1;
+
+	vec3 specular;
+	float shininess;
+};
+
+layout(location = 0) out vec4 gAlbedoSpecular;
+layout(location = 1) out vec4 gNormalShininess;
+
+in vec2 TexCoord;
+in vec3 Normal;
+
+uniform Material material;
+
+// octahedral normal encoding, the unit sphere is folded onto the [0, 1] square
+vec2 octWrap(vec2 v)
+{
+	return (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+vec2 encodeNormal(vec3 n)
+{
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+	n.xy = n.z >= 0.0 ? n.xy : octWrap(n.xy);
+	return n.xy * 0.5 + 0.5;
+}
+
+// writes the surface for DeferredLightingFragment.shader to light
+void main()
+{
+	vec4 textureColor = texture(material.diffuse1, TexCoord);
+#if ALPHA_TEST
+	if (textureColor.w < 0.1)
+		discard;
+#endif
+
+	// the specular color is stored as its average
+	gAlbedoSpecular = vec4(textureColor.xyz, dot(material.specular, vec3(1.0 / 3.0)));
+	gNormalShininess = vec4(encodeNormal(normalize(Normal)), clamp(material.shininess / 256.0, 0.0, 1.0), 0.0);
+}
\ No newline at end of file
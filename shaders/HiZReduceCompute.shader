@@ -0,0 +1,37 @@
+#version 430 core
+layout(local_size_x = 8, local_size_y = 8) in;
+
+// builds one level of the depth pyramid, each texel holds the farthest depth it covers
+uniform bool from_depth;
+uniform sampler2D depth_texture;
+layout(r32f, binding = 0) readonly uniform image2D src_level;
+layout(r32f, binding = 1) writeonly uniform image2D dst_level;
+
+uniform ivec2 src_size;
+uniform ivec2 dst_size;
+
+void main()
+{
+	ivec2 dst = ivec2(gl_GlobalInvocationID.xy);
+	if (dst.x >= dst_size.x || dst.y >= dst_size.y)
+		return;
+
+	// texels of the source covered by this texel, rounded outwards so nothing is skipped
+	ivec2 begin = (dst * src_size) / dst_size;
+	ivec2 end = max(((dst + 1) * src_size + dst_size - 1) / dst_size, begin + 1);
+	end = min(end, src_size);
+
+	float depth = 0.0;
+	for (int y = begin.y; y < end.y; ++y)
+	{
+		for (int x = begin.x; x < end.x; ++x)
+		{
+			if (from_depth)
+				depth = max(depth, texelFetch(depth_texture, ivec2(x, y), 0).r);
+			else
+				depth = max(depth, imageLoad(src_level, ivec2(x, y)).r);
+		}
+	}
+
+	imageStore(dst_level, dst, vec4(depth));
+}
@@ -0,0 +1,63 @@
+#version 430 core
+layout(local_size_x = 64) in;
+
+struct DrawCommand {
+	uint count;
+	uint instance_count;
+	uint first_index;
+	uint base_vertex;
+	uint base_instance;
+};
+
+layout(std430, binding = 0) readonly buffer Instances
+{
+	mat4 instances[];
+};
+layout(std430, binding = 1) writeonly buffer VisibleInstances
+{
+	mat4 visible[];
+};
+layout(std430, binding = 2) buffer Commands
+{
+	DrawCommand commands[];
+};
+
+uniform uint num_instances;
+uniform uint num_commands;
+
+// object space bounding sphere shared by every instance
+uniform vec3 bounds_center;
+uniform float bounds_radius;
+
+uniform vec4 frustum_planes[6];
+uniform vec3 view_pos;
+uniform float max_distance;
+
+void main()
+{
+	uint id = gl_GlobalInvocationID.x;
+	if (id >= num_instances)
+		return;
+
+	mat4 model = instances[id];
+
+	vec3 center = vec3(model * vec4(bounds_center, 1.0));
+	float scale = max(length(model[0].xyz), max(length(model[1].xyz), length(model[2].xyz)));
+	float radius = bounds_radius * scale;
+
+	if (distance(center, view_pos) - radius > max_distance)
+		return;
+
+	for (int i = 0; i < 6; ++i)
+	{
+		if (dot(frustum_planes[i].xyz, center) + frustum_planes[i].w < -radius)
+			return;
+	}
+
+	// every mesh of the model draws the same instances, so all commands are bumped together
+	uint slot = atomicAdd(commands[0].instance_count, 1u);
+	for (uint i = 1u; i < num_commands; ++i)
+		atomicAdd(commands[i].instance_count, 1u);
+
+	visible[slot] = model;
+}
\ No newline at end of file
@@ -0,0 +1,322 @@
+// the lighting Fragment.shader and DeferredLightingFragment.shader share, put in by ShaderCache where they
+// #include it. the includer declares the Matrices block and a material with specular and shininess first
+#ifndef DIR_LIGHT
+#define DIR_LIGHT 1
+#endif
+#ifndef DIR_SHADOWS
+#define DIR_SHADOWS 1
+#endif
+#ifndef POINT_LIGHTS
+#define POINT_LIGHTS 1
+#endif
+#ifndef POINT_SHADOWS
+#define POINT_SHADOWS 1
+#endif
+#ifndef SPOT_LIGHTS
+#define SPOT_LIGHTS 1
+#endif
+#ifndef SPOT_SHADOWS
+#define SPOT_SHADOWS 1
+#endif
+
+// the directional light lives in a uniform buffer shared by every program, laid out to match
+// DirLightData in Light.h. vec3s are stored as vec4s to keep std140 simple
+struct DirLight {
+	vec4 direction;
+
+	vec4 ambient;
+	vec4 diffuse;
+	vec4 specular;
+
+	int shadow_view;	// 0 when the light has cascaded shadows, -1 without
+};
+layout(std140, binding = 1) uniform Lights
+{
+	DirLight dirlight;
+};
+
+// point and spot lights are assigned to view space clusters, see ClusteredLights.h
+layout(std140, binding = 2) uniform Clusters
+{
+	uvec4 cluster_dims;		// clusters in x, y and z, number of lights
+	vec4 cluster_params;	// tiles per pixel in x and y, depth slice scale and bias
+	ivec4 cluster_flags;	// x is 0 to loop over every light instead
+};
+
+// 5 texels per light, laid out like ClusterLightData
+uniform samplerBuffer cluster_lights;
+// (offset, count) into cluster_indices for each cluster
+uniform usamplerBuffer cluster_grid;
+uniform usamplerBuffer cluster_indices;
+
+// every shadow map is a tile of the shadow atlas, see ShadowAtlas.h
+struct ShadowView {
+	mat4 view_projection;
+	vec4 rect;		// offset and scale from the view's uv to the atlas' uv
+	vec4 params;	// layer, texel size in atlas uv, depth bias
+};
+layout(std140, binding = 3) uniform Shadows
+{
+	ShadowView shadow_views[64];
+};
+
+// the directional light's cascades, see CascadedShadows.h
+layout(std140, binding = 4) uniform Cascades
+{
+	mat4 cascade_view_projection[4];
+	vec4 cascade_splits;	// view depth where each cascade ends
+	ivec4 cascade_params;	// x is the number of cascades
+};
+
+// samplers can't be part of a uniform block
+uniform sampler2DArray shadow_atlas;
+uniform sampler2DArray cascade_shadow_map;
+// the same depth through comparison samplers, and the cascades' blurred moments for VSM and ESM
+uniform sampler2DArrayShadow shadow_atlas_compare;
+uniform sampler2DArrayShadow cascade_shadow_compare;
+uniform sampler2DArray cascade_moments;
+
+// see ShadowFilterMode in ShadowFilter.h
+const int SHADOW_FILTER_PCF = 0;
+const int SHADOW_FILTER_HARDWARE = 1;
+const int SHADOW_FILTER_POISSON = 2;
+const int SHADOW_FILTER_VSM = 3;
+const int SHADOW_FILTER_ESM = 4;
+uniform int shadow_filter;
+
+// must match ShadowMoments::esm_exponent
+const float esm_exponent = 80.0;
+
+const vec2 poisson_disk[8] = vec2[](
+	vec2(-0.326, -0.406), vec2(-0.840, -0.074), vec2(-0.696, 0.457), vec2(-0.203, 0.621),
+	vec2(0.962, -0.195), vec2(0.473, -0.480), vec2(0.519, 0.767), vec2(0.185, -0.893)
+);
+
+// depth test of world_pos against one view of the shadow atlas, filtered with 3x3 samples kept inside the view's tile
+/**
+compares depth against the layer of the shadow map around uv the way shadow_filter says,
+VSM and ESM need moments and are left to momentShadow. no sample is taken outside of uv_min and uv_max
+*/
+float filterShadow(sampler2DArray depth_map, sampler2DArrayShadow compare_map, vec2 uv, float layer, float depth, vec2 texel, vec2 uv_min, vec2 uv_max)
+{
+	float shadow = 0.0;
+	if (shadow_filter == SHADOW_FILTER_POISSON)
+	{
+		for (int i = 0; i < 8; ++i)
+			shadow += texture(compare_map, vec4(clamp(uv + poisson_disk[i] * 1.5 * texel, uv_min, uv_max), layer, depth));
+		return shadow / 8.0;
+	}
+	if (shadow_filter != SHADOW_FILTER_PCF)
+	{
+		// four bilinear comparisons half a texel around uv cover the same 3x3 texels as the manual filter
+		for (int i = 0; i < 4; ++i)
+		{
+			vec2 offset = vec2((i & 1) == 0 ? -0.5 : 0.5, i < 2 ? -0.5 : 0.5);
+			shadow += texture(compare_map, vec4(clamp(uv + offset * texel, uv_min, uv_max), layer, depth));
+		}
+		return shadow / 4.0;
+	}
+
+	for (int y = -1; y <= 1; ++y)
+	{
+		for (int x = -1; x <= 1; ++x)
+		{
+			vec2 sample_uv = clamp(uv + vec2(x, y) * texel, uv_min, uv_max);
+			float closest_depth = texture(depth_map, vec3(sample_uv, layer)).r;
+			shadow += depth > closest_depth ? 0.0 : 1.0;
+		}
+	}
+	return shadow / 9.0;
+}
+// VSM and ESM from the cascades' blurred moments, one filtered fetch
+float momentShadow(vec2 uv, float layer, float depth)
+{
+	vec2 moments = texture(cascade_moments, vec3(uv, layer)).xy;
+	if (shadow_filter == SHADOW_FILTER_ESM)
+		return clamp(exp(-esm_exponent * depth) * moments.x, 0.0, 1.0);
+
+	if (depth <= moments.x)
+		return 1.0;
+
+	// chebyshev's upper bound, with its tail cut off so less light bleeds through overlapping casters
+	float variance = max(moments.y - moments.x * moments.x, 0.00002);
+	float d = depth - moments.x;
+	float p_max = variance / (variance + d * d);
+	return clamp((p_max - 0.3) / 0.7, 0.0, 1.0);
+}
+float atlasShadow(int view_index, vec3 world_pos)
+{
+	ShadowView shadow_view = shadow_views[view_index];
+
+	vec4 light_space = shadow_view.view_projection * vec4(world_pos, 1.0);
+	vec3 proj_coords = light_space.xyz / light_space.w * 0.5 + 0.5;
+
+	// outside of what the view covers is lit
+	if (light_space.w <= 0.0 || proj_coords.z > 1.0 || any(lessThan(proj_coords.xy, vec2(0.0))) || any(greaterThan(proj_coords.xy, vec2(1.0))))
+		return 1.0;
+
+	float texel = shadow_view.params.y;
+	vec2 uv = shadow_view.rect.xy + proj_coords.xy * shadow_view.rect.zw;
+	vec2 uv_min = shadow_view.rect.xy + 0.5 * texel;
+	vec2 uv_max = shadow_view.rect.xy + shadow_view.rect.zw - 0.5 * texel;
+
+	float current_depth = proj_coords.z - shadow_view.params.z;
+	return filterShadow(shadow_atlas, shadow_atlas_compare, uv, shadow_view.params.x, current_depth, vec2(texel), uv_min, uv_max);
+}
+
+// the directional light's shadow, from the cascade the fragment's view depth falls in
+float cascadeShadow(vec3 world_pos)
+{
+	float depth = -(view * vec4(world_pos, 1.0)).z;
+	int count = cascade_params.x;
+	if (depth > cascade_splits[count - 1])
+		return 1.0;
+
+	int cascade = 0;
+	while (cascade < count - 1 && depth > cascade_splits[cascade])
+		++cascade;
+
+	vec4 light_space = cascade_view_projection[cascade] * vec4(world_pos, 1.0);
+	vec3 proj_coords = light_space.xyz * 0.5 + 0.5;
+	if (proj_coords.z > 1.0)
+		return 1.0;
+
+	if (shadow_filter == SHADOW_FILTER_VSM || shadow_filter == SHADOW_FILTER_ESM)
+		return momentShadow(proj_coords.xy, float(cascade), proj_coords.z);
+
+	vec2 texel = 1.0 / vec2(textureSize(cascade_shadow_map, 0).xy);
+	return filterShadow(cascade_shadow_map, cascade_shadow_compare, proj_coords.xy, float(cascade), proj_coords.z, texel, vec2(0.0), vec2(1.0));
+}
+
+// point lights have six views in the order +x, -x, +y, -y, +z, -z
+int cubeFace(vec3 v)
+{
+	vec3 a = abs(v);
+	if (a.x >= a.y && a.x >= a.z)
+		return v.x > 0.0 ? 0 : 1;
+	if (a.y >= a.z)
+		return v.y > 0.0 ? 2 : 3;
+	return v.z > 0.0 ? 4 : 5;
+}
+
+vec3 calcDirLight(DirLight light, vec3 normal, vec3 FragPos, vec3 viewDir)
+{
+	vec3 lightDir = normalize(-light.direction.xyz);
+
+	float shadow = 1.0;
+#if DIR_SHADOWS
+	if (light.shadow_view >= 0)
+		shadow = cascadeShadow(FragPos);
+#endif
+
+	// ambient
+	vec3 ambient = light.ambient.xyz;
+
+	// diffuse
+	float diff = max(dot(normal, lightDir), 0.0);
+	vec3 diffuse = diff * light.diffuse.xyz * shadow;
+
+	// specular
+	//vec3 reflectDir = reflect(-lightDir, normal); // Phong lighting
+	vec3 halfwayDir = normalize(lightDir + viewDir); // Blinn-Phong
+	float spec = pow(max(dot(viewDir, halfwayDir), 0.0), material.shininess);
+	vec3 specular = material.specular * spec * light.specular.xyz * shadow;
+
+	return (ambient + diffuse + specular);
+}
+// point or spot light at index in the cluster light list
+vec3 calcClusterLight(uint index, vec3 normal, vec3 FragPos, vec3 viewDir)
+{
+	int base = int(index) * 5;
+	vec4 position_radius = texelFetch(cluster_lights, base);
+	vec4 color_ambient = texelFetch(cluster_lights, base + 1);
+	vec4 attenuation_type = texelFetch(cluster_lights, base + 2);
+
+	vec3 toLight = position_radius.xyz - FragPos;
+	float distance = length(toLight);
+	if (distance >= position_radius.w)
+		return vec3(0.0);
+
+	vec3 lightDir = toLight / distance;
+
+	// faded to 0 at the radius so culling the light there doesn't leave an edge
+	float attenuation = 1.0 / (attenuation_type.x + attenuation_type.y * distance + attenuation_type.z * (distance * distance));
+	float window = clamp(1.0 - pow(distance / position_radius.w, 4.0), 0.0, 1.0);
+	attenuation *= window * window;
+
+	vec4 direction_shadow = texelFetch(cluster_lights, base + 3);
+
+	// spot lights have one shadow view, point lights one for each cube face
+	float shadow = 1.0;
+#if POINT_SHADOWS || SPOT_SHADOWS
+	if (direction_shadow.w >= 0.0)
+	{
+		int shadow_view = int(direction_shadow.w);
+#if POINT_SHADOWS && SPOT_SHADOWS
+		if (attenuation_type.w < 0.5)
+			shadow_view += cubeFace(FragPos - position_radius.xyz);
+#elif POINT_SHADOWS
+		shadow_view += cubeFace(FragPos - position_radius.xyz);
+#endif
+		shadow = atlasShadow(shadow_view, FragPos);
+	}
+#endif
+
+	vec3 color = color_ambient.xyz;
+
+	// ambient
+	vec3 ambient = color * color_ambient.w;
+
+	// diffuse
+	float diff = max(dot(normal, lightDir), 0.0);
+	vec3 diffuse = diff * color * shadow;
+
+	// specular
+	vec3 halfwayDir = normalize(lightDir + viewDir); // Blinn-Phong
+	float spec = pow(max(dot(viewDir, halfwayDir), 0.0), material.shininess);
+	vec3 specular = material.specular * spec * color * shadow;
+
+	// spot light cone, every light is a spot light without POINT_LIGHTS
+#if SPOT_LIGHTS
+#if POINT_LIGHTS
+	if (attenuation_type.w > 0.5)
+#endif
+	{
+		vec4 cutoff = texelFetch(cluster_lights, base + 4);
+		float theta = dot(lightDir, -direction_shadow.xyz);
+		float intensity = clamp((theta - cutoff.y) / (cutoff.x - cutoff.y), 0.0, 1.0);
+
+		diffuse *= intensity;
+		specular *= intensity;
+	}
+#endif
+
+	return (ambient + diffuse + specular) * attenuation;
+}
+
+vec3 calcClusterLights(vec3 normal, vec3 FragPos, vec3 viewDir)
+{
+	vec3 result = vec3(0.0);
+
+	if (cluster_flags.x == 0)
+	{
+		for (uint i = 0u; i < cluster_dims.w; ++i)
+			result += calcClusterLight(i, normal, FragPos, viewDir);
+		return result;
+	}
+
+	float depth = -(view * vec4(FragPos, 1.0)).z;
+	uvec3 cluster;
+	cluster.xy = min(uvec2(gl_FragCoord.xy * cluster_params.xy), cluster_dims.xy - 1u);
+	cluster.z = uint(clamp(log(max(depth, 1e-4)) * cluster_params.z + cluster_params.w, 0.0, float(cluster_dims.z - 1u)));
+	int cluster_index = int((cluster.z * cluster_dims.y + cluster.y) * cluster_dims.x + cluster.x);
+
+	uvec2 range = texelFetch(cluster_grid, cluster_index).xy;
+	for (uint i = 0u; i < range.y; ++i)
+	{
+		uint index = texelFetch(cluster_indices, int(range.x + i)).x;
+		result += calcClusterLight(index, normal, FragPos, viewDir);
+	}
+
+	return result;
+}
\ No newline at end of file
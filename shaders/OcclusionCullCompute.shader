@@ -0,0 +1,114 @@
+#version 430 core
+layout(local_size_x = 64) in;
+
+struct DrawCommand {
+	uint count;
+	uint instance_count;
+	uint first_index;
+	uint base_vertex;
+	uint base_instance;
+};
+
+struct Bounds {
+	vec4 min;
+	vec4 max;
+};
+
+layout(std430, binding = 0) readonly buffer ObjectBounds
+{
+	Bounds bounds[];
+};
+layout(std430, binding = 1) buffer Visibility
+{
+	uint visible[];
+};
+layout(std430, binding = 2) writeonly buffer Commands
+{
+	DrawCommand commands[];
+};
+
+uniform uint num_objects;
+
+// the early pass tests everything against last frame's pyramid, the late pass
+// re-tests what the early pass rejected against the pyramid of this frame
+uniform bool late_pass;
+uniform bool use_pyramid;
+
+uniform vec4 frustum_planes[6];
+
+uniform mat4 view_proj;
+uniform sampler2D hiz;
+uniform vec2 hiz_size;
+uniform int hiz_levels;
+
+bool inFrustum(vec3 bmin, vec3 bmax)
+{
+	vec3 center = (bmin + bmax) * 0.5;
+	vec3 extents = (bmax - bmin) * 0.5;
+	for (int i = 0; i < 6; ++i)
+	{
+		float r = dot(extents, abs(frustum_planes[i].xyz));
+		if (dot(frustum_planes[i].xyz, center) + frustum_planes[i].w < -r)
+			return false;
+	}
+	return true;
+}
+
+bool occluded(vec3 bmin, vec3 bmax)
+{
+	vec2 uv_min = vec2(1.0);
+	vec2 uv_max = vec2(0.0);
+	float closest = 1.0;
+	for (int i = 0; i < 8; ++i)
+	{
+		vec3 corner = vec3((i & 1) != 0 ? bmax.x : bmin.x, (i & 2) != 0 ? bmax.y : bmin.y, (i & 4) != 0 ? bmax.z : bmin.z);
+		vec4 clip = view_proj * vec4(corner, 1.0);
+
+		// crosses the near plane, the projected rectangle is unbounded
+		if (clip.w <= 0.0)
+			return false;
+
+		vec3 ndc = clip.xyz / clip.w;
+		uv_min = min(uv_min, ndc.xy * 0.5 + 0.5);
+		uv_max = max(uv_max, ndc.xy * 0.5 + 0.5);
+		closest = min(closest, ndc.z * 0.5 + 0.5);
+	}
+	uv_min = clamp(uv_min, 0.0, 1.0);
+	uv_max = clamp(uv_max, 0.0, 1.0);
+
+	// pick the level where the rectangle spans at most 2x2 texels
+	vec2 size = (uv_max - uv_min) * hiz_size;
+	float level = ceil(log2(max(max(size.x, size.y), 1.0)));
+	level = clamp(level, 0.0, float(hiz_levels - 1));
+
+	float farthest = textureLod(hiz, uv_min, level).r;
+	farthest = max(farthest, textureLod(hiz, vec2(uv_max.x, uv_min.y), level).r);
+	farthest = max(farthest, textureLod(hiz, vec2(uv_min.x, uv_max.y), level).r);
+	farthest = max(farthest, textureLod(hiz, uv_max, level).r);
+
+	return closest > farthest;
+}
+
+void main()
+{
+	uint id = gl_GlobalInvocationID.x;
+	if (id >= num_objects)
+		return;
+
+	vec3 bmin = bounds[id].min.xyz;
+	vec3 bmax = bounds[id].max.xyz;
+
+	if (late_pass && visible[id] != 0u)
+	{
+		// already drawn by the early pass
+		commands[id].instance_count = 0u;
+		return;
+	}
+
+	bool draw = inFrustum(bmin, bmax);
+	if (draw && use_pyramid)
+		draw = !occluded(bmin, bmax);
+
+	commands[id].instance_count = draw ? 1u : 0u;
+	visible[id] = draw ? 1u : 0u;
+}
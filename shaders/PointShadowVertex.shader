@@ -0,0 +1,30 @@
+#version 420 core
+#extension GL_ARB_shader_viewport_layer_array : require
+// draws a caster into the cube faces of one point light, one instance per face it touches
+layout(location = 0) in vec3 aPos;
+
+struct ShadowView {
+	mat4 view_projection;
+	vec4 rect;
+	vec4 params;	// layer, texel size in atlas uv, depth bias
+};
+layout(std140, binding = 3) uniform Shadows
+{
+	ShadowView shadow_views[64];
+};
+
+uniform mat4 model;
+// the light's first view in the atlas, and the faces this caster is drawn into
+uniform int first_view;
+uniform int faces[6];
+
+void main()
+{
+	int face = faces[gl_InstanceID];
+	ShadowView view = shadow_views[first_view + face];
+
+	gl_Position = view.view_projection * model * vec4(aPos, 1.0);
+	// the viewports are the face tiles, in face order
+	gl_Layer = int(view.params.x);
+	gl_ViewportIndex = face;
+}
\ No newline at end of file
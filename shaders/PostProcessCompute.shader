@@ -0,0 +1,132 @@
+#version 430 core
+layout(local_size_x = 8, local_size_y = 8) in;
+
+// one stage of the post-processing chain, see PostProcess.h. NEIGHBORHOOD picks the effect that reads
+// around each texel, 0 for none, and PIXEL_OPS is the per pixel effects after it, all in this dispatch
+#ifndef NEIGHBORHOOD
+#define NEIGHBORHOOD 0
+#endif
+#ifndef PIXEL_OPS
+#define PIXEL_OPS
+#endif
+#ifndef DST_FORMAT
+#define DST_FORMAT rgba16f
+#endif
+
+uniform sampler2D src;
+// the first level of Bloom's chain
+uniform sampler2D bloom_texture;
+layout(DST_FORMAT, binding = 0) writeonly uniform image2D dst;
+
+uniform ivec2 dst_size;
+// of each effect in PIXEL_OPS
+uniform vec4 params[8];
+// the part of every texture the frame is in, from the origin, below 1 when it was drawn at a lower resolution
+uniform vec2 frame_scale;
+
+float luminance(vec3 color)
+{
+	return dot(color, vec3(0.2126, 0.7152, 0.0722));
+}
+
+// src at uv, kept inside the frame so nothing past its edge is read
+vec3 sampleSrc(vec2 uv)
+{
+	return texture(src, min(uv, frame_scale - 0.5 / vec2(textureSize(src, 0)))).rgb;
+}
+
+// neighborhood effects, the offsets are in texels of the destination so they cover
+// as much of the image at any resolution
+
+vec3 edges(vec2 uv, vec2 offset)
+{
+	// laplacian
+	vec3 color = -8.0 * sampleSrc(uv);
+	for (int y = -1; y <= 1; ++y)
+	{
+		for (int x = -1; x <= 1; ++x)
+		{
+			if (x != 0 || y != 0)
+				color += sampleSrc(uv + vec2(x, y) * offset);
+		}
+	}
+	return color;
+}
+
+vec3 blur(vec2 uv, vec2 offset)
+{
+	// 3x3 tent, each tap is bilinear so it also smooths what it skips when downsampling
+	vec3 color = vec3(0.0);
+	for (int y = -1; y <= 1; ++y)
+	{
+		for (int x = -1; x <= 1; ++x)
+			color += sampleSrc(uv + vec2(x, y) * offset) * (2 - abs(x)) * (2 - abs(y));
+	}
+	return color / 16.0;
+}
+
+// per pixel effects
+
+vec3 bloom(vec3 color, vec4 p, vec2 uv)
+{
+	// mixed rather than added, the chain is an average of the frame so p.x of it keeps the energy
+	vec2 bloom_uv = min(uv, frame_scale - 0.5 / vec2(textureSize(bloom_texture, 0)));
+	return mix(color, textureLod(bloom_texture, bloom_uv, 0.0).rgb, p.x);
+}
+
+vec3 tonemap(vec3 color, vec4 p, vec2 uv)
+{
+	// exposure p.x, then the fit of the ACES curve by Krzysztof Narkowicz
+	color *= p.x;
+	return clamp((color * (2.51 * color + 0.03)) / (color * (2.43 * color + 0.59) + 0.14), 0.0, 1.0);
+}
+
+vec3 colorGrade(vec3 color, vec4 p, vec2 uv)
+{
+	// contrast p.x around middle grey, saturation p.y, and p.z warms the image or cools it when negative
+	color = max((color - 0.18) * p.x + 0.18, 0.0);
+	color = mix(vec3(luminance(color)), color, p.y);
+	return color * vec3(1.0 + p.z, 1.0, 1.0 - p.z);
+}
+
+vec3 vignette(vec3 color, vec4 p, vec2 uv)
+{
+	// darkens by up to p.x from p.y of the way to the corners of the frame
+	float distance = length(uv / frame_scale - 0.5) * 1.4142136;
+	return color * (1.0 - p.x * smoothstep(p.y, 1.0, distance));
+}
+
+vec3 grayscale(vec3 color, vec4 p, vec2 uv)
+{
+	return vec3(luminance(color));
+}
+
+vec3 threshold(vec3 color, vec4 p, vec2 uv)
+{
+	return luminance(color) < p.x ? vec3(0.0) : vec3(1.0);
+}
+
+vec3 gammaCorrect(vec3 color, vec4 p, vec2 uv)
+{
+	return pow(max(color, 0.0), vec3(1.0 / p.x));
+}
+
+void main()
+{
+	ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+	if (texel.x >= dst_size.x || texel.y >= dst_size.y)
+		return;
+
+	vec2 uv = (vec2(texel) + 0.5) / vec2(dst_size);
+#if NEIGHBORHOOD == 1
+	vec3 color = edges(uv, 1.0 / vec2(dst_size));
+#elif NEIGHBORHOOD == 2
+	vec3 color = blur(uv, 1.0 / vec2(dst_size));
+#else
+	vec3 color = sampleSrc(uv);
+#endif
+
+	PIXEL_OPS
+
+	imageStore(dst, texel, vec4(color, 1.0));
+}
\ No newline at end of file
@@ -0,0 +1,15 @@
+#version 330 core
+layout(location = 0) in vec2 aPos;
+layout(location = 1) in vec4 aColor;
+
+out vec4 Color;
+
+// in pixels, the positions are from the top left
+uniform vec2 screen_size;
+
+void main()
+{
+	vec2 ndc = aPos / screen_size * 2.0 - 1.0;
+	gl_Position = vec4(ndc.x, -ndc.y, 0.0, 1.0);
+	Color = aColor;
+}
\ No newline at end of file
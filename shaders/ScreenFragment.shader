@@ -4,6 +4,13 @@ in vec2	TexCoord;
 out vec4 FragColor;
 
 uniform sampler2D screenTexture;
+// the post-processing chain already tonemapped the frame and corrected the gamma
+uniform bool post_processed;
+uniform float exposure;
+// the frame is uv_scale of screenTexture from its origin, stretched to the window. when that's an upscale
+// it's sharpened by sharpness against the four texels around it
+uniform vec2 uv_scale;
+uniform float sharpness;
 
 void invert()
 {
@@ -14,6 +21,12 @@ vec4 grayscale(vec4 col)
 	float average = 0.2126 * col.r + 0.7152 * col.g + 0.0722 * col.b;
 	return vec4(average, average, average, 1.0);
 }
+vec4 tonemap(vec4 col)
+{
+    // the fit of the ACES curve by Krzysztof Narkowicz, as in the post-processing chain
+    vec3 x = col.rgb * exposure;
+    return vec4(clamp((x * (2.51 * x + 0.03)) / (x * (2.43 * x + 0.59) + 0.14), 0.0, 1.0), col.w);
+}
 vec4 gamma_correct(vec4 col)
 {
     float gamma = 2.2;
@@ -52,13 +65,36 @@ vec4 thresh(vec4 col)
     return vec4(1.0);
 }
 
+vec4 upscale(vec2 uv)
+{
+    vec2 texel = 1.0 / vec2(textureSize(screenTexture, 0));
+    vec2 uv_min = 0.5 * texel;
+    vec2 uv_max = uv_scale - 0.5 * texel;
+    uv = clamp(uv * uv_scale, uv_min, uv_max);
+    vec4 center = texture(screenTexture, uv);
+    if (sharpness <= 0.0)
+        return center;
+
+    vec3 n = texture(screenTexture, clamp(uv + vec2(0.0, texel.y), uv_min, uv_max)).rgb;
+    vec3 s = texture(screenTexture, clamp(uv - vec2(0.0, texel.y), uv_min, uv_max)).rgb;
+    vec3 e = texture(screenTexture, clamp(uv + vec2(texel.x, 0.0), uv_min, uv_max)).rgb;
+    vec3 w = texture(screenTexture, clamp(uv - vec2(texel.x, 0.0), uv_min, uv_max)).rgb;
+
+    // unsharp mask, kept within the range of the neighborhood so edges don't ring
+    vec3 sharpened = center.rgb + (4.0 * center.rgb - (n + s + e + w)) * 0.25 * sharpness;
+    vec3 lowest = min(center.rgb, min(min(n, s), min(e, w)));
+    vec3 highest = max(center.rgb, max(max(n, s), max(e, w)));
+    return vec4(clamp(sharpened, lowest, highest), center.a);
+}
+
 void main()
 {
 	//vec4 col = convolve();
     //col = grayscale(col);
     //col = thresh(col);
-    vec4 screen = texture(screenTexture, TexCoord);
-    screen = gamma_correct(screen);
+    vec4 screen = upscale(TexCoord);
+    if (!post_processed)
+        screen = gamma_correct(tonemap(screen));
     //screen = grayscale(screen);
     FragColor = screen;
 }
\ No newline at end of file
@@ -0,0 +1,48 @@
+#version 430 core
+layout(local_size_x = 8, local_size_y = 8) in;
+
+// one direction of the separable blur of the shadow moments, see ShadowMoments in ShadowFilter.h.
+// the first pass reads the depth and turns each 2x2 block of it into moments
+uniform bool from_depth;
+uniform sampler2DArray depth_texture;
+layout(rg32f, binding = 0) readonly uniform image2DArray src_moments;
+layout(rg32f, binding = 1) writeonly uniform image2DArray dst_moments;
+
+// (1, 0) or (0, 1)
+uniform ivec2 direction;
+// of the moments, the depth is twice as large
+uniform int size;
+
+// exp(esm_exponent * depth) instead of depth and depth squared
+uniform bool exponential;
+uniform float esm_exponent;
+
+const float weights[5] = float[](0.0625, 0.25, 0.375, 0.25, 0.0625);
+
+vec2 moments(ivec2 texel, int layer)
+{
+	texel = clamp(texel, ivec2(0), ivec2(size - 1));
+	if (!from_depth)
+		return imageLoad(src_moments, ivec3(texel, layer)).xy;
+
+	vec2 result = vec2(0.0);
+	for (int i = 0; i < 4; ++i)
+	{
+		float depth = texelFetch(depth_texture, ivec3(texel * 2 + ivec2(i & 1, i >> 1), layer), 0).r;
+		result += exponential ? vec2(exp(esm_exponent * depth), 0.0) : vec2(depth, depth * depth);
+	}
+	return result * 0.25;
+}
+
+void main()
+{
+	ivec3 id = ivec3(gl_GlobalInvocationID);
+	if (id.x >= size || id.y >= size)
+		return;
+
+	vec2 result = vec2(0.0);
+	for (int i = 0; i < 5; ++i)
+		result += weights[i] * moments(id.xy + direction * (i - 2), id.z);
+
+	imageStore(dst_moments, id, vec4(result, 0.0, 0.0));
+}
\ No newline at end of file
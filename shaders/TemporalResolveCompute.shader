@@ -0,0 +1,144 @@
+#version 430 core
+layout(local_size_x = 8, local_size_y = 8) in;
+
+// blends a jittered frame into the history of the last ones, see TemporalAA.h. the frame is input_size
+// from the origin of its textures, the output and the history are output_size
+
+uniform sampler2D color;
+uniform sampler2D depth;
+// how far each pixel's surface moved apart from the camera, in uv of the last frame, see Renderer::drawVelocity
+uniform sampler2D velocity;
+uniform sampler2D history;
+
+layout(rgba16f, binding = 0) writeonly uniform image2D dst;
+
+uniform ivec2 input_size;
+uniform ivec2 output_size;
+// how far the frame's content was moved, in its pixels
+uniform vec2 jitter;
+// from this frame's clip space to the last one's
+uniform mat4 reprojection;
+uniform bool history_valid;
+// of the frame in the result
+uniform float blend;
+
+vec3 rgbToYCoCg(vec3 c)
+{
+	return vec3(dot(c, vec3(0.25, 0.5, 0.25)), dot(c, vec3(0.5, 0.0, -0.5)), dot(c, vec3(-0.25, 0.5, -0.25)));
+}
+
+vec3 yCoCgToRgb(vec3 c)
+{
+	return vec3(c.x + c.y - c.z, c.x + c.z, c.x - c.y - c.z);
+}
+
+// the colors are blended compressed, so a single very bright pixel can't outweigh the rest
+vec3 compress(vec3 c)
+{
+	return c / (1.0 + max(c.r, max(c.g, c.b)));
+}
+
+vec3 uncompress(vec3 c)
+{
+	return c / max(1.0 - max(c.r, max(c.g, c.b)), 1.0e-4);
+}
+
+// Catmull-Rom from 5 bilinear taps, bilinear alone blurs the history a little more every frame
+vec3 sampleHistory(vec2 uv)
+{
+	vec2 size = vec2(output_size);
+	vec2 position = uv * size;
+	vec2 center = floor(position - 0.5) + 0.5;
+	vec2 f = position - center;
+
+	vec2 w0 = f * (-0.5 + f * (1.0 - 0.5 * f));
+	vec2 w1 = 1.0 + f * f * (-2.5 + 1.5 * f);
+	vec2 w2 = f * (0.5 + f * (2.0 - 1.5 * f));
+	vec2 w3 = f * f * (-0.5 + 0.5 * f);
+	vec2 w12 = w1 + w2;
+
+	vec2 uv0 = (center - 1.0) / size;
+	vec2 uv3 = (center + 2.0) / size;
+	vec2 uv12 = (center + w2 / w12) / size;
+
+	vec3 result = textureLod(history, vec2(uv12.x, uv0.y), 0.0).rgb * w12.x * w0.y
+		+ textureLod(history, vec2(uv0.x, uv12.y), 0.0).rgb * w0.x * w12.y
+		+ textureLod(history, uv12, 0.0).rgb * w12.x * w12.y
+		+ textureLod(history, vec2(uv3.x, uv12.y), 0.0).rgb * w3.x * w12.y
+		+ textureLod(history, vec2(uv12.x, uv3.y), 0.0).rgb * w12.x * w3.y;
+	float weight = w12.x * w0.y + w0.x * w12.y + w12.x * w12.y + w3.x * w12.y + w12.x * w3.y;
+	return max(result / weight, 0.0);
+}
+
+// moves the history toward the middle of the box until it's inside it
+vec3 clipToBox(vec3 history_color, vec3 box_min, vec3 box_max)
+{
+	vec3 center = 0.5 * (box_max + box_min);
+	vec3 extents = 0.5 * (box_max - box_min) + 1.0e-4;
+	vec3 offset = history_color - center;
+	vec3 units = abs(offset / extents);
+	float furthest = max(units.x, max(units.y, units.z));
+	return furthest > 1.0 ? center + offset / furthest : history_color;
+}
+
+void main()
+{
+	ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+	if (pixel.x >= output_size.x || pixel.y >= output_size.y)
+		return;
+
+	// the output pixel's center in the frame's pixels, and the frame's pixel the jittered content put there
+	vec2 uv = (vec2(pixel) + 0.5) / vec2(output_size);
+	vec2 position = uv * vec2(input_size);
+	ivec2 nearest = ivec2(floor(position + jitter));
+
+	// the frame's pixels around it, weighted by how close the spot each one saw is to the output pixel's center.
+	// their mean and deviation make the box the history is clipped to, the closest depth is where the motion is read
+	vec3 sum = vec3(0.0);
+	float weight_sum = 0.0;
+	vec3 moment1 = vec3(0.0);
+	vec3 moment2 = vec3(0.0);
+	float closest_depth = 1.0;
+	ivec2 closest = nearest;
+	for (int y = -1; y <= 1; ++y)
+	{
+		for (int x = -1; x <= 1; ++x)
+		{
+			ivec2 texel = clamp(nearest + ivec2(x, y), ivec2(0), input_size - 1);
+			vec3 c = rgbToYCoCg(compress(texelFetch(color, texel, 0).rgb));
+			vec2 offset = vec2(texel) + 0.5 - jitter - position;
+			float weight = exp(-2.29 * dot(offset, offset));
+			sum += c * weight;
+			weight_sum += weight;
+			moment1 += c;
+			moment2 += c * c;
+
+			float d = texelFetch(depth, texel, 0).r;
+			if (d < closest_depth)
+			{
+				closest_depth = d;
+				closest = texel;
+			}
+		}
+	}
+	vec3 current = sum / max(weight_sum, 1.0e-4);
+	vec3 mean = moment1 / 9.0;
+	vec3 deviation = sqrt(max(moment2 / 9.0 - mean * mean, 0.0));
+	vec3 box_min = mean - deviation;
+	vec3 box_max = mean + deviation;
+
+	// where the surface was last frame, from the camera's motion and then its own
+	vec4 clip = vec4(vec3(uv, closest_depth) * 2.0 - 1.0, 1.0);
+	vec4 prev_clip = reprojection * clip;
+	vec2 prev_uv = prev_clip.xy / prev_clip.w * 0.5 + 0.5 + texelFetch(velocity, closest, 0).rg;
+
+	vec3 result = current;
+	bool on_screen = all(greaterThanEqual(prev_uv, vec2(0.0))) && all(lessThanEqual(prev_uv, vec2(1.0)));
+	if (history_valid && on_screen)
+	{
+		vec3 previous = rgbToYCoCg(compress(sampleHistory(prev_uv)));
+		previous = clipToBox(previous, box_min, box_max);
+		result = mix(previous, current, blend);
+	}
+	imageStore(dst, pixel, vec4(uncompress(yCoCgToRgb(result)), 1.0));
+}
\ No newline at end of file
@@ -0,0 +1,30 @@
+#version 420 core
+#ifndef ALPHA_TEST
+#define ALPHA_TEST 1
+#endif
+
+#if ALPHA_TEST
+struct Material {
+	sampler2D diffuse1;
+};
+
+in vec2 TexCoord;
+
+uniform Material material;
+#endif
+
+in vec4 PrevClipPos;
+in vec4 PrevClipPosBefore;
+
+layout(location = 0) out vec2 Velocity;
+
+// how far the surface moved on its own, in uv of the last frame's screen. the camera's motion is the
+// same in both positions, so it's left out, see Renderer::drawVelocity
+void main()
+{
+#if ALPHA_TEST
+	if (texture(material.diffuse1, TexCoord).w < 0.1)
+		discard;
+#endif
+	Velocity = (PrevClipPosBefore.xy / PrevClipPosBefore.w - PrevClipPos.xy / PrevClipPos.w) * 0.5;
+}
\ No newline at end of file
@@ -0,0 +1,64 @@
+#version 420 core
+// see ShaderFeature in ShaderVariants.h and Renderer::drawVelocity
+#ifndef INSTANCED
+#define INSTANCED 0
+#endif
+#ifndef ALPHA_TEST
+#define ALPHA_TEST 1
+#endif
+
+layout(location = 0) in vec3 aPos;
+#if ALPHA_TEST
+layout(location = 2) in vec2 aTexCoord;
+
+out vec2 TexCoord;
+#endif
+#if INSTANCED
+layout(location = 3) in mat4 instanceMatrix;
+#endif
+
+// where the vertex is on the last frame's screen, now and as it was drawn then
+out vec4 PrevClipPos;
+out vec4 PrevClipPosBefore;
+
+uniform float angle;
+uniform float prev_angle;
+#if !INSTANCED
+uniform mat4 model;
+uniform mat4 prev_model;
+#endif
+uniform mat4 prev_view_projection;
+
+layout(std140, binding = 0) uniform Matrices
+{
+	mat4 view;
+	mat4 projection;
+};
+
+// must match Vertex.shader exactly so it's tested against the scene's depth with GL_LEQUAL
+invariant gl_Position;
+
+// InstanceCuller pads its culling sphere by the most this moves a vertex
+vec3 animate(vec3 pos, float time)
+{
+#if INSTANCED
+	pos.x += sin(time * 8 + pos.z * 3 - pos.y) * (-pos.z * 0.5 + 1.5) * 0.1;
+#endif
+	return pos;
+}
+
+void main()
+{
+#if INSTANCED
+	mat4 model = instanceMatrix;
+	mat4 prev_model = instanceMatrix;
+#endif
+	vec4 pmodel = model * vec4(animate(aPos, angle), 1.0);
+	gl_Position = projection * view * pmodel;
+
+	PrevClipPos = prev_view_projection * pmodel;
+	PrevClipPosBefore = prev_view_projection * prev_model * vec4(animate(aPos, prev_angle), 1.0);
+#if ALPHA_TEST
+	TexCoord = aTexCoord;
+#endif
+}
\ No newline at end of file
@@ -1,19 +1,27 @@
 #version 420 core
+// see ShaderFeature in ShaderVariants.h
+#ifndef INSTANCED
+#define INSTANCED 0
+#endif
+
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 //layout (location = 1) in vec3 aCol;
 layout (location = 2) in vec2 aTexCoord;
+#if INSTANCED
+layout (location = 3) in mat4 instanceMatrix;
+#endif
 
 //out vec3 vertexColor;
 out vec2 TexCoord;
 out vec3 Normal;
 out vec3 FragPos;
 out vec3 LocalPos;
-out vec4 FragPosLightSpace;
 
 uniform float angle;
+#if !INSTANCED
 uniform mat4 model;
-uniform mat4 shadow_projection;
+#endif
 
 layout(std140, binding = 0) uniform Matrices
 {
@@ -21,9 +29,17 @@ layout(std140, binding = 0) uniform Matrices
 	mat4 projection;
 };
 
+// the depth pre-pass computes the same position in DepthVertex.shader
+invariant gl_Position;
+
 void main()
 {
 	vec3 pos = aPos;
+#if INSTANCED
+	mat4 model = instanceMatrix;
+	// InstanceCuller pads its culling sphere by the most this moves a vertex
+	pos.x += sin(angle * 8 + pos.z * 3 - pos.y) * (-pos.z * 0.5 + 1.5) * 0.1;
+#endif
 	vec4 pmodel = model * vec4(pos, 1.0);
 	//pmodel.x += sin(-angle * 8 + pmodel.x * 3)* (pmodel.x * 0.5 + 0.5) * 0.2;
 	gl_Position = projection * view * pmodel;// vec4(len * cos(theta + angle), len * sin(theta + angle), aPos.z, 1.0);
@@ -33,5 +49,4 @@ void main()
 	Normal = mat3(transpose(inverse(model))) * aNormal; // for non-uniform scaling
 	LocalPos = aPos;
 	//Normal = mat3(model) * aNormal;
-	FragPosLightSpace = shadow_projection * vec4(FragPos, 1.0);
 }
\ No newline at end of file
@@ -18,10 +18,22 @@
 #include "renderer/Util.h"
 #include "renderer/Light.h"
 #include "renderer/Renderer.h"
+#include "renderer/GLExtensions.h"
+#include "renderer/InstanceCuller.h"
+#include "renderer/GLState.h"
+#include "renderer/PostProcess.h"
+#include "renderer/RenderTargetPool.h"
+#include "renderer/RenderGraph.h"
+#include "renderer/DynamicResolution.h"
+#include "renderer/TemporalAA.h"
+#include "renderer/GpuProfiler.h"
+#include "renderer/GpuProfilerOverlay.h"
+#include "renderer/CpuProfiler.h"
 
 #include "stb_image.h"
 
 #include <vector>
+#include <string>
 #include <ctime>
 
 #define DEBUG_LOG
@@ -46,9 +58,16 @@ Camera camera(glm::vec3(0.0f, 0.0f, 0.0f),
 
 
 
+// the window's framebuffer size as it was last given, the render targets follow it once it settles
+int window_width = 0;
+int window_height = 0;
+float window_resize_time = 0.0f;
+
 void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
-	glViewport(0, 0, width, height);
+	window_width = width;
+	window_height = height;
+	window_resize_time = glfwGetTime();
 }
 void mouseCallback(GLFWwindow* window, double xpos, double ypos)
 {
@@ -79,20 +98,59 @@ void scrollCallback(GLFWwindow* window, double offsetX, double offsetY)
 {
 	camera.onScrollCallback(offsetX, offsetY);
 }
+// the chains g cycles through, the frame is HDR so all but the edges are tonemapped
+void buildPostChain(PostProcess* post, unsigned int preset, float exposure)
+{
+	post->clear();
+	if (preset == 2)
+	{
+		// the edges don't need the full resolution
+		post->add(POST_EDGES, glm::vec4(0.0f), 0.5f);
+		post->add(POST_GRAYSCALE);
+		post->add(POST_THRESHOLD, glm::vec4(0.1f));
+	}
+	else
+	{
+		post->add(POST_BLOOM, glm::vec4(0.04f, 1.0f, 0.0f, 0.0f));
+		post->add(POST_TONEMAP, glm::vec4(exposure));
+		if (preset == 1)
+		{
+			post->add(POST_COLOR_GRADE, glm::vec4(1.1f, 1.2f, 0.05f, 0.0f));
+			post->add(POST_VIGNETTE, glm::vec4(0.4f, 0.5f, 0.0f, 0.0f));
+		}
+	}
+	post->add(POST_GAMMA, glm::vec4(2.2f));
+}
 void processInput(GLFWwindow* window, Camera& camera, float deltaTime)
 {
+	CPU_ZONE("processInput");
 	if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
 		glfwSetWindowShouldClose(window, true);
 
 	camera.processCameraInput(window, deltaTime);
 }
 
-int main()
+int main(int argc, char** argv)
 {
+	// --bench sweeps the number of lights, the render path and the resolution and prints the cost of each, then exits
+	bool bench = argc > 1 && std::string(argv[1]) == "--bench";
+	CPU_THREAD("main");
+
+	// --trace first count writes a cpu trace of that many frames from the first to cpu_trace.json, k writes one of the next 60
+#if CPU_PROFILER
+	const char* cpu_trace_path = "cpu_trace.json";
+	const unsigned int cpu_trace_frames = 60;
+	for (int i = 1; i + 2 < argc; ++i)
+	{
+		if (std::string(argv[i]) == "--trace")
+			cpu_profiler.capture(atoi(argv[i + 1]), atoi(argv[i + 2]), cpu_trace_path);
+	}
+#endif
+
 	// creating the window
 	glfwInit();
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 2);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 	glfwWindowHint(GLFW_SAMPLES, 4);
 
@@ -101,6 +159,12 @@ int main()
 
 	GLFWwindow* window = glfwCreateWindow(screen_width, screen_height, "LearnOpenGL", NULL, NULL);
 	if (window == NULL)
+	{
+		// compute culling needs 4.3, everything else still runs on 4.2
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 2);
+		window = glfwCreateWindow(screen_width, screen_height, "LearnOpenGL", NULL, NULL);
+	}
+	if (window == NULL)
 	{
 		std::cout << "Failed to create GLFW window" << std::endl;
 		glfwTerminate();
@@ -113,12 +177,25 @@ int main()
 		std::cout << "Failed to initialize GLAD" << std::endl;
 		return -1;
 	}
+	loadGLExtensions();
 
-	glViewport(0, 0, screen_width, screen_height);
+	// it's in pixels, which aren't the window's units on every display
+	glfwGetFramebufferSize(window, &window_width, &window_height);
+	screen_width = window_width;
+	screen_height = window_height;
+	gl_state.viewport(0, 0, screen_width, screen_height);
 
 	glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-	glfwSetCursorPosCallback(window, mouseCallback);
-	glfwSetScrollCallback(window, scrollCallback);
+	if (!bench)
+	{
+		glfwSetCursorPosCallback(window, mouseCallback);
+		glfwSetScrollCallback(window, scrollCallback);
+	}
+	else
+	{
+		// uncapped so the frame time is the gpu's
+		glfwSwapInterval(0);
+	}
 
 	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
@@ -127,6 +204,9 @@ int main()
 
 	// creating the renderer
 	Renderer* renderer = new Renderer(window);
+	const NoiseTexture& noise = renderer->getNoiseTexture();
+	print("noise: " << noise.settings.size << "x" << noise.settings.size << "x" << noise.settings.depth << " fbm, "
+		<< (noise.from_cache ? "loaded from cache" : "baked") << " in " << noise.bake_ms << " ms");
 
 	renderer->setCamera(&camera);
 
@@ -209,7 +289,7 @@ int main()
 	unsigned int VAO;
 	glGenVertexArrays(1, &VAO);
 
-	glBindVertexArray(VAO);
+	gl_state.bindVertexArray(VAO);
 
 	glBindBuffer(GL_ARRAY_BUFFER, VBO);
 	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW); // copies vertices data into VBO
@@ -248,17 +328,28 @@ int main()
 		glm::vec3(-2.3f, -3.4f, -1.5f)
 	};
 
+	AABB cube_bounds = { glm::vec3(-0.5f, -0.5f, -0.5f), glm::vec3(0.5f, 0.5f, 0.5f) };
 	for (unsigned int i = 0; i < 9; ++i)
 	{
 		glm::mat4 model = glm::mat4(1.0f);
 		model = glm::translate(model, cubePositions[i]);
-		renderer->addRenderObject(VAO, texture2, 36, model);
+		renderer->addRenderObject(VAO, texture2, 36, model, cube_bounds);
 	}
 	{
 		glm::mat4 model = glm::mat4(1.0f);
 		model = glm::translate(model, glm::vec3(0.0f, -4.0f, -2.0f));
 		model = glm::scale(model, glm::vec3(20.0f, 0.2f, 20.0f));
-		renderer->addRenderObject(VAO, texture, 36, model);
+		unsigned int ground = renderer->addRenderObject(VAO, texture, 36, model, cube_bounds);
+
+		// the ground hides everything below it
+		std::vector<glm::vec3> ground_positions;
+		std::vector<unsigned int> ground_indices;
+		for (unsigned int i = 0; i < 36; ++i)
+		{
+			ground_positions.push_back(glm::vec3(vertices[i * 8], vertices[i * 8 + 1], vertices[i * 8 + 2]));
+			ground_indices.push_back(indices[i]);
+		}
+		renderer->addOccluder(ground, ground_positions, ground_indices);
 	}
 
 
@@ -277,7 +368,7 @@ int main()
 	unsigned int bVAO;
 	glGenVertexArrays(1, &bVAO);
 
-	glBindVertexArray(bVAO);
+	gl_state.bindVertexArray(bVAO);
 
 	glBindBuffer(GL_ARRAY_BUFFER, bVBO);
 	glBufferData(GL_ARRAY_BUFFER, sizeof(ball_vertices), ball_vertices, GL_STATIC_DRAW);
@@ -305,7 +396,8 @@ int main()
 		glm::mat4 ball_model = glm::mat4(1.0f);
 		ball_model = glm::translate(ball_model, ball_pos);
 
-		renderer->addRenderObject(bVAO, texture3, 6 * ball_width * ball_height, ball_model);
+		AABB ball_bounds = { glm::vec3(-1.0f, -1.0f, -1.0f), glm::vec3(1.0f, 1.0f, 1.0f) };
+		renderer->addRenderObject(bVAO, texture3, 6 * ball_width * ball_height, ball_model, ball_bounds);
 	}
 
 
@@ -320,7 +412,7 @@ int main()
 	unsigned int lVAO;
 	glGenVertexArrays(1, &lVAO);
 
-	glBindVertexArray(lVAO);
+	gl_state.bindVertexArray(lVAO);
 
 	glBindBuffer(GL_ARRAY_BUFFER, VBO);
 
@@ -337,12 +429,12 @@ int main()
 
 
 	// lights
-	DirLight* dir_light = new DirLight(glm::vec3(0.1f, 0.1f, 0.1f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(1.0f, -1.0f, 1.4f), 0.1f, false);
+	DirLight* dir_light = new DirLight(glm::vec3(0.1f, 0.1f, 0.1f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(1.0f, -1.0f, 1.4f), 0.1f, true);
 
-	SpotLight* spot_light = new SpotLight(glm::vec3(1.0f, 1.0f, 1.0f), glm::vec3(0.0f, 4.0f, -4.0f), glm::vec3(0.2f, -1.0f, 0.3f), 0.0f, false);
+	SpotLight* spot_light = new SpotLight(glm::vec3(1.0f, 1.0f, 1.0f), glm::vec3(0.0f, 4.0f, -4.0f), glm::vec3(0.2f, -1.0f, 0.3f), 0.0f, true);
 
 	renderer->setDirLight(dir_light);
-	renderer->setSpotLight(spot_light);
+	renderer->addSpotLight(spot_light);
 
 	// point lights
 	const unsigned int num_point_lights = 4;
@@ -366,14 +458,56 @@ int main()
 		{
 			std::string num = std::to_string(i);
 
-			point_lights.emplace_back(pointLightColors[i], pointLightPositions[i], 0.1f, false);
+			point_lights.emplace_back(pointLightColors[i], pointLightPositions[i], 0.1f, true);
 
-			renderer->setPointLight(&point_lights[i]);
+			renderer->addPointLight(&point_lights[i]);
 		}
 	}
 
 	renderer->updateLightUniforms();
 
+	// lights added by the benchmark, doubling from 1 to max_bench_lights.
+	// every light count is measured at each resolution with each of the modes
+	struct BenchMode
+	{
+		const char* name;
+		RenderPath path;
+		bool clustered;
+	};
+	const BenchMode bench_modes[] = {
+		{ "forward, all lights", RENDER_PATH_FORWARD, false },
+		{ "forward, clustered ", RENDER_PATH_FORWARD, true },
+		{ "deferred, clustered", RENDER_PATH_DEFERRED, true }
+	};
+	const unsigned int num_bench_modes = 3;
+	const glm::ivec2 bench_resolutions[] = { glm::ivec2(1280, 720), glm::ivec2(1920, 1080) };
+	const unsigned int num_bench_resolutions = 2;
+
+	const unsigned int max_bench_lights = 1024;
+	const unsigned int bench_warmup_frames = 20;
+	const unsigned int bench_frames = 60;
+	std::vector<PointLight> bench_lights;
+	bench_lights.reserve(max_bench_lights);
+
+	unsigned int bench_num_lights = 1;
+	unsigned int bench_mode = 0;
+	unsigned int bench_resolution = 0;
+	unsigned int bench_frame = 0;
+	float bench_frame_ms = 0.0f;
+	float bench_opaque_ms = 0.0f;
+	float bench_lighting_ms = 0.0f;
+	double bench_attachment_bytes = 0.0;
+	float bench_lights_per_cluster = 0.0f;
+
+	if (bench)
+	{
+		// every pixel is shaded once so the forward cost is just the lighting, like deferred
+		renderer->setDepthPrepassMode(DEPTH_PREPASS_ON);
+		srand(1);
+
+		print("lights | resolution | path                | frame ms | opaque ms | lighting ms | lighting ns/pixel | render target MB | lights/cluster (avg, max)");
+	}
+
 	// material
 	//shader.setInt("material.diffuse1", 0); // texture 0
 	//shader.setVec3("material.specular1", 0.8f, 0.8f, 0.8f);
@@ -392,15 +526,15 @@ int main()
 	// projection
 	//glm::mat4 ortho = glm::ortho(0.0f, 900.0f, 0.0f, 600.0f, 0.1f, 100.0f);
 
-	glEnable(GL_DEPTH_TEST);
-	glEnable(GL_STENCIL_TEST);
+	gl_state.enable(GL_DEPTH_TEST);
+	gl_state.enable(GL_STENCIL_TEST);
 
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	gl_state.enable(GL_BLEND);
+	gl_state.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-	glEnable(GL_CULL_FACE);
+	gl_state.enable(GL_CULL_FACE);
 
-	glEnable(GL_MULTISAMPLE);
+	gl_state.enable(GL_MULTISAMPLE);
 
 	float mix_vals[] = {
 		0.0f,
@@ -415,12 +549,38 @@ int main()
 		1.0f
 	};
 
-	// framebuffer
-	unsigned int ms_frame_texture;
-	unsigned int msFBO = createFrameBuffer(true, &ms_frame_texture, screen_width, screen_height);
+	// the scene is drawn at this size and stretched to the window
+	unsigned int render_width = screen_width;
+	unsigned int render_height = screen_height;
+	bool tab_was_pressed = false;
+	bool p_was_pressed = false;
+	bool f_was_pressed = false;
+	bool n_was_pressed = false;
+	bool g_was_pressed = false;
+	bool r_was_pressed = false;
+	bool t_was_pressed = false;
+	bool o_was_pressed = false;
+	bool j_was_pressed = false;
+#if CPU_PROFILER
+	bool k_was_pressed = false;
+#endif
 
-	unsigned int inter_frame_texture;
-	unsigned int interFBO = createFrameBuffer(false, &inter_frame_texture, screen_width, screen_height);
+	// the frame is drawn into the corner of the render targets at a scale that keeps the GPU within a 60 Hz
+	// frame, and sharpened as the quad stretches it to the window. the benchmark always draws the whole target
+	DynamicResolution dynamic_resolution(1000.0f / 60.0f);
+	dynamic_resolution.setEnabled(!bench);
+	unsigned int frame_width = render_width;
+	unsigned int frame_height = render_height;
+	const float upscale_sharpness = 0.5f;
+
+	// t cycles the antialiasing, TAA needs compute. upsampling draws at most this much of the output's size
+	AntiAliasing anti_aliasing = ANTI_ALIASING_MSAA;
+	TemporalAA* taa = gl_caps.compute ? new TemporalAA(render_width, render_height) : nullptr;
+	const float taa_upsampling_scale = 0.67f;
+	// the frame's, without the jitter
+	glm::mat4 frame_view_proj = glm::mat4(1.0f);
+	// the GPU time of the last frames with MSAA, what TAA saves is reported against it
+	float msaa_gpu_ms = 0.0f;
 
 	// quad
 	float quadVertices[] = {
@@ -440,7 +600,7 @@ int main()
 	unsigned int quadVAO;
 	glGenVertexArrays(1, &quadVAO);
 
-	glBindVertexArray(quadVAO);
+	gl_state.bindVertexArray(quadVAO);
 
 	glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
 	glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices, GL_STATIC_DRAW); // copies vertices data into VBO
@@ -453,7 +613,160 @@ int main()
 	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
 	glEnableVertexAttribArray(1);
 
-	Shader screen_shader("shaders/ScreenVertex.shader", "shaders/ScreenFragment.shader");
+	ShaderProgram* screen_shader = renderer->loadShader("shaders/ScreenVertex.shader", "shaders/ScreenFragment.shader");
+
+	// the passes of the frame and the renderer's steps within them are timed on the GPU. o shows the times
+	// over the frame against a 60 Hz budget, j writes them to a json file, the benchmark writes it when it ends
+	const char* gpu_profile_path = "gpu_profile.json";
+	GpuProfiler* profiler = new GpuProfiler();
+	renderer->setProfiler(profiler);
+	GpuProfilerOverlay* profiler_overlay = new GpuProfilerOverlay(renderer->loadShader("shaders/ProfilerOverlayVertex.shader", "shaders/ProfilerOverlayFragment.shader"), 1000.0f / 60.0f);
+	bool show_profiler = false;
+
+	// the post-processing chain, without compute the screen shader tonemaps and corrects the gamma on its own
+	PostProcess* post = nullptr;
+	unsigned int post_preset = 0;
+	float exposure = 1.0f;
+	if (gl_caps.compute)
+	{
+		post = new PostProcess(render_width, render_height);
+		buildPostChain(post, post_preset, exposure);
+	}
+
+	// the frame's passes and their render targets, declared again when the render path or the resolution changes.
+	// the targets of a size the window left are kept for a couple of seconds in case it comes back
+	RenderTargetPool* target_pool = new RenderTargetPool(120);
+	RenderGraph* graph = new RenderGraph(target_pool);
+	graph->setProfiler(profiler);
+	RenderPath graph_path = renderer->getRenderPath();
+	unsigned int graph_width = 0;
+	unsigned int graph_height = 0;
+	AntiAliasing graph_anti_aliasing = anti_aliasing;
+	bool graph_declared = false;
+	unsigned int scene_fbo = 0;
+	auto declare_frame = [&]()
+	{
+		CPU_ZONE("declare_frame");
+
+		// the scene pass sets the framebuffer it's given this time
+		graph->clear();
+		scene_fbo = 0;
+		renderer->setSceneFramebuffer(0);
+		graph_path = renderer->getRenderPath();
+		graph_width = render_width;
+		graph_height = render_height;
+		graph_anti_aliasing = anti_aliasing;
+		graph_declared = true;
+
+		// TAA draws a sample a pixel and resolves it with the history, MSAA resolves the samples of each pixel
+		bool temporal = anti_aliasing != ANTI_ALIASING_MSAA;
+		unsigned int samples = temporal ? 1 : 4;
+
+		unsigned int albedo = graph->createTarget("G-buffer albedo", { render_width, render_height, GBuffer::albedo_format, 1, GL_NEAREST });
+		unsigned int normal = graph->createTarget("G-buffer normal", { render_width, render_height, GBuffer::normal_format, 1, GL_NEAREST });
+		unsigned int gbuffer_depth = graph->createTarget("G-buffer depth", { render_width, render_height, GBuffer::depth_format, 1, GL_NEAREST });
+		unsigned int scene_color = graph->createTarget("scene color", { render_width, render_height, GL_R11F_G11F_B10F, samples });
+		unsigned int scene_depth = graph->createTarget("scene depth", { render_width, render_height, GL_DEPTH24_STENCIL8, samples });
+		unsigned int resolved = graph->createTarget("resolved", { render_width, render_height, GL_R11F_G11F_B10F });
+		unsigned int velocity = graph->createTarget("velocity", { render_width, render_height, GL_RG16F, 1, GL_NEAREST });
+		// the passes read it with output(), which alternates between two textures
+		unsigned int history = temporal ? graph->importTexture("TAA history", taa->output(), { render_width, render_height, GL_RGBA16F }) : 0;
+		unsigned int backbuffer = graph->importFramebuffer("backbuffer", 0);
+
+		// the cascades are fit to this frame's view, then everything is culled against it
+		graph->addPass("shadows", [&]()
+		{
+			renderer->drawShadows();
+		}).sideEffects();
+		graph->addPass("culling", [&]()
+		{
+			renderer->beginFrame();
+		}).sideEffects();
+
+		// only the deferred path reads it, the forward path culls it
+		graph->addPass("G-buffer", [&, albedo, normal, gbuffer_depth]()
+		{
+			renderer->setGBufferTextures(graph->texture(albedo), graph->texture(normal), graph->texture(gbuffer_depth));
+			gl_state.viewport(0, 0, frame_width, frame_height);
+			renderer->drawGBuffer();
+		}).write(albedo).write(normal).write(gbuffer_depth);
+
+		RenderGraph::Pass& scene = graph->addPass("scene", [&]()
+		{
+			if (graph->framebuffer() != scene_fbo)
+			{
+				scene_fbo = graph->framebuffer();
+				renderer->setSceneFramebuffer(scene_fbo);
+			}
+			gl_state.cullFace(GL_BACK);
+			gl_state.viewport(0, 0, frame_width, frame_height);
+			gl_state.bindFramebuffer(GL_FRAMEBUFFER, scene_fbo);
+			glm::vec3 clear_col = glm::vec3(204, 204, 204);
+			clear_col /= 255.0f;
+			glClearColor(clear_col.x, clear_col.y, clear_col.z, 0.0f);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+
+			renderer->drawScene();
+		}).write(scene_color).write(scene_depth);
+		if (graph_path == RENDER_PATH_DEFERRED)
+			scene.read(albedo).read(normal).read(gbuffer_depth);
+
+		if (temporal)
+		{
+			// tested against the scene's depth, which it doesn't write
+			graph->addPass("velocity", [&]()
+			{
+				gl_state.bindFramebuffer(GL_FRAMEBUFFER, graph->framebuffer());
+				gl_state.viewport(0, 0, frame_width, frame_height);
+				renderer->drawVelocity();
+			}).write(velocity).write(scene_depth);
+
+			graph->addPass("temporal resolve", [&, scene_color, scene_depth, velocity]()
+			{
+				taa->resolve(graph->texture(scene_color), graph->texture(scene_depth), graph->texture(velocity), frame_width, frame_height, frame_view_proj);
+			}).read(scene_color).read(scene_depth).read(velocity).write(history);
+		}
+		else
+		{
+			graph->addPass("resolve", [&]()
+			{
+				gl_state.bindFramebuffer(GL_READ_FRAMEBUFFER, scene_fbo);
+				gl_state.bindFramebuffer(GL_DRAW_FRAMEBUFFER, graph->framebuffer());
+				glBlitFramebuffer(0, 0, frame_width, frame_height, 0, 0, frame_width, frame_height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+			}).read(scene_color).write(resolved);
+		}
+
+		// the quad only stretches the chain's output to the window when there is one. TAA's output is
+		// the full size whatever the frame's was
+		unsigned int frame_output = temporal ? history : resolved;
+		graph->addPass("post-processing", [&, resolved, temporal]()
+		{
+			unsigned int input = temporal ? taa->output() : graph->texture(resolved);
+			glm::vec2 frame_scale = glm::vec2((float)frame_width / render_width, (float)frame_height / render_height);
+			if (temporal)
+				frame_scale = glm::vec2(1.0f);
+			if (post)
+				post->apply(input, frame_scale);
+
+			gl_state.bindFramebuffer(GL_FRAMEBUFFER, graph->framebuffer());
+			gl_state.viewport(0, 0, screen_width, screen_height);
+			glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+			glClear(GL_COLOR_BUFFER_BIT);
+
+			gl_state.bindVertexArray(quadVAO);
+			screen_shader->use();
+			screen_shader->setBool("post_processed", post != nullptr);
+			screen_shader->setFloat("exposure", exposure);
+			screen_shader->setVec2("uv_scale", frame_scale);
+			screen_shader->setFloat("sharpness", frame_scale.x < 1.0f || frame_scale.y < 1.0f ? upscale_sharpness : 0.0f);
+			gl_state.disable(GL_DEPTH_TEST);
+			gl_state.bindTexture(0, GL_TEXTURE_2D, post ? post->output() : input);
+			glDrawArrays(GL_TRIANGLES, 0, 6);
+
+			if (show_profiler)
+				profiler_overlay->draw(*profiler, screen_width, screen_height);
+		}).read(frame_output).write(backbuffer);
+	};
 
 	//std::vector<std::string> faces
 	//{
@@ -561,47 +874,20 @@ int main()
 	fish_transform = glm::translate(fish_transform, glm::vec3(-3.0f, -1.0f, 0.0f));
 	renderer->addModel(&fish_model, &fish_transform);
 
-	Shader fish_shader("shaders/InstanceVertex.shader", "shaders/Fragment.shader");
-
-	fish_shader.use();
-
-	dir_light->uniformShader(&fish_shader, "dirlight");
-
-	spot_light->uniformShader(&fish_shader, "spotlight");
-
-	for (unsigned int i = 0; i < 1; ++i)
+	unsigned int fish_vertices = 0;
+	unsigned int fish_alpha_tested = 0;
+	for (unsigned int i = 0; i < fish_model.meshes.size(); ++i)
 	{
-		std::string num = std::to_string(i);
-		
-		point_lights[i].uniformShader(&fish_shader, "pointlight");
+		fish_vertices += fish_model.meshes[i].vertices.size();
+		fish_alpha_tested += fish_model.meshes[i].alpha_tested;
 	}
+	print("fish: " << fish_model.meshes.size() << " meshes (" << fish_alpha_tested << " alpha tested), " << fish_vertices << " vertices, position stream "
+		<< fish_vertices * Mesh::position_stride / 1024 << " KB, interleaved " << fish_vertices * sizeof(Vertex) / 1024 << " KB");
 
-	unsigned int fish_model_buffer;
-	glGenBuffers(1, &fish_model_buffer);
-	glBindBuffer(GL_ARRAY_BUFFER, fish_model_buffer);
-	glBufferData(GL_ARRAY_BUFFER, num_fish * sizeof(glm::mat4), &fish_transforms[0], GL_STATIC_DRAW);
+	InstanceCuller fish_culler(&fish_model, fish_transforms, num_fish);
+	renderer->addInstancedModel(&fish_culler);
 
-	for (int i = 0; i < fish_model.meshes.size(); ++i)
-	{
-		unsigned int meshVAO = fish_model.meshes[i].VAO;
-		glBindVertexArray(meshVAO);
-		std::size_t vec4size = sizeof(glm::vec4);
-		glEnableVertexAttribArray(3);
-		glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, 4 * vec4size, (void*)0);
-		glEnableVertexAttribArray(4);
-		glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, 4 * vec4size, (void*)(1 * vec4size));
-		glEnableVertexAttribArray(5);
-		glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, 4 * vec4size, (void*)(2 * vec4size));
-		glEnableVertexAttribArray(6);
-		glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, 4 * vec4size, (void*)(3 * vec4size));
-
-		glVertexAttribDivisor(3, 1);
-		glVertexAttribDivisor(4, 1);
-		glVertexAttribDivisor(5, 1);
-		glVertexAttribDivisor(6, 1);
-
-		glBindVertexArray(0);
-	}
+	delete[] fish_transforms;
 
 
 	// uniform buffer objects
@@ -628,50 +914,208 @@ int main()
 	float deltaTime = 0.0f;
 	float lastFrame = 0.0f;
 
+	float last_stats_time = 0.0f;
+	// from glfwInit to the first frame, and to the first one after every queued program is ready
+	bool first_frame = true;
+	bool programs_ready = false;
+	// the longest frame between stats, where compile hitches would show
+	float longest_frame = 0.0f;
+
 	// render loop
 	while (!glfwWindowShouldClose(window))
 	{
+		CPU_FRAME();
 
 		float currentFrame = glfwGetTime();
 		deltaTime = currentFrame - lastFrame;
 		lastFrame = currentFrame;
+		if (!first_frame)
+			longest_frame = std::max(longest_frame, deltaTime);
 
 		//input
-		processInput(window, camera, deltaTime);
+		CPU_ZONE_BEGIN(input);
+		if (!bench)
+			processInput(window, camera, deltaTime);
+		else if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+			glfwSetWindowShouldClose(window, true);
+
+		// tab switches between forward and deferred shading
+		bool tab_pressed = glfwGetKey(window, GLFW_KEY_TAB) == GLFW_PRESS;
+		if (!bench && tab_pressed && !tab_was_pressed)
+		{
+			renderer->setRenderPath(renderer->getRenderPath() == RENDER_PATH_FORWARD ? RENDER_PATH_DEFERRED : RENDER_PATH_FORWARD);
+			print((renderer->getRenderPath() == RENDER_PATH_FORWARD ? "forward" : "deferred") << " shading");
+		}
+		tab_was_pressed = tab_pressed;
+
+		// p switches the point light shadows between instanced and per-face drawing
+		bool p_pressed = glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS;
+		if (!bench && p_pressed && !p_was_pressed)
+		{
+			renderer->setPointShadowInstancing(!renderer->getPointShadowInstancing());
+			print("point shadows " << (renderer->getPointShadowInstancing() ? "instanced" : "per face"));
+		}
+		p_was_pressed = p_pressed;
+
+		// f cycles through the shadow filters
+		bool f_pressed = glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS;
+		if (!bench && f_pressed && !f_was_pressed)
+		{
+			renderer->setShadowFilter((ShadowFilterMode)((renderer->getShadowFilter() + 1) % (SHADOW_FILTER_ESM + 1)));
+			print(shadowFilterName(renderer->getShadowFilter()) << " shadows");
+		}
+		f_was_pressed = f_pressed;
+
+		// n warps the textures with the baked noise, which is a different variant of the lit shaders
+		bool n_pressed = glfwGetKey(window, GLFW_KEY_N) == GLFW_PRESS;
+		if (!bench && n_pressed && !n_was_pressed)
+		{
+			renderer->setNoiseOffsets(!renderer->getNoiseOffsets());
+			print("noise offsets " << (renderer->getNoiseOffsets() ? "on" : "off"));
+		}
+		n_was_pressed = n_pressed;
+
+		// g cycles through post-processing chains, the per pixel effects of each are one dispatch
+		bool g_pressed = glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS;
+		if (!bench && post && g_pressed && !g_was_pressed)
+		{
+			post_preset = (post_preset + 1) % 3;
+			buildPostChain(post, post_preset, exposure);
+
+			std::string effects;
+			for (const PostNode& node : post->nodes())
+				effects += std::string(" ") + postEffectName(node.effect);
+			print("post-processing:" << effects);
+		}
+		g_was_pressed = g_pressed;
+
+		// r switches dynamic resolution, off it's drawn at the full size
+		bool r_pressed = glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS;
+		if (!bench && r_pressed && !r_was_pressed)
+		{
+			dynamic_resolution.setEnabled(!dynamic_resolution.enabled());
+			print("dynamic resolution " << (dynamic_resolution.enabled() ? "on" : "off"));
+		}
+		r_was_pressed = r_pressed;
+
+		// t cycles through 4x MSAA, TAA and TAA upsampling, the history starts again each time
+		bool t_pressed = glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS;
+		if (!bench && taa && t_pressed && !t_was_pressed)
+		{
+			anti_aliasing = (AntiAliasing)((anti_aliasing + 1) % (ANTI_ALIASING_TAA_UPSAMPLING + 1));
+			taa->reset();
+			print(antiAliasingName(anti_aliasing));
+		}
+		t_was_pressed = t_pressed;
+
+		// o shows the GPU profile over the frame, j writes it to a file
+		bool o_pressed = glfwGetKey(window, GLFW_KEY_O) == GLFW_PRESS;
+		if (!bench && o_pressed && !o_was_pressed)
+			show_profiler = !show_profiler;
+		o_was_pressed = o_pressed;
+
+		bool j_pressed = glfwGetKey(window, GLFW_KEY_J) == GLFW_PRESS;
+		if (!bench && j_pressed && !j_was_pressed && profiler->writeJson(gpu_profile_path))
+			print("gpu profile written to " << gpu_profile_path);
+		j_was_pressed = j_pressed;
+
+#if CPU_PROFILER
+		// k writes a cpu trace of the next frames
+		bool k_pressed = glfwGetKey(window, GLFW_KEY_K) == GLFW_PRESS;
+		if (!bench && k_pressed && !k_was_pressed && !cpu_profiler.stats.capturing)
+		{
+			cpu_profiler.capture(cpu_profiler.stats.frame + 1, cpu_trace_frames, cpu_trace_path);
+			print("capturing a cpu trace of " << cpu_trace_frames << " frames");
+		}
+		k_was_pressed = k_pressed;
+#endif
+
+		// - and = halve and double the exposure every second they're held
+		if (!bench && (glfwGetKey(window, GLFW_KEY_MINUS) == GLFW_PRESS || glfwGetKey(window, GLFW_KEY_EQUAL) == GLFW_PRESS))
+		{
+			exposure *= glm::exp2(glfwGetKey(window, GLFW_KEY_MINUS) == GLFW_PRESS ? -deltaTime : deltaTime);
+			for (unsigned int i = 0; post && i < post->nodes().size(); ++i)
+			{
+				if (post->nodes()[i].effect == POST_TONEMAP)
+					post->setParams(i, glm::vec4(exposure));
+			}
+		}
+		CPU_ZONE_END(input);
+
+		if (bench && bench_frame == 0)
+		{
+			// small lights spread over the ground, so each one only reaches a few clusters
+			while (bench_lights.size() < bench_num_lights)
+			{
+				glm::vec3 color = glm::vec3(randFloat(0.2f, 1.0f), randFloat(0.2f, 1.0f), randFloat(0.2f, 1.0f));
+				glm::vec3 position = glm::vec3(randFloat(-10.0f, 10.0f), randFloat(-3.5f, 2.0f), randFloat(-12.0f, 8.0f));
+				bench_lights.emplace_back(color, position, 0.0f, false);
+				bench_lights.back().setAttenuation(1.0f, 0.7f, 1.8f);
+				bench_lights.back().setRadius(1.5f);
+				renderer->addPointLight(&bench_lights.back());
+			}
+			renderer->setClusteredShading(bench_modes[bench_mode].clustered);
+			renderer->setRenderPath(bench_modes[bench_mode].path);
+
+			glm::ivec2 resolution = bench_resolutions[bench_resolution];
+			if ((unsigned int)resolution.x != render_width || (unsigned int)resolution.y != render_height)
+			{
+				render_width = resolution.x;
+				render_height = resolution.y;
+
+				renderer->resize(render_width, render_height);
+				if (post)
+					post->resize(render_width, render_height);
+				if (taa)
+					taa->resize(render_width, render_height);
+			}
+		}
+
+		// the frame is stretched to the window while its size changes, and drawn at the new size once it
+		// has kept it for a moment, so dragging the border doesn't recreate every target each frame
+		const float resize_settle_time = 0.25f;
+		if (window_width > 0 && window_height > 0)
+		{
+			screen_width = window_width;
+			screen_height = window_height;
+		}
+		if (!bench && (screen_width != render_width || screen_height != render_height) && currentFrame - window_resize_time > resize_settle_time)
+		{
+			render_width = screen_width;
+			render_height = screen_height;
+
+			renderer->resize(render_width, render_height);
+			if (post)
+				post->resize(render_width, render_height);
+			if (taa)
+				taa->resize(render_width, render_height);
+		}
 
 		const float light_speed = 4.0f;
 
+		glm::vec3 light_move = glm::vec3(0.0f);
 		if (glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS)
-			point_lights[0].position.x -= light_speed * deltaTime;
+			light_move.x -= light_speed * deltaTime;
 		if (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS)
-			point_lights[0].position.x += light_speed * deltaTime;
+			light_move.x += light_speed * deltaTime;
 		if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS)
-			point_lights[0].position.z -= light_speed * deltaTime;
+			light_move.z -= light_speed * deltaTime;
 		if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS)
-			point_lights[0].position.z += light_speed * deltaTime;
+			light_move.z += light_speed * deltaTime;
 		if (glfwGetKey(window, GLFW_KEY_COMMA) == GLFW_PRESS)
-			point_lights[0].position.y -= light_speed * deltaTime;
+			light_move.y -= light_speed * deltaTime;
 		if (glfwGetKey(window, GLFW_KEY_PERIOD) == GLFW_PRESS)
-			point_lights[0].position.y += light_speed * deltaTime;
+			light_move.y += light_speed * deltaTime;
+
+		// setPosition marks the light so only it is uploaded again
+		if (light_move.x != 0.0f || light_move.y != 0.0f || light_move.z != 0.0f)
+			point_lights[0].setPosition(point_lights[0].position + light_move);
 
 		float time_val = glfwGetTime();
 		/*glm::vec3 dir = glm::vec3(glm::cos(time_val), -1.0f, glm::sin(time_val));
-		dir_light->direction = dir;*/
+		dir_light->setDirection(dir);*/
 		renderer->updateLightUniforms();
 
-		renderer->drawShadows();
-
-
-		//rendering commands here
-		glCullFace(GL_BACK);
-		glViewport(0, 0, screen_width, screen_height);
-		glBindFramebuffer(GL_FRAMEBUFFER, msFBO);
-		glm::vec3 clear_col = glm::vec3(204, 204, 204);
-		clear_col /= 255.0f;
-		glClearColor(clear_col.x, clear_col.y, clear_col.z, 0.0f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
-		
-
 		// view and projection
 		//const float radius = 5.0f;
 		//float cam_x = cos(time_val / 4.0f) * radius;
@@ -688,12 +1132,176 @@ int main()
 		//fish_shader.setFloat("far", far_plane);
 		glm::mat4 proj = glm::perspective(camera.getFOV(), (float) (screen_width) / (float) (screen_height), 0.1f, far_plane);
 
-		// update view and projection uniform buffer
-		renderer->updateUniformBuffer(view, proj);
+		// the timer measures every pass of the frame, so the scale picked here follows from the last few
+		profiler->beginFrame();
+		dynamic_resolution.begin();
+		dynamic_resolution.size(render_width, render_height, frame_width, frame_height);
+		if (anti_aliasing == ANTI_ALIASING_TAA_UPSAMPLING)
+		{
+			frame_width = std::min(frame_width, (unsigned int)(render_width * taa_upsampling_scale));
+			frame_height = std::min(frame_height, (unsigned int)(render_height * taa_upsampling_scale));
+		}
+		renderer->setViewport(frame_width, frame_height);
 
-		renderer->draw();
+		// update view and projection uniform buffer, with TAA's jitter
+		frame_view_proj = proj * view;
+		glm::mat4 frame_proj = anti_aliasing != ANTI_ALIASING_MSAA ? taa->jitter(proj, frame_width, frame_height) : proj;
+		renderer->updateUniformBuffer(view, frame_proj, proj);
 
-		print(glGetError());
+		//rendering commands here
+		if (!graph_declared || graph_path != renderer->getRenderPath() || graph_width != render_width || graph_height != render_height || graph_anti_aliasing != anti_aliasing)
+		{
+			declare_frame();
+			graph->execute();
+
+			const RenderGraphStats& graph_stats = graph->stats;
+			print("render graph: " << graph->describe());
+			print("render targets: " << graph_stats.targets << " in " << graph_stats.allocations << " allocations, " << graph_stats.bytes / 1.0e6 << " MB before aliasing, "
+				<< graph_stats.aliased_bytes / 1.0e6 << " MB after");
+			const RenderTargetPoolStats& pool_stats = target_pool->stats;
+			print("render target pool: " << pool_stats.textures << " textures, " << pool_stats.in_use << " in use, " << pool_stats.bytes / 1.0e6 << " MB, "
+				<< pool_stats.framebuffers << " framebuffers, " << pool_stats.created << " created so far");
+		}
+		else
+		{
+			graph->execute();
+		}
+		dynamic_resolution.end();
+		profiler->endFrame();
+		renderer->endFrame();
+
+		if (!bench)
+			print(glGetError());
+
+		if (bench)
+		{
+			++bench_frame;
+			if (bench_frame > bench_warmup_frames)
+			{
+				// gpu results lag a few frames, the warmup covers that
+				RenderPathStats path_stats = renderer->getRenderPathStats();
+				bench_frame_ms += deltaTime * 1000.0f;
+				bench_opaque_ms += path_stats.opaque_ms;
+				bench_lighting_ms += path_stats.lighting_ms;
+				bench_attachment_bytes += path_stats.attachment_bytes;
+				bench_lights_per_cluster += renderer->getClusterStats().average_lights;
+			}
+
+			if (bench_frame == bench_warmup_frames + bench_frames)
+			{
+				const ClusterStats& cluster_stats = renderer->getClusterStats();
+				bool clustered = bench_modes[bench_mode].clustered;
+				float lighting_ms = bench_lighting_ms / bench_frames;
+				print(cluster_stats.num_lights << " | " << render_width << "x" << render_height << " | " << bench_modes[bench_mode].name << " | "
+					<< bench_frame_ms / bench_frames << " | " << bench_opaque_ms / bench_frames << " | " << lighting_ms << " | "
+					<< lighting_ms * 1.0e6f / (render_width * render_height) << " | " << bench_attachment_bytes / bench_frames / 1.0e6 << " | "
+					<< (clustered ? bench_lights_per_cluster / bench_frames : (float)cluster_stats.num_lights) << ", "
+					<< (clustered ? cluster_stats.max_lights : cluster_stats.num_lights));
+
+				bench_frame = 0;
+				bench_frame_ms = 0.0f;
+				bench_opaque_ms = 0.0f;
+				bench_lighting_ms = 0.0f;
+				bench_attachment_bytes = 0.0;
+				bench_lights_per_cluster = 0.0f;
+
+				if (++bench_mode == num_bench_modes)
+				{
+					bench_mode = 0;
+					if (++bench_resolution == num_bench_resolutions)
+					{
+						bench_resolution = 0;
+						bench_num_lights *= 2;
+						if (bench_num_lights > max_bench_lights)
+							glfwSetWindowShouldClose(window, true);
+					}
+				}
+			}
+		}
+		else if (currentFrame - last_stats_time > 1.0f)
+		{
+			last_stats_time = currentFrame;
+
+			const SoftwareOcclusionStats& occlusion_stats = renderer->getSoftwareOcclusionStats();
+			print("occluders: " << occlusion_stats.occluder_triangles << " tris, " << occlusion_stats.raster_ms << " ms (" << occlusion_stats.throughput() << " Mtris/s), culled "
+				<< occlusion_stats.culled << "/" << occlusion_stats.tested << " (" << occlusion_stats.cullRate() * 100.0f << "%), test " << occlusion_stats.test_ms << " ms");
+			print("depth pre-pass: " << renderer->getDepthPrepass()->enabled() << ", overdraw " << renderer->getDepthPrepass()->overdraw());
+			print("gl state calls: " << gl_state.frame_stats.issued << " issued, " << gl_state.frame_stats.elided << " elided");
+
+			const ClusterStats& cluster_stats = renderer->getClusterStats();
+			print("lights: " << cluster_stats.num_lights << ", " << cluster_stats.average_lights << " avg / " << cluster_stats.max_lights << " max per cluster, assign "
+				<< cluster_stats.assign_ms << " ms");
+
+			RenderPathStats path_stats = renderer->getRenderPathStats();
+			print((renderer->getRenderPath() == RENDER_PATH_FORWARD ? "forward" : "deferred") << ": opaque " << path_stats.opaque_ms << " ms, lighting "
+				<< path_stats.lighting_ms << " ms, ~" << path_stats.attachment_bytes / 1.0e6 << " MB render target traffic");
+
+			const ShadowAtlasStats& shadow_stats = renderer->getShadowStats();
+			print("shadows: " << shadow_stats.updated << "/" << shadow_stats.views << " views drawn (" << shadow_stats.static_rebuilt << " static), "
+				<< shadow_stats.waiting << " waiting, " << shadow_stats.casters_drawn << " casters in " << shadow_stats.draw_calls << " draws, " << shadow_stats.dynamic_casters << " moving, " << shadow_stats.gpu_ms << " ms");
+
+			const CascadeStats& cascade_stats = renderer->getCascadeStats();
+			print("cascades: " << cascade_stats.cascades << ", splits " << cascade_stats.splits[0] << " " << cascade_stats.splits[1] << " " << cascade_stats.splits[2] << " " << cascade_stats.splits[3]
+				<< ", drawn " << cascade_stats.drawn << ", " << cascade_stats.casters_submitted << " casters submitted, " << cascade_stats.gpu_ms << " ms, "
+				<< shadowFilterName(renderer->getShadowFilter()) << " filter, moments " << cascade_stats.moments_ms << " ms");
+
+			DepthStreamStats stream_stats = renderer->getDepthStreamStats();
+			print("depth streams: shadows " << stream_stats.shadow_ms << " ms, " << stream_stats.shadow_bytes / 1.0e3 << " KB vertices (" << stream_stats.shadow_interleaved_bytes / 1.0e3
+				<< " KB interleaved), pre-pass " << stream_stats.prepass_bytes / 1.0e3 << " KB (" << stream_stats.prepass_interleaved_bytes / 1.0e3 << " KB interleaved)");
+
+			const ShaderCacheStats& shader_stats = renderer->getShaderCacheStats();
+			std::string features;
+			for (unsigned int i = 0; i < num_shader_features; ++i)
+			{
+				if (renderer->getFrameFeatures() & (1 << i))
+					features += std::string(" ") + shaderFeatureName(i);
+			}
+			print("shaders: " << shader_stats.variants << " programs (" << shader_stats.pending << " pending), " << shader_stats.variants - shader_stats.loaded - shader_stats.pending
+				<< " compiled in " << shader_stats.compile_ms << " ms, " << shader_stats.loaded << " loaded from binaries in " << shader_stats.load_ms << " ms, "
+				<< shader_stats.render_thread_ms << " ms on the render thread, " << shader_stats.stood_in << " passes stood in, " << shader_stats.skipped << " skipped, frame features" << features);
+			if (post)
+				print("post-processing: " << post->stats.nodes << " effects in " << post->stats.dispatches << " dispatches, " << post->stats.programs << " programs, " << post->stats.ms << " ms, exposure " << exposure);
+			if (post && post->bloom())
+			{
+				const BloomStats& bloom_stats = post->bloom()->stats;
+				std::string down, up;
+				for (unsigned int i = 0; i < bloom_stats.levels; ++i)
+				{
+					down += " " + std::to_string(bloom_stats.down_ms[i]);
+					if (i + 1 < bloom_stats.levels)
+						up += " " + std::to_string(bloom_stats.up_ms[i]);
+				}
+				print("bloom: " << bloom_stats.levels << " levels from " << bloom_stats.width << "x" << bloom_stats.height << ", " << bloom_stats.bytes / 1.0e6 << " MB, "
+					<< bloom_stats.ms << " ms, down" << down << ", up" << up);
+			}
+			const DynamicResolutionStats& resolution_stats = dynamic_resolution.stats;
+			print("dynamic resolution: " << (dynamic_resolution.enabled() ? "on" : "off") << ", scale " << resolution_stats.scale << ", " << resolution_stats.width << "x" << resolution_stats.height
+				<< " of " << render_width << "x" << render_height << ", gpu " << resolution_stats.gpu_ms << " ms / " << resolution_stats.budget_ms << " ms budget, " << resolution_stats.changes << " changes");
+			if (anti_aliasing == ANTI_ALIASING_MSAA)
+			{
+				msaa_gpu_ms = resolution_stats.gpu_ms;
+				print("antialiasing: " << antiAliasingName(anti_aliasing) << ", gpu " << msaa_gpu_ms << " ms");
+			}
+			else
+			{
+				const VelocityStats& velocity_stats = renderer->getVelocityStats();
+				print("antialiasing: " << antiAliasingName(anti_aliasing) << ", " << taa->stats.input_width << "x" << taa->stats.input_height << " to " << taa->stats.output_width << "x"
+					<< taa->stats.output_height << ", resolve " << taa->stats.ms << " ms, velocity " << velocity_stats.ms << " ms for " << velocity_stats.objects << " objects and "
+					<< velocity_stats.instanced << " instanced models");
+				if (msaa_gpu_ms > 0.0f)
+					print("antialiasing: " << msaa_gpu_ms - resolution_stats.gpu_ms << " ms a frame saved of " << msaa_gpu_ms << " ms with " << antiAliasingName(ANTI_ALIASING_MSAA));
+			}
+			std::string passes;
+			for (const GpuProfileStats& scope : profiler->stats())
+			{
+				if (scope.depth == 1)
+					passes += ", " + scope.name + " " + std::to_string(scope.avg_ms);
+			}
+			if (!profiler->stats().empty())
+				print("gpu profile: frame " << profiler->stats()[0].avg_ms << " ms avg, " << profiler->stats()[0].p99_ms << " ms p99" << passes << ", " << profiler->dropped() << " frames dropped");
+			print("longest frame: " << longest_frame * 1000.0f << " ms");
+			longest_frame = 0.0f;
+		}
 
 		// skybox rendering
 		//glDisable(GL_DEPTH_TEST);
@@ -870,35 +1478,40 @@ int main()
 		//}
 
 		//skybox_shader.use();
-		glBindVertexArray(quadVAO);
-
-		//drawing texture quad
-		//glDisable(GL_DEPTH_TEST);
 
-		glBindFramebuffer(GL_READ_FRAMEBUFFER, msFBO);
-		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, interFBO);
-		glBlitFramebuffer(0, 0, screen_width, screen_height, 0, 0, screen_width, screen_height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
-		
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
-		glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
-		glClear(GL_COLOR_BUFFER_BIT);
-
-		screen_shader.use();
-		glDisable(GL_DEPTH_TEST);
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, inter_frame_texture);
-		glDrawArrays(GL_TRIANGLES, 0, 6);
-		
 		//model = glm::scale(model, glm::vec3(0.5f, 0.5f, 0.5f));
 
 		//check and call events and swap the buffers
+		CPU_ZONE_BEGIN(swap);
 		glfwSwapBuffers(window);
 		glfwPollEvents();
+		CPU_ZONE_END(swap);
+
+		const ShaderCacheStats& shader_stats = renderer->getShaderCacheStats();
+		if (first_frame || (!programs_ready && shader_stats.pending == 0))
+		{
+			const char* modes[] = { "blocking", "parallel", "worker thread" };
+			print((first_frame ? "first frame" : "every program ready") << " after " << glfwGetTime() * 1000.0 << " ms, " << shader_stats.pending << " programs pending, "
+				<< shader_stats.variants - shader_stats.loaded - shader_stats.pending << " compiled in " << shader_stats.compile_ms << " ms, " << shader_stats.loaded
+				<< " loaded from binaries in " << shader_stats.load_ms << " ms" << (gl_caps.program_binary ? "" : " (no program binaries)") << ", "
+				<< modes[renderer->getShaderCompileMode()] << " compiles, " << shader_stats.render_thread_ms << " ms on the render thread");
+			programs_ready = shader_stats.pending == 0;
+			first_frame = false;
+		}
+
+		target_pool->endFrame();
+		gl_state.endFrame();
 	}
 
-	glDeleteFramebuffers(1, &msFBO);
-	glDeleteFramebuffers(1, &interFBO);
+	if (bench)
+		profiler->writeJson(gpu_profile_path);
 
+	delete(graph);
+	delete(target_pool);
+	delete(post);
+	delete(taa);
+	delete(profiler_overlay);
+	delete(profiler);
 	delete(dir_light);
 	delete(spot_light);
 	delete(renderer);